@@ -45,6 +45,7 @@ CGmBoxPropsDialog::CGmBoxPropsDialog(CWnd* pParent /*=NULL*/)
     m_strAuthor = "";
     m_strDescr = "";
     m_strTitle = "";
+    m_bTileAtlas = FALSE;
     //}}AFX_DATA_INIT
     m_nCompressLevel = Z_BEST_SPEED;
     m_bPropEdit = TRUE;
@@ -65,6 +66,7 @@ void CGmBoxPropsDialog::DoDataExchange(CDataExchange* pDX)
     DDV_MaxChars(pDX, m_strDescr, 2000);
     DDX_Text(pDX, IDC_D_GBXPRP_TITLE, m_strTitle);
     DDV_MaxChars(pDX, m_strTitle, 60);
+    DDX_Check(pDX, IDC_D_GBXPRP_TILEATLAS, m_bTileAtlas);
     //}}AFX_DATA_MAP
 }
 
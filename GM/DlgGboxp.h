@@ -39,6 +39,7 @@ public:
     CString m_strAuthor;
     CString m_strDescr;
     CString m_strTitle;
+    BOOL    m_bTileAtlas;
     //}}AFX_DATA
     BOOL    m_bPropEdit;        // Set to true is editing existing props
     int     m_nCompressLevel;
@@ -38,6 +38,8 @@
 #include    "VwPrjgbx.h"
 
 #include    "ResTbl.h"
+#include    "TransBlt.h"
+#include    "BrdCache.h"
 #include    "StrLib.h"
 
 #ifdef _DEBUG
@@ -50,6 +52,7 @@ static char THIS_FILE[] = __FILE__;
 
 static char szSectSettings[] = "Settings";
 static char szSectDisableHtmlHelp[] = "DisableHtmlHelp";
+static char szSectBoardCacheBudget[] = "BoardCacheBudget";
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -156,6 +159,15 @@ BOOL CGmApp::InitInstance()
     g_gt.InitGdiTools();
     g_res.InitResourceTable(m_hInstance);
 
+    // The vector transparent blit kernels must match the scalar
+    // one exactly. Checked in debug builds only.
+    ASSERT(TransBltSelfTest());
+
+    // Megabytes of rendered board chunks kept for redrawing the
+    // board views. Zero draws the boards from scratch every time.
+    g_brdCache.SetBudget(value_preserving_cast<size_t>(
+        GetProfileInt(szSectSettings, szSectBoardCacheBudget, 64)) * 1024 * 1024);
+
     // Load standard INI file options (including MRU)
     LoadStdProfileSettings(10);
 
@@ -273,6 +285,7 @@ int CGmApp::ExitInstance()
 
     CWinAppEx::ExitInstance();
 
+    g_brdCache.Clear();
     if (m_pMapViewTmpl != NULL) delete m_pMapViewTmpl;
     if (m_pTileEditTmpl != NULL) delete m_pTileEditTmpl;
     return 0;
@@ -62,7 +62,13 @@
 
 CFontTbl CGamDoc::m_fontTbl;                // Global font table
 CTileManager* CGamDoc::c_pTileMgr = NULL;// Temp pointer to tile manager
-int CGamDoc::c_fileVersion = 0;
+// In-memory archives (clipboard, cloning) use the current format
+int CGamDoc::c_fileVersion = NumVersion(fileGbxVerMajor, fileGbxVerMinor);
+
+bool IsLoadingWideIDs()
+{
+    return CGamDoc::GetLoadingVersion() >= NumVersion(4, 0);   // V4.00
+}
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -211,6 +217,8 @@ BOOL CGamDoc::OnSaveDocument(const char* pszPathName)
 {
     // Make sure tile edits are saved.
     UpdateAllViews(NULL, HINT_FORCETILEUPDATE, NULL);
+    // Squeeze out the slots of deleted tiles so they aren't stored.
+    GetTileManager()->CompactTileSheets();
     if (_access(pszPathName, 0) != -1)
     {
         char szTmp[_MAX_PATH];
@@ -725,6 +733,7 @@ void CGamDoc::OnEditGbxProperties()
     dlg.m_strTitle = m_strTitle;
     dlg.m_strDescr = m_strDescr;
     dlg.m_nCompressLevel = (int)m_wCompressLevel;
+    dlg.m_bTileAtlas = m_pTMgr->IsAtlasMode();
 
     if (dlg.DoModal() == IDOK)
     {
@@ -732,6 +741,7 @@ void CGamDoc::OnEditGbxProperties()
         m_strTitle = dlg.m_strTitle;
         m_strDescr = dlg.m_strDescr;
         m_wCompressLevel = (WORD)dlg.m_nCompressLevel;
+        m_pTMgr->SetAtlasMode(dlg.m_bTileAtlas);
         if (dlg.m_bPassSet)
         {
             // Update the gamebox password.
@@ -294,6 +294,7 @@
 #define IDC_D_MMEDIT_TEXTPROMPT         5157
 #define IDC_D_MMEDIT_TEXT               5158
 #define IDC_D_SETVISI_NATURAL           5159
+#define IDC_D_GBXPRP_TILEATLAS          5162
 #define IDC_D_MARKGRP_VIZFULL           7090
 #define IDC_D_MARKGRP_RAND_VIZHIDDEN    7092
 #define IDC_D_MARKGRP_RAND_VIZALLHIDDEN 7093
@@ -397,7 +398,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        1052
 #define _APS_NEXT_COMMAND_VALUE         32894
-#define _APS_NEXT_CONTROL_VALUE         5162
+#define _APS_NEXT_CONTROL_VALUE         5163
 #define _APS_NEXT_SYMED_VALUE           3000
 #endif
 #endif
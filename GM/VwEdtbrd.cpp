@@ -29,6 +29,7 @@
 #include    "GMisc.h"
 #include    "ClipBrd.h"
 #include    "Tile.h"
+#include    "BrdCache.h"
 #include    "LBoxTile.h"
 
 #include    "ToolObjs.h"
@@ -174,16 +175,19 @@ void CBrdEditView::OnInitialUpdate()
     CScrollView::OnInitialUpdate();
     m_pBMgr = GetDocument()->GetBoardManager();
     m_pBoard = (CBoard*)GetDocument()->GetCreateParameter();
+    // The board may have been changed while no view of it was open.
+    g_brdCache.InvalidateBoard(*m_pBoard);
     SetScrollSizes(MM_TEXT, m_pBoard->GetSize(m_nZoom));
 }
 
 void CBrdEditView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
 {
     WORD wHint = LOWORD(lHint);
-    TileID tid = static_cast<TileID>(HIWORD(lHint));
-    if ((wHint == HINT_TILEMODIFIED && m_pBoard->IsTileInUse(tid)) ||
+    if ((wHint == HINT_TILEMODIFIED &&
+            m_pBoard->IsTileInUse(static_cast<CGmBoxHint*>(pHint)->GetArgs<HINT_TILEMODIFIED>().m_tid)) ||
         wHint == HINT_TILEDELETED || wHint == HINT_TILESETDELETED)
     {
+        g_brdCache.InvalidateBoard(*m_pBoard);
         Invalidate(FALSE);          // Do redraw
         return;
     }
@@ -191,6 +195,7 @@ void CBrdEditView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
     {
         if (static_cast<CGmBoxHint*>(pHint)->GetArgs<HINT_BOARDDELETED>().m_pBoard == m_pBoard)
         {
+            g_brdCache.InvalidateBoard(*m_pBoard);
             CFrameWnd* pFrm = GetParentFrame();
             ASSERT(pFrm != NULL);
             pFrm->SendMessage(WM_CLOSE, 0, 0L);
@@ -200,6 +205,7 @@ void CBrdEditView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
     {
         if (static_cast<CGmBoxHint*>(pHint)->GetArgs<HINT_BOARDPROPCHANGE>().m_pBoard == m_pBoard)
         {
+            g_brdCache.InvalidateBoard(*m_pBoard);
             SetScrollSizes(MM_TEXT, m_pBoard->GetSize(m_nZoom));
             Invalidate(FALSE);
         }
@@ -212,19 +218,34 @@ void CBrdEditView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
 // CBrdEditView drawing
 
 void CBrdEditView::OnDraw(CDC* pDC)
+{
+    // Separately invalidated areas are drawn one at a time.
+    std::vector<CRect> tblRects;
+    GetPaintRects(pDC, tblRects);
+    if (tblRects.empty())
+        return;                 // Nothing to do
+
+    SetupPalette(pDC);
+
+    for (size_t i = size_t(0); i < tblRects.size(); ++i)
+        DrawArea(pDC, tblRects[i]);
+
+    if (!pDC->IsPrinting())
+    {
+        PrepareScaledDC(pDC);
+        m_selList.OnDraw(*pDC);
+    }
+    ResetPalette(pDC);
+}
+
+// Draws the part of the board inside oRct.
+void CBrdEditView::DrawArea(CDC* pDC, CRect oRct)
 {
     CDC dcMem;
     CBitmap bmMem;
-    CRect oRct;
     CDC* pDrawDC = pDC;
     CBitmap* pPrvBMap;
 
-    pDC->GetClipBox(&oRct);
-    if (oRct.IsRectEmpty())
-        return;                 // Nothing to do
-
-    SetupPalette(pDC);
-
     if (m_bOffScreen)
     {
         bmMem.Attach(Create16BitDIBSection(pDC->m_hDC,
@@ -237,7 +258,10 @@ void CBrdEditView::OnDraw(CDC* pDC)
         pDrawDC = &dcMem;
     }
 
-    m_pBoard->Draw(pDrawDC, &oRct, m_nZoom);
+    if (m_bOffScreen && !pDC->IsPrinting())
+        g_brdCache.Draw(pDrawDC, oRct, *m_pBoard, m_nZoom);
+    else
+        m_pBoard->Draw(pDrawDC, &oRct, m_nZoom);
 
     if (m_bOffScreen)
     {
@@ -246,12 +270,6 @@ void CBrdEditView::OnDraw(CDC* pDC)
         ResetPalette(&dcMem);
         dcMem.SelectObject(pPrvBMap);
     }
-    if (!pDC->IsPrinting())
-    {
-        PrepareScaledDC(pDC);
-        m_selList.OnDraw(*pDC);
-    }
-    ResetPalette(pDC);
 }
 
 BOOL CBrdEditView::OnEraseBkgnd(CDC* pDC)
@@ -333,6 +351,7 @@ void CBrdEditView::WorkspaceToClient(CRect& rect) const
 
 void CBrdEditView::InvalidateWorkspaceRect(const CRect* pRect, BOOL bErase)
 {
+    g_brdCache.InvalidateRect(*m_pBoard, *pRect);
     CRect rct(pRect);
     WorkspaceToClient(rct);
     rct.InflateRect(1, 1);
@@ -928,6 +947,7 @@ void CBrdEditView::SetCellTile(TileID tid, CPoint pnt, BOOL bUpdate)
     if (tid != pBa->GetCellTile(row, col))
     {
         pBa->SetCellTile(row, col, tid);
+        InvalidateCachedCell(row, col);
         if (bUpdate)
         {
             CRect rct;
@@ -953,6 +973,7 @@ void CBrdEditView::SetCellColor(COLORREF crCell, CPoint pnt, BOOL bUpdate)
     if (crCell != pBa->GetCellColor(row, col))
     {
         pBa->SetCellColor(row, col, crCell);
+        InvalidateCachedCell(row, col);
         if (bUpdate)
         {
             CRect rct;
@@ -964,9 +985,18 @@ void CBrdEditView::SetCellColor(COLORREF crCell, CPoint pnt, BOOL bUpdate)
     }
 }
 
+// Throws away the cached images of the cell at every scale.
+void CBrdEditView::InvalidateCachedCell(int row, int col)
+{
+    CRect rct;
+    m_pBoard->GetBoardArray()->GetCellRect(row, col, &rct, fullScale);
+    g_brdCache.InvalidateRect(*m_pBoard, rct);
+}
+
 void CBrdEditView::SetBoardBackColor(COLORREF cr, BOOL bUpdate)
 {
     m_pBoard->SetBkColor(m_pBMgr->GetForeColor());
+    g_brdCache.InvalidateBoard(*m_pBoard);
     if (bUpdate)
         Invalidate();
     GetDocument()->SetModifiedFlag();
@@ -121,6 +121,9 @@ protected:
     void CreateTextDrawingObject(CPoint pnt, FontID fid, COLORREF crText,
         CString& m_strText, BOOL bInvalidate = TRUE);
 
+    void DrawArea(CDC* pDC, CRect oRct);
+    void InvalidateCachedCell(int row, int col);
+
     void DoViewScale(TileScale nZoom);
     void CenterViewOnWorkspacePoint(CPoint point);
 
@@ -304,7 +304,9 @@ void CGbxProjView::DoTileNew()
             CSize(dlg.m_nWidth, dlg.m_nHeight),
             CSize(dlg.m_nHalfWidth, dlg.m_nHalfHeight),
             RGB(255, 255, 255));
-        pDoc->UpdateAllViews(NULL, MAKELPARAM(HINT_TILECREATED, static_cast<WORD>(tidNew)), NULL);
+        CGmBoxHint hint;
+        hint.GetArgs<HINT_TILECREATED>().m_tid = tidNew;
+        pDoc->UpdateAllViews(NULL, HINT_TILECREATED, &hint);
         pDoc->CreateNewFrame(GetApp()->m_pTileEditTmpl, "Tile Editor",
             reinterpret_cast<LPVOID>(value_preserving_cast<uintptr_t>(tidNew)));
         pDoc->SetModifiedFlag();
@@ -384,7 +386,9 @@ void CGbxProjView::DoTileClone()
         pTMgr->GetTile(tidNew, &tileHalf, halfScale);
         tileHalf.Update(&bmap);
 
-        pDoc->UpdateAllViews(NULL, MAKELPARAM(HINT_TILECREATED, static_cast<WORD>(tidNew)), NULL);
+        CGmBoxHint hint;
+        hint.GetArgs<HINT_TILECREATED>().m_tid = tidNew;
+        pDoc->UpdateAllViews(NULL, HINT_TILECREATED, &hint);
 
         pDoc->CreateNewFrame(GetApp()->m_pTileEditTmpl, "Tile Editor",
             reinterpret_cast<LPVOID>(value_preserving_cast<uintptr_t>(tidNew)));
@@ -416,7 +420,9 @@ void CGbxProjView::DoTileDelete()
     for (size_t i = 0; i < tidtbl.size(); i++)
     {
         pTMgr->DeleteTile(tidtbl[i]);
-        pDoc->UpdateAllViews(NULL, MAKELPARAM(HINT_TILEDELETED, static_cast<WORD>(tidtbl[i])), NULL);
+        CGmBoxHint hint;
+        hint.GetArgs<HINT_TILEDELETED>().m_tid = tidtbl[i];
+        pDoc->UpdateAllViews(NULL, HINT_TILEDELETED, &hint);
     }
     pDoc->NotifyTileDatabaseChange();
     pDoc->SetModifiedFlag();
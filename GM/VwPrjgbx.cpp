@@ -579,7 +579,7 @@ void CGbxProjView::DoUpdateProjectList(BOOL bUpdateItem /* = TRUE */)
         {
             CString strTmp = str;
             str.Format("[%d] %s",
-                value_preserving_cast<int>(static_cast<WORD>(pBMgr->GetBoard(i).GetSerialNumber())), (LPCTSTR)strTmp);
+                value_preserving_cast<int>(pBMgr->GetBoard(i).GetSerialNumber()), (LPCTSTR)strTmp);
         }
         m_listProj.AddItem(grpBrd, str, i);
     }
@@ -875,7 +875,11 @@ void CGbxProjView::OnEditPaste()
         DoUpdateTileList();
         pDoc->NotifyTileDatabaseChange();
         for (size_t i = 0; i < tidtbl.size(); i++)
-            pDoc->UpdateAllViews(NULL, MAKELPARAM(HINT_TILECREATED, static_cast<WORD>(tidtbl[i])), NULL);
+        {
+            CGmBoxHint hint;
+            hint.GetArgs<HINT_TILECREATED>().m_tid = tidtbl[i];
+            pDoc->UpdateAllViews(NULL, HINT_TILECREATED, &hint);
+        }
         m_listTiles.SetCurSelsMapped(tidtbl);
         m_listTiles.ShowFirstSelection();
     }
@@ -1110,7 +1114,11 @@ void CGbxProjView::OnProjectLoadTileFile()
         DoUpdateTileList();
         pDoc->NotifyTileDatabaseChange();
         for (size_t i = 0; i < tidtbl.size(); i++)
-            pDoc->UpdateAllViews(NULL, MAKELPARAM(HINT_TILECREATED, static_cast<WORD>(tidtbl[i])), NULL);
+        {
+            CGmBoxHint hint;
+            hint.GetArgs<HINT_TILECREATED>().m_tid = tidtbl[i];
+            pDoc->UpdateAllViews(NULL, HINT_TILECREATED, &hint);
+        }
         m_listTiles.SetCurSelsMapped(tidtbl);
         m_listTiles.ShowFirstSelection();
         EndWaitCursor();
@@ -73,7 +73,13 @@ IMPLEMENT_DYNCREATE(CGamDocHint, CObject);
 
 /////////////////////////////////////////////////////////////////////////////
 
-int CGamDoc::c_fileVersion = 0;
+// In-memory archives (move list clones) use the current format
+int CGamDoc::c_fileVersion = NumVersion(fileGamVerMajor, fileGamVerMinor);
+
+bool IsLoadingWideIDs()
+{
+    return CGamDoc::GetLoadingVersion() >= NumVersion(4, 0);   // V4.00
+}
 
 /////////////////////////////////////////////////////////////////////////////
 // CGamDoc
@@ -358,6 +364,7 @@ void CGamDoc::DeleteContents()
     m_pYMgr = NULL;
     if (m_pPTbl != NULL) delete m_pPTbl;
     m_pPTbl = NULL;
+    m_tblPieceLoc.clear();
 
     m_pRcdMoves = nullptr;
     m_pHistMoves = nullptr;
@@ -446,6 +453,9 @@ void CGamDoc::OnIdle(BOOL bActive)
         pMFrame->UpdatePaletteWindow(pDocMsg, m_bMsgWinVisible && !IsScenario());
         pDocMsg->SetText(this);
     }
+    CTileManager* pTMgr = GetTileManager();
+    if (pTMgr != NULL)
+        pTMgr->ReleaseIdleTileSheets();
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -600,6 +610,10 @@ BOOL CGamDoc::OnNewScenario()
     m_pYMgr = new CTrayManager;
     m_pYMgr->SetTileManager(m_pGbx->GetTileManager());
 
+    // Keep the piece location index up to date.
+    m_pPBMgr->TrackPieceLocations();
+    m_pYMgr->TrackPieceLocations(this);
+
     // Finally set up the tray palettes
     m_palTrayA.Create(GetMainFrame()->GetDockingTrayAWindow());
     m_palTrayB.Create(GetMainFrame()->GetDockingTrayBWindow());
@@ -900,7 +914,9 @@ void CGamDoc::RestoreWindowState()
 
     // If a window state payload was delivered to us during deserialize,
     // attempt to restore all the windows to their former glory.
+    // The payload is in the format of the file it was loaded from.
 
+    SetLoadingVersionGuard setLoadingVersionGuard(m_nLoadedFileVersion);
     m_pWinState->SetDocument(this);
     m_pWinState->RestoreStateOfDocumentFrames();
     DiscardWindowState();                           // Discard used data
@@ -1347,10 +1363,38 @@ void CGamDoc::OnPbckPrevious()
     m_nMoveInterlock++;
     m_bQuietPlayback = TRUE;
 
-    size_t nPrvMove = m_pMoves->FindPreviousMove(this, m_nCurMove);
-
-    MsgDialogCancel(TRUE);
+    // The message history is kept. Reversed message records take
+    // their messages off it.
+    MsgDialogCancel();
     FlushAllIndicators();
+
+    // If the moves being backed over can be reversed there's no need
+    // to restart. Back up to the start of the move prior to the one
+    // we are stepping to and play it again so it's shown.
+    size_t nPrvMove = m_pMoves->UndoToPreviousMove(this, m_nCurMove);
+    if (nPrvMove != Invalid_v<size_t> && nPrvMove > size_t(0))
+    {
+        size_t nPrvPrvMove = m_pMoves->UndoToPreviousMove(this, nPrvMove);
+        if (nPrvPrvMove != Invalid_v<size_t>)
+        {
+            m_nCurMove = nPrvPrvMove;
+
+            m_bQuietPlayback = FALSE;       // Show last move
+            UpdateAllViews(NULL, HINT_GAMESTATEUSED); // Sync up the images
+            while ((m_nCurMove = m_pMoves->DoMove(this, m_nCurMove, FALSE)) < nPrvMove &&
+                m_nCurMove != Invalid_v<size_t>) ;
+
+            ASSERT(m_nCurMove == nPrvMove);
+            m_nMoveInterlock--;
+            return;
+        }
+    }
+
+    // The moves are played again from the start. The document may
+    // have been backed up part way but that doesn't matter.
+    if (nPrvMove == Invalid_v<size_t>)
+        nPrvMove = m_pMoves->FindPreviousMove(this, m_nCurMove);
+
     RestartMoves();
 
     if (nPrvMove < m_nCurMove)
@@ -1362,16 +1406,21 @@ void CGamDoc::OnPbckPrevious()
         // we are stepping up to. Find it so we can turn off silent mode for
         // that move.
         size_t nPrvPrvMove = m_pMoves->FindPreviousMove(this, nPrvMove);
+
+        // Clear out any strings we may have accumulated during the
+        // search for the final visible move index.
+        m_astrMsgHist.RemoveAll();
+
+        // Jump to the closest replay checkpoint so only the moves
+        // following it need to be played back.
+        m_nCurMove = m_pMoves->SeekToCheckpoint(this, m_nCurMove, nPrvPrvMove);
+
         if (m_nCurMove == nPrvPrvMove)
         {
             m_bQuietPlayback = FALSE;
             UpdateAllViews(NULL, HINT_GAMESTATEUSED); // Sync up the images
         }
 
-        // Clear out any strings we may have accumulated during the
-        // search for the final visible move index.
-        m_astrMsgHist.RemoveAll();
-
         while ((m_nCurMove = m_pMoves->DoMove(this, m_nCurMove, FALSE)) < nPrvMove &&
             m_nCurMove != Invalid_v<size_t>)
         {
@@ -73,8 +73,10 @@
 
 class CGameBox;
 class CTrayManager;
+class CTraySet;
 class CPieceTable;
 class CDrawObj;
+class CDrawList;
 class CPieceObj;
 class CMarkObj;
 class CLine;
@@ -404,6 +406,13 @@ public:
     void SetObjectLockdownTable(const std::vector<CB::not_null<CDrawObj*>>& pLst, BOOL bLockState);
     void SetObjectLockdown(CDrawObj& pDObj, BOOL bLockState);
 
+    // Used to reverse moves during playback. These don't record.
+    void RestoreObjectOnBoard(CPlayBoard* pPBrd, CDrawObj::OwnerPtr pObj,
+        CPoint pntCtr, size_t nZOrder);
+    void RestorePieceOnBoard(CPlayBoard* pPBrd, PieceID pid, CPoint pntCtr,
+        size_t nZOrder);
+    void RestorePieceInTray(PieceID pid, CTraySet& pYGrp, size_t nPos);
+
     BOOL RemovePieceFromCurrentLocation(PieceID pid, BOOL bDeleteIfBoard,
         BOOL bTrayHintAllowed = TRUE);
     void RemoveObjectFromCurrentLocation(CDrawObj* pObj);
@@ -416,6 +425,12 @@ public:
         CPlayBoard*& pPBoard, CPieceObj** ppObj = NULL);
     CPlayBoard* FindPieceOnBoard(PieceID pid, CPieceObj** ppObj = NULL);
     CTraySet*   FindPieceInTray(PieceID pid);
+    // Piece location index support. Called by the board piece lists
+    // and tray sets as pieces are added and removed.
+    void NotePieceAdded(PieceID pid, const CDrawList& pPceList);
+    void NotePieceAdded(PieceID pid, const CTraySet& pYSet);
+    void NotePieceRemoved(PieceID pid, const CDrawList& pPceList);
+    void NotePieceRemoved(PieceID pid, const CTraySet& pYSet);
     CPlayBoard* FindObjectOnBoard(ObjectID dwObjID, CDrawObj** ppObj = NULL);
     CPlayBoard* FindObjectOnBoard(CDrawObj* pObj);
 
@@ -623,6 +638,19 @@ protected:
 
     BOOL    m_bSimulateSpectator;// If set, show everything as if spectator game
 
+    // Container holding each piece indexed by PieceID. Kept up to
+    // date by the board piece lists and tray sets. (NOSAVE)
+    struct PieceLoc
+    {
+        const CDrawList* m_pPceList = NULL; // Board piece list
+        const CTraySet* m_pYSet = NULL;     // Tray set
+    };
+    std::vector<PieceLoc> m_tblPieceLoc;
+
+    BOOL LocatePiece(PieceID pid, CTraySet*& pTraySet, CPlayBoard*& pPBoard,
+        CPieceObj** ppObj);
+    PieceLoc& GetPieceLoc(PieceID pid);
+
 // Implementation - overrides
 public:
     virtual ~CGamDoc();
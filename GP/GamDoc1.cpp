@@ -161,10 +161,11 @@ void CGamDoc::PlaceObjectOnBoard(CPlayBoard *pPBrd, CDrawObj::OwnerPtr opObj,
         CB::get_underlying(temp).release();
     }
 
-    if (pPBrd->IsOwned() && pObj.GetType() == CDrawObj::drawPieceObj)
+    if (pObj.GetType() == CDrawObj::drawPieceObj)
     {
         CPieceObj& pPObj = static_cast<CPieceObj&>(pObj);
-        GetPieceTable()->SetOwnerMask(pPObj.m_pid, pPBrd->GetOwnerMask());
+        if (pPBrd->IsOwned())
+            GetPieceTable()->SetOwnerMask(pPObj.m_pid, pPBrd->GetOwnerMask());
     }
 
     if (!IsQuietPlayback())
@@ -326,10 +327,11 @@ void CGamDoc::PlaceObjectTableOnBoard(const std::vector<CB::not_null<CDrawObj*>>
         else if (ePos == placeBack)
             pDwg->AddToBack(&pObj);
 
-        if (pPBrd->IsOwned() && pObj.GetType() == CDrawObj::drawPieceObj)
+        if (pObj.GetType() == CDrawObj::drawPieceObj)
         {
             CPieceObj& pPObj = static_cast<CPieceObj&>(pObj);
-            GetPieceTable()->SetOwnerMask(pPObj.m_pid, pPBrd->GetOwnerMask());
+            if (pPBrd->IsOwned())
+                GetPieceTable()->SetOwnerMask(pPObj.m_pid, pPBrd->GetOwnerMask());
         }
 
         if (!IsQuietPlayback())
@@ -696,11 +698,33 @@ void CGamDoc::SetObjectLockdown(CDrawObj& pDObj, BOOL bLockState)
 
 void CGamDoc::SetPieceOwnership(PieceID pid, DWORD dwOwnerMask)
 {
+    // An owned piece can show a different side (and size) to other
+    // players so the piece is redrawn where it was and where it is.
+    CPieceObj* pObj;
+    CPlayBoard* pPBrd = FindPieceOnBoard(pid, &pObj);
+    if (pPBrd != NULL && !IsQuietPlayback())
+    {
+        CGamDocHint hint;
+        hint.GetArgs<HINT_UPDATEOBJECT>().m_pPBoard = pPBrd;
+        hint.GetArgs<HINT_UPDATEOBJECT>().m_pDrawObj = pObj;
+        UpdateAllViews(NULL, HINT_UPDATEOBJECT, &hint);
+    }
+
     GetPieceTable()->SetOwnerMask(pid, dwOwnerMask);
 
+    if (pPBrd != NULL)
+        pObj->ResyncExtentRect();
+
     // Record processing
     RecordPieceSetOwnership(pid, dwOwnerMask);
 
+    if (pPBrd != NULL && !IsQuietPlayback())
+    {
+        CGamDocHint hint;
+        hint.GetArgs<HINT_UPDATEOBJECT>().m_pPBoard = pPBrd;
+        hint.GetArgs<HINT_UPDATEOBJECT>().m_pDrawObj = pObj;
+        UpdateAllViews(NULL, HINT_UPDATEOBJECT, &hint);
+    }
     SetModifiedFlag();
 }
 
@@ -862,6 +886,63 @@ void CGamDoc::ReorgObjsInDrawList(CPlayBoard *pPBrd, std::vector<CB::not_null<CD
     SetModifiedFlag();
 }
 
+//////////////////////////////////////////////////////////////////////
+// Puts an object back on a board at an exact drawing position. Used
+// to reverse moves during playback so it doesn't record. pntCtr is
+// center of object.
+
+void CGamDoc::RestoreObjectOnBoard(CPlayBoard* pPBrd, CDrawObj::OwnerPtr opObj,
+    CPoint pntCtr, size_t nZOrder)
+{
+    CDrawObj& pObj = *opObj;
+    CDrawList* pDwg = pPBrd->GetPieceList();
+    ASSERT(pDwg);
+
+    RemoveObjectFromCurrentLocation(&pObj);
+
+    CRect rct = pObj.GetRect();
+    pObj.MoveObject(rct.TopLeft() + (pntCtr - GetMidRect(rct)));
+    pDwg->InsertAtZOrder(std::move(opObj), nZOrder);
+
+    if (!IsQuietPlayback())
+    {
+        CGamDocHint hint;
+        hint.GetArgs<HINT_UPDATEOBJECT>().m_pPBoard = pPBrd;
+        hint.GetArgs<HINT_UPDATEOBJECT>().m_pDrawObj = &pObj;
+        UpdateAllViews(NULL, HINT_UPDATEOBJECT, &hint);
+    }
+    SetModifiedFlag();
+}
+
+void CGamDoc::RestorePieceOnBoard(CPlayBoard* pPBrd, PieceID pid, CPoint pntCtr,
+    size_t nZOrder)
+{
+    CPieceObj* pObj;
+    if (FindPieceOnBoard(pid, &pObj) == NULL)
+    {
+        // It's in a tray so it needs a board object.
+        RemovePieceFromCurrentLocation(pid, TRUE);
+        pObj = &pPBrd->AddPiece(pntCtr, pid);
+    }
+    RestoreObjectOnBoard(pPBrd, pObj, pntCtr, nZOrder);
+}
+
+// Unlike PlacePieceInTray() nPos is the final index of the piece.
+void CGamDoc::RestorePieceInTray(PieceID pid, CTraySet& pYGrp, size_t nPos)
+{
+    CTraySet *pCurYGrp = FindPieceInTray(pid);
+    RemovePieceFromCurrentLocation(pid, TRUE, pCurYGrp != &pYGrp);
+    pYGrp.AddPieceID(pid, nPos);
+
+    if (!IsQuietPlayback())
+    {
+        CGamDocHint hint;
+        hint.GetArgs<HINT_TRAYCHANGE>().m_pTray = &pYGrp;
+        UpdateAllViews(NULL, HINT_TRAYCHANGE, &hint);
+    }
+    SetModifiedFlag();
+}
+
 ////////////////////////////////////////////////////////////////////
 
 CPlayBoard* CGamDoc::FindObjectOnBoard(ObjectID dwObjID, CDrawObj** ppObj)
@@ -878,14 +959,95 @@ CPlayBoard* CGamDoc::FindObjectOnBoard(CDrawObj* pObj)
 
 CPlayBoard* CGamDoc::FindPieceOnBoard(PieceID pid, CPieceObj** ppObj)
 {
-    ASSERT(m_pPBMgr != NULL);
-    return m_pPBMgr->FindPieceOnBoard(pid, ppObj);
+    CTraySet* pTraySet;
+    CPlayBoard* pPBoard;
+    LocatePiece(pid, pTraySet, pPBoard, ppObj);
+    return pPBoard;
 }
 
 CTraySet* CGamDoc::FindPieceInTray(PieceID pid)
 {
-    ASSERT(m_pYMgr != NULL);
-    return m_pYMgr->FindPieceIDInTraySet(pid);
+    CTraySet* pTraySet;
+    CPlayBoard* pPBoard;
+    LocatePiece(pid, pTraySet, pPBoard, NULL);
+    return pTraySet;
+}
+
+////////////////////////////////////////////////////////////////////
+// A piece is either on one board or in one tray. The piece lists
+// of the boards and the tray sets keep the piece location index
+// up to date as pieces are added and removed so no search of all
+// the boards and trays is needed. Returns FALSE if the piece isn't
+// anywhere.
+
+BOOL CGamDoc::LocatePiece(PieceID pid, CTraySet*& pTraySet,
+    CPlayBoard*& pPBoard, CPieceObj** ppObj)
+{
+    ASSERT(m_pPBMgr != NULL && m_pYMgr != NULL);
+    pTraySet = NULL;
+    pPBoard = NULL;
+    if (ppObj != NULL) *ppObj = NULL;
+
+    size_t nIdx = value_preserving_cast<size_t>(pid);
+    if (nIdx >= m_tblPieceLoc.size())
+        return FALSE;
+    const PieceLoc& loc = m_tblPieceLoc[nIdx];
+    if (loc.m_pPceList != NULL)
+    {
+        pPBoard = m_pPBMgr->GetPBoardByPieceList(*loc.m_pPceList);
+        ASSERT(pPBoard != NULL);
+        if (pPBoard != NULL && ppObj != NULL)
+        {
+            *ppObj = pPBoard->FindPieceID(pid);
+            ASSERT(*ppObj != NULL);
+        }
+        return pPBoard != NULL;
+    }
+    if (loc.m_pYSet != NULL)
+    {
+        ASSERT(loc.m_pYSet->HasPieceID(pid));
+        pTraySet = const_cast<CTraySet*>(loc.m_pYSet);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+CGamDoc::PieceLoc& CGamDoc::GetPieceLoc(PieceID pid)
+{
+    size_t nIdx = value_preserving_cast<size_t>(pid);
+    if (nIdx >= m_tblPieceLoc.size())
+        m_tblPieceLoc.resize(nIdx + size_t(1));
+    return m_tblPieceLoc[nIdx];
+}
+
+void CGamDoc::NotePieceAdded(PieceID pid, const CDrawList& pPceList)
+{
+    PieceLoc& loc = GetPieceLoc(pid);
+    loc.m_pPceList = &pPceList;
+    loc.m_pYSet = NULL;
+}
+
+void CGamDoc::NotePieceAdded(PieceID pid, const CTraySet& pYSet)
+{
+    PieceLoc& loc = GetPieceLoc(pid);
+    loc.m_pPceList = NULL;
+    loc.m_pYSet = &pYSet;
+}
+
+// The location is only cleared if the piece hasn't already been
+// added somewhere else.
+void CGamDoc::NotePieceRemoved(PieceID pid, const CDrawList& pPceList)
+{
+    PieceLoc& loc = GetPieceLoc(pid);
+    if (loc.m_pPceList == &pPceList)
+        loc.m_pPceList = NULL;
+}
+
+void CGamDoc::NotePieceRemoved(PieceID pid, const CTraySet& pYSet)
+{
+    PieceLoc& loc = GetPieceLoc(pid);
+    if (loc.m_pYSet == &pYSet)
+        loc.m_pYSet = NULL;
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -936,12 +1098,10 @@ BOOL CGamDoc::RemovePieceFromCurrentLocation(PieceID pid, BOOL bDeleteIfBoard,
 BOOL CGamDoc::FindPieceCurrentLocation(PieceID pid, CTraySet*& pTraySet,
     CPlayBoard*& pPBoard, CPieceObj** ppObj /* = NULL */)
 {
-    pTraySet = NULL;
-    pPBoard = FindPieceOnBoard(pid, ppObj);
+    LocatePiece(pid, pTraySet, pPBoard, ppObj);
     if (pPBoard != NULL)
         return TRUE;
 
-    pTraySet = FindPieceInTray(pid);
     ASSERT(pTraySet != NULL);   // It HAS to be somewhere!
     return FALSE;
 }
@@ -293,7 +293,7 @@ void CGamDoc::AssignNewMoveGroup()
     if (!IsRecording()) return;
     CreateRecordListIfRequired();
     ASSERT(m_pRcdMoves != NULL);
-    m_pRcdMoves->AssignNewMoveGroup();
+    m_pRcdMoves->AssignNewMoveGroup(CGameState::CalcMoveStateHash(*this));
 }
 
 ////////////////////////////////////////////////////////////////////
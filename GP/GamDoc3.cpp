@@ -166,6 +166,29 @@ void CGamDoc::SerializeMoveSet(CArchive& ar, CHistRecord*& pHist)
 
 /////////////////////////////////////////////////////////////////////////////
 
+// Move and history indices are 32 bit in version 4.00 and later. All
+// ones is the file form of Invalid_v<size_t>.
+static void SerializeMoveIndex(CArchive& ar, size_t& nIndex)
+{
+    if (ar.IsStoring())
+    {
+        ASSERT(nIndex == Invalid_v<size_t> || nIndex < size_t(0xFFFFFFFF));
+        ar << (nIndex == Invalid_v<size_t> ? DWORD(0xFFFFFFFF) : value_preserving_cast<DWORD>(nIndex));
+    }
+    else if (CGamDoc::GetLoadingVersion() >= NumVersion(4, 0))   // V4.00
+    {
+        DWORD dwTmp;
+        ar >> dwTmp;
+        nIndex = dwTmp == 0xFFFFFFFF ? Invalid_v<size_t> : value_preserving_cast<size_t>(dwTmp);
+    }
+    else
+    {
+        WORD wTmp;
+        ar >> wTmp;
+        nIndex = wTmp == 0xFFFF ? Invalid_v<size_t> : value_preserving_cast<size_t>(wTmp);
+    }
+}
+
 void CGamDoc::SerializeGame(CArchive& ar)
 {
     if (ar.IsStoring())
@@ -182,18 +205,10 @@ void CGamDoc::SerializeGame(CArchive& ar)
         ar << (WORD)m_eState;
         ar << m_strCurMsg;
         m_astrMsgHist.Serialize(ar);
-        ASSERT(m_nCurMove == Invalid_v<size_t> ||
-                m_nCurMove < size_t(0xFFFF));
-        ar << (m_nCurMove == Invalid_v<size_t> ? WORD(0xFFFF) : value_preserving_cast<WORD>(m_nCurMove));
-        ASSERT(m_nFirstMove == Invalid_v<size_t> ||
-                m_nFirstMove < size_t(0xFFFF));
-        ar << (m_nFirstMove == Invalid_v<size_t> ? WORD(0xFFFF) : value_preserving_cast<WORD>(m_nFirstMove));
-        ASSERT(m_nCurHist == Invalid_v<size_t> ||
-                m_nCurHist < size_t(0xFFFF));
-        ar << (m_nCurHist == Invalid_v<size_t> ? WORD(0xFFFF) : value_preserving_cast<WORD>(m_nCurHist));
-        ASSERT(m_nMoveIdxAtBookMark == Invalid_v<size_t> ||
-                m_nMoveIdxAtBookMark < size_t(0xFFFF));
-        ar << (m_nMoveIdxAtBookMark == Invalid_v<size_t> ? WORD(0xFFFF) : value_preserving_cast<WORD>(m_nMoveIdxAtBookMark));
+        SerializeMoveIndex(ar, m_nCurMove);
+        SerializeMoveIndex(ar, m_nFirstMove);
+        SerializeMoveIndex(ar, m_nCurHist);
+        SerializeMoveIndex(ar, m_nMoveIdxAtBookMark);
 
         ar << (WORD)m_bStepToNextHist;
         ar << (WORD)m_bKeepSkipInd;
@@ -268,10 +283,10 @@ void CGamDoc::SerializeGame(CArchive& ar)
             m_astrMsgHist.Serialize(ar);
         else
             MsgParseLegacyHistory(m_strCurMsg, m_astrMsgHist, m_strCurMsg);
-        ar >> wTmp; m_nCurMove = (wTmp == 0xFFFF ? Invalid_v<size_t> : value_preserving_cast<size_t>(wTmp));
-        ar >> wTmp; m_nFirstMove = (wTmp == 0xFFFF ? Invalid_v<size_t> : value_preserving_cast<size_t>(wTmp));
-        ar >> wTmp; m_nCurHist = (wTmp == 0xFFFF ? Invalid_v<size_t> : value_preserving_cast<size_t>(wTmp));
-        ar >> wTmp; m_nMoveIdxAtBookMark = (wTmp == 0xFFFF ? Invalid_v<size_t> : value_preserving_cast<size_t>(wTmp));
+        SerializeMoveIndex(ar, m_nCurMove);
+        SerializeMoveIndex(ar, m_nFirstMove);
+        SerializeMoveIndex(ar, m_nCurHist);
+        SerializeMoveIndex(ar, m_nMoveIdxAtBookMark);
 
         if (CGamDoc::GetLoadingVersion() >= NumVersion(2, 90))
         {
@@ -627,6 +642,10 @@ void CGamDoc::SerializeScenarioOrGame(CArchive& ar)
         m_pPBMgr->Serialize(ar);    // Board contents
         m_pYMgr->Serialize(ar);     // Tray contents
 
+        // Keep the piece location index up to date.
+        m_pPBMgr->TrackPieceLocations();
+        m_pYMgr->TrackPieceLocations(this);
+
         // Note: the playing piece table MUST be deserialized AFTER
         // the board and trays since the piece table code may need to
         // fix trays and boards due to piece table truncation.
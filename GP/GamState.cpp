@@ -25,6 +25,7 @@
 #include    "stdafx.h"
 #include    "Gp.h"
 #include    "GamDoc.h"
+#include    "GMisc.h"
 #include    "PBoard.h"
 #include    "PPieces.h"
 #include    "Trays.h"
@@ -60,18 +61,42 @@ BOOL CGameState::CompareState()
     ASSERT(m_pDoc != NULL);
     ASSERT(m_pPBMgr != NULL);
     ASSERT(m_pPTbl != NULL);
-    // Compare the string tables
+    // The string tables aren't compared.
 
-    // Compare the piece tables
-    if (!m_pDoc->GetPieceTable()->Compare(*m_pPTbl))
-        return FALSE;
-    // Compare the play boards
-    if (!m_pDoc->GetPBoardManager()->Compare(*m_pPBMgr))
-        return FALSE;
-    // Compare the trays
-    if (!m_pDoc->GetTrayManager()->Compare(m_pYMgr))
-        return FALSE;
-    return TRUE;
+    // The hashes cover the same data as the piece table, play board
+    // and tray Compare() methods. The hashes are cached by the
+    // tables, boards and trays so unchanged parts aren't rescanned.
+    BOOL bEqual = CalcStateHash(*m_pDoc->GetPieceTable(),
+        *m_pDoc->GetPBoardManager(), *m_pDoc->GetTrayManager()) == GetStateHash();
+#ifdef _DEBUG
+    BOOL bDeepEqual = m_pDoc->GetPieceTable()->Compare(*m_pPTbl) &&
+        m_pDoc->GetPBoardManager()->Compare(*m_pPBMgr) &&
+        m_pDoc->GetTrayManager()->Compare(m_pYMgr);
+    ASSERT(bEqual == bDeepEqual);
+#endif
+    return bEqual;
+}
+
+uint64_t CGameState::GetStateHash() const
+{
+    ASSERT(m_pPBMgr != NULL);
+    ASSERT(m_pPTbl != NULL);
+    return CalcStateHash(*m_pPTbl, *m_pPBMgr, m_pYMgr);
+}
+
+uint64_t CGameState::CalcStateHash(const CPieceTable& pPTbl,
+    const CPBoardManager& pPBMgr, const CTrayManager& pYMgr)
+{
+    uint64_t nHash = pPTbl.GetStateHash();
+    nHash = CombineStateHash(nHash, pPBMgr.GetStateHash());
+    return CombineStateHash(nHash, pYMgr.GetStateHash());
+}
+
+uint64_t CGameState::CalcMoveStateHash(CGamDoc& pDoc)
+{
+    uint64_t nHash = pDoc.GetPieceTable()->GetStateHash();
+    nHash = CombineStateHash(nHash, pDoc.GetPBoardManager()->GetStateHash(FALSE));
+    return CombineStateHash(nHash, pDoc.GetTrayManager()->GetStateHash());
 }
 
 BOOL CGameState::SaveState()
@@ -34,7 +34,9 @@ class CPBoardManager;
 
 // A CGameState object saves a snapshot of the state of the game.
 // This can be used for bookmarks and for state records in the move
-// file.
+// file. The board lists, tray tables and piece table pages of a
+// snapshot are shared with the document and with other snapshots
+// until they're changed, so saving an unchanged state is cheap.
 
 class CGameState
 {
@@ -53,6 +55,11 @@ public:
     BOOL RestoreState();
     // ------- //
     BOOL CompareState();
+    uint64_t GetStateHash() const;
+    // Hash of the document's pieces, boards and trays. It's stored
+    // with each recorded move group so playback can detect games
+    // that have drifted apart.
+    static uint64_t CalcMoveStateHash(CGamDoc& pDoc);
     // ------- //
     void Clear();
     void Serialize(CArchive& ar);
@@ -61,6 +68,8 @@ public:
 protected:
     void CloneElementStringMap(CGameElementStringMap* pMapTo,
         CGameElementStringMap* pMapFrom);
+    static uint64_t CalcStateHash(const CPieceTable& pPTbl,
+        const CPBoardManager& pPBMgr, const CTrayManager& pYMgr);
 
 // Implementation
 protected:
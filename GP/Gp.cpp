@@ -29,6 +29,9 @@
 
 #include    "ResTbl.h"
 #include    "GdiTools.h"
+#include    "TileCache.h"
+#include    "TransBlt.h"
+#include    "BrdCache.h"
 #include    "LibMfc.h"
 
 #include    "FrmMain.h"
@@ -53,6 +56,12 @@ static char THIS_FILE[] = __FILE__;
 
 static char szSectSettings[] = "Settings";
 static char szSectDisableHtmlHelp[] = "DisableHtmlHelp";
+static char szSectMoveCheckpointInterval[] = "MoveCheckpointInterval";
+static char szSectMoveCheckpointBudget[] = "MoveCheckpointBudget";
+static char szSectTileSheetIdleRelease[] = "TileSheetIdleRelease";
+static char szSectDisableTileCache[] = "DisableTileCache";
+static char szSectTileCacheLimit[] = "TileCacheLimit";
+static char szSectBoardCacheBudget[] = "BoardCacheBudget";
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -150,6 +159,36 @@ BOOL CGpApp::InitInstance()
     g_gt.InitGdiTools();
     g_res.InitResourceTable(m_hInstance);
 
+    // The vector transparent blit kernels must match the scalar
+    // one exactly. Checked in debug builds only.
+    ASSERT(TransBltSelfTest());
+
+    // Spacing (in move groups) and maximum count of the game state
+    // snapshots used to speed up stepping backward during playback.
+    CMoveList::SetCheckpointPolicy(
+        value_preserving_cast<size_t>(GetProfileInt(szSectSettings, szSectMoveCheckpointInterval, 16)),
+        value_preserving_cast<size_t>(GetProfileInt(szSectSettings, szSectMoveCheckpointBudget, 64)));
+
+    // Seconds a tile sheet can go unused before its bitmap is
+    // released. Zero keeps inflated sheets for the whole session.
+    CTileManager::SetIdleReleasePolicy(
+        value_preserving_cast<DWORD>(GetProfileInt(szSectSettings, szSectTileSheetIdleRelease, 0)) * 1000);
+
+    // Inflated tile sheets are cached on disk and mapped when the
+    // same game box is opened again. The least recently used sheets
+    // are deleted once the cache passes its limit in megabytes.
+    if (!GetProfileInt(szSectSettings, szSectDisableTileCache, 0))
+    {
+        CTileCache::SetSizeLimit(value_preserving_cast<ULONGLONG>(
+            GetProfileInt(szSectSettings, szSectTileCacheLimit, 512)) * 1024 * 1024);
+        CTileCache::SetCacheDirectory(CTileCache::GetDefaultDirectory());
+    }
+
+    // Megabytes of rendered board chunks kept for redrawing the
+    // board views. Zero draws the boards from scratch every time.
+    g_brdCache.SetBudget(value_preserving_cast<size_t>(
+        GetProfileInt(szSectSettings, szSectBoardCacheBudget, 64)) * 1024 * 1024);
+
     // Load standard INI file options (including MRU)
     LoadStdProfileSettings(10);
 
@@ -284,6 +323,7 @@ int CGpApp::ExitInstance()
 
     CWinAppEx::ExitInstance();
 
+    g_brdCache.Clear();
     if (m_pBrdViewTmpl != NULL) delete m_pBrdViewTmpl;
     return 0;
 }
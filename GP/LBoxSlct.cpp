@@ -116,7 +116,7 @@ BOOL CSelectListBox::OnIsToolTipsEnabled()
     return m_pDoc->IsShowingObjectTips();
 }
 
-int  CSelectListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
+int64_t CSelectListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
 {
     BOOL bOutsideClient;
     UINT nIndex = ItemFromPoint(point, bOutsideClient);
@@ -148,15 +148,15 @@ int  CSelectListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
     else
         return -1;
 
-    return (int)elem;
+    return static_cast<int64_t>(elem);
 }
 
-void CSelectListBox::OnGetTipTextForItemCode(int nItemCode,
+void CSelectListBox::OnGetTipTextForItemCode(int64_t nItemCode,
     CString& strTip, CString& strTitle)
 {
     if (nItemCode == -1)
         return;
-    GameElement elem = (GameElement)nItemCode;
+    GameElement elem = static_cast<GameElement>(nItemCode);
     strTip = m_pDoc->GetGameElementString(elem);
 }
 
@@ -178,12 +178,12 @@ void CSelectListBox::OnGetItemDebugString(size_t nIndex, CString& str)
     if (pDObj.GetType() == CDrawObj::drawPieceObj)
     {
         PieceID pid = static_cast<CPieceObj&>(pDObj).m_pid;
-        str.Format("[pid:%d] ", value_preserving_cast<UINT>(static_cast<WORD>(pid)));
+        str.Format("[pid:%u] ", value_preserving_cast<UINT>(pid));
     }
     else if (pDObj.GetType() == CDrawObj::drawMarkObj)
     {
         MarkID mid = static_cast<CMarkObj&>(pDObj).m_mid;
-        str.Format("[mid:%d] ", value_preserving_cast<UINT>(static_cast<WORD>(mid)));
+        str.Format("[mid:%u] ", value_preserving_cast<UINT>(mid));
     }
 }
 
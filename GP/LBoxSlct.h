@@ -78,8 +78,8 @@ protected:
 
     // Tool tip processing
     virtual BOOL OnIsToolTipsEnabled() override;
-    virtual int  OnGetHitItemCodeAtPoint(CPoint point, CRect& rct) override;
-    virtual void OnGetTipTextForItemCode(int nItemCode, CString& strTip, CString& strTitle) override;
+    virtual int64_t OnGetHitItemCodeAtPoint(CPoint point, CRect& rct) override;
+    virtual void OnGetTipTextForItemCode(int64_t nItemCode, CString& strTip, CString& strTitle) override;
     virtual BOOL OnDoesItemHaveTipText(size_t nItem) override;
 
     //{{AFX_MSG(CSelectListBox)
@@ -90,7 +90,7 @@ BOOL CTrayListBox::OnIsToolTipsEnabled()
     return m_pDoc->IsShowingObjectTips() && m_bAllowTips;
 }
 
-int  CTrayListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
+int64_t CTrayListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
 {
     BOOL bOutsideClient;
     UINT nIndex = ItemFromPoint(point, bOutsideClient);
@@ -104,7 +104,7 @@ int  CTrayListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
     ASSERT(pPTbl != NULL);
 
     PieceID nPid = MapIndexToItem(nIndex);
-    uint32_t flags = 0;
+    int64_t flags = 0;
 
     TileID tidLeft = pPTbl->GetActiveTileID(nPid);
     ASSERT(tidLeft != nullTid);            // Should exist
@@ -123,22 +123,21 @@ int  CTrayListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
     else if (!rctRight.IsRectEmpty() && rctRight.PtInRect(point))
     {
         rct = rctRight;
-        static_assert(sizeof(nPid) <= 2, "flags and PieceID bits overlap");
-        flags |= 0x10000;               // Set flag bit indicating right side rect
+        flags |= int64_t(1) << 32;     // Set flag bit indicating right side rect
     }
     else
         return -1;
 
-    return value_preserving_cast<int>(static_cast<WORD>(nPid) | flags);
+    return static_cast<int64_t>(static_cast<uint32_t>(nPid)) | flags;
 }
 
-void CTrayListBox::OnGetTipTextForItemCode(int nItemCode,
+void CTrayListBox::OnGetTipTextForItemCode(int64_t nItemCode,
     CString& strTip, CString& strTitle)
 {
     if (nItemCode < 0)
         return;
-    PieceID pid = static_cast<PieceID>(nItemCode & 0xFFFF);
-    BOOL bRightRect = (nItemCode & 0x10000) != 0;
+    PieceID pid = static_cast<PieceID>(static_cast<uint32_t>(nItemCode));
+    BOOL bRightRect = ((nItemCode >> 32) & 1) != 0;
     int nSide = m_pDoc->GetPieceTable()->IsFrontUp(pid) ? 0 : 1;
     if (bRightRect) nSide ^= 1;         // Toggle the side
     strTip = m_pDoc->GetGameElementString(MakePieceElement(pid, nSide));
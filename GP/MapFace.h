@@ -39,24 +39,24 @@
 
 //////////////////////////////////////////////////////////////////////
 // ElementState's Bit Layout:
-//   3         2         1
-// 210987654321098765432109876543210
-// M----IIIIIIIIIIIIIIII--SAAAAAAAAA
+//   6         5         4         3         2         1
+// 3210987654321098765432109876543210987654321098765432109876543210
+// M-------------------IIIIIIIIIIIIIIIIIIIIIIIIIIIIIIII--SAAAAAAAAA
 //
 // A = Facing Angle in degrees
 // S = Side up. 0=top/1=bottom. Markers = 0
 // I = Piece or Marker ID code
 // M = Marker flag. 1=marker
 
-typedef DWORD ElementState;
+typedef uint64_t ElementState;
 
-const DWORD MARKER_ELEMENT_FLAG = 0x80000000L; // Top set if a marker, else a piece
+const ElementState MARKER_ELEMENT_FLAG = 0x8000000000000000; // Top set if a marker, else a piece
 
 inline ElementState MakePieceState(PieceID pid, WORD nFacingDegCW, BYTE nSide)
-    { return ((DWORD)static_cast<WORD>(pid) << 12) | ((DWORD)nSide << 9) | (nFacingDegCW & 0x1FF); }
+    { return ((ElementState)static_cast<uint32_t>(pid) << 12) | ((ElementState)nSide << 9) | (nFacingDegCW & 0x1FF); }
 
 inline ElementState MakeMarkerState(MarkID mid, WORD nFacingDegCW)
-    { return ((DWORD)static_cast<WORD>(mid) << 12) | (nFacingDegCW & 0x1FF) | MARKER_ELEMENT_FLAG; }
+    { return ((ElementState)static_cast<uint32_t>(mid) << 12) | (nFacingDegCW & 0x1FF) | MARKER_ELEMENT_FLAG; }
 
 inline int GetElementFacingAngle(ElementState elem)
 {
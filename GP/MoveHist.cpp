@@ -48,16 +48,25 @@ void CHistoryTable::Serialize(CArchive& ar)
 {
     if (ar.IsStoring())
     {
-        ar << value_preserving_cast<WORD>(size());
+        ar << value_preserving_cast<DWORD>(size());
         for (size_t i = 0; i < size(); i++)
             GetHistRecord(i).Serialize(ar);
     }
     else
     {
         Clear();
-        WORD wSize;
-        ar >> wSize;
-        for (WORD i = 0; i < wSize; i++)
+        size_t nSize;
+        if (CGamDoc::GetLoadingVersion() >= NumVersion(4, 0))  // V4.00
+        {
+            DWORD dwSize;
+            ar >> dwSize; nSize = value_preserving_cast<size_t>(dwSize);
+        }
+        else
+        {
+            WORD wSize;
+            ar >> wSize; nSize = value_preserving_cast<size_t>(wSize);
+        }
+        for (size_t i = 0; i < nSize; i++)
         {
             OwnerPtr<CHistRecord> pRcd = new CHistRecord;
             pRcd->Serialize(ar);
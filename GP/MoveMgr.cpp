@@ -56,12 +56,80 @@ void CMoveRecord::Serialize(CArchive& ar)
     // The type code is stored seperately and are reconstituted
     // by the object's constructor.
     if (ar.IsStoring())
-        ar << (short)m_nSeqNum;
+    {
+        ar << (LONG)m_nSeqNum;
+        ar << (BYTE)(m_bHasStateHash ? 1 : 0);
+        if (m_bHasStateHash)
+            ar << (ULONGLONG)m_nStateHash;
+    }
     else
     {
-        short sTmp;
-        ar >> sTmp; m_nSeqNum = (int)sTmp;
+        if (CGamDoc::GetLoadingVersion() >= NumVersion(4, 0))  // V4.00
+        {
+            LONG lTmp;
+            ar >> lTmp; m_nSeqNum = (int)lTmp;
+        }
+        else
+        {
+            short sTmp;
+            ar >> sTmp; m_nSeqNum = (int)sTmp;
+        }
+        m_bHasStateHash = FALSE;
+        if (CGamDoc::GetLoadingVersion() >= NumVersion(3, 91))
+        {
+            BYTE cTmp;
+            ar >> cTmp;
+            if (cTmp)
+            {
+                ULONGLONG qwTmp;
+                ar >> qwTmp;
+                SetStateHash(qwTmp);
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////
+// PieceUndoLocation methods....
+
+void PieceUndoLocation::SaveLocation(CGamDoc* pDoc, PieceID pid)
+{
+    CPlayBoard* pPBoard;
+    CTraySet* pTray;
+    CPieceObj* pObj;
+
+    m_bOnBoard = pDoc->FindPieceCurrentLocation(pid, pTray, pPBoard, &pObj);
+    if (m_bOnBoard)
+    {
+        CRect rct = pObj->GetRect();
+        m_nBrdNum = pPBoard->GetSerialNumber();
+        m_ptCtr = GetMidRect(rct);
+        m_nZOrder = pPBoard->GetPieceList()->GetObjectZOrder(*pObj);
+    }
+    else
+    {
+        m_nTrayNum = pDoc->GetTrayManager()->FindTrayByRef(*pTray);
+        m_nTrayPos = pTray->GetPieceIDIndex(pid);
     }
+    m_dwOwnerMask = pDoc->GetPieceTable()->GetOwnerMask(pid);
+}
+
+void PieceUndoLocation::RestoreLocation(CGamDoc* pDoc, PieceID pid)
+{
+    if (m_bOnBoard)
+    {
+        CPlayBoard* pPBoard = pDoc->GetPBoardManager()->
+            GetPBoardBySerial(m_nBrdNum);
+        ASSERT(pPBoard);
+        pDoc->RestorePieceOnBoard(pPBoard, pid, m_ptCtr, m_nZOrder);
+    }
+    else
+    {
+        CTraySet& pYGrp = pDoc->GetTrayManager()->GetTraySet(m_nTrayNum);
+        pDoc->RestorePieceInTray(pid, pYGrp, m_nTrayPos);
+    }
+    // Moving to an owned board or tray may have changed this.
+    pDoc->GetPieceTable()->SetOwnerMask(pid, m_dwOwnerMask);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -76,6 +144,7 @@ CBoardPieceMove::CBoardPieceMove(BoardID nBrdSerNum, PieceID pid, CPoint pnt,
     m_pid = pid;
     m_ptCtr = pnt;
     m_ePos = ePos;
+    m_bUndo = FALSE;
 }
 
 BOOL CBoardPieceMove::ValidatePieces(CGamDoc* pDoc)
@@ -83,7 +152,7 @@ BOOL CBoardPieceMove::ValidatePieces(CGamDoc* pDoc)
 #ifdef _DEBUG
     BOOL bUsed = pDoc->GetPieceTable()->IsPieceUsed(m_pid);
     if (!bUsed)
-        TRACE1("CBoardPieceMove::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(static_cast<WORD>(m_pid)));
+        TRACE1("CBoardPieceMove::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(m_pid));
     return bUsed;
 #else
     return pDoc->GetPieceTable()->IsPieceUsed(m_pid);
@@ -123,6 +192,9 @@ void CBoardPieceMove::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
 
     pDoc->EnsureBoardLocationVisible(*pPBrdDest, m_ptCtr);
 
+    m_locUndo.SaveLocation(pDoc, m_pid);
+    m_bUndo = TRUE;
+
     if (pDoc->FindPieceCurrentLocation(m_pid, pTrayFrom, pPBrdFrom, &pObj))
     {
         CRect rct = pObj->GetRect();
@@ -145,6 +217,13 @@ void CBoardPieceMove::DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup)
 {
 }
 
+void CBoardPieceMove::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    m_locUndo.RestoreLocation(pDoc, m_pid);
+    m_bUndo = FALSE;
+}
+
 void CBoardPieceMove::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
@@ -172,7 +251,7 @@ void CBoardPieceMove::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
     wsprintf(szBfr, "    board = %d, pos = %d, pid = %d, @(%d, %d)\r\n",
-        value_preserving_cast<int>(static_cast<WORD>(m_nBrdNum)), m_ePos, value_preserving_cast<int>(static_cast<WORD>(m_pid)), m_ptCtr.x, m_ptCtr.y);
+        value_preserving_cast<int>(m_nBrdNum), m_ePos, value_preserving_cast<int>(m_pid), m_ptCtr.x, m_ptCtr.y);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -187,6 +266,7 @@ CTrayPieceMove::CTrayPieceMove(size_t nTrayNum, PieceID pid, size_t nPos)
     m_nTrayNum = nTrayNum;
     m_pid = pid;
     m_nPos = nPos;
+    m_bUndo = FALSE;
 }
 
 BOOL CTrayPieceMove::ValidatePieces(CGamDoc* pDoc)
@@ -194,7 +274,7 @@ BOOL CTrayPieceMove::ValidatePieces(CGamDoc* pDoc)
 #ifdef _DEBUG
     BOOL bUsed = pDoc->GetPieceTable()->IsPieceUsed(m_pid);
     if (!bUsed)
-        TRACE1("CTrayPieceMove::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(static_cast<WORD>(m_pid)));
+        TRACE1("CTrayPieceMove::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(m_pid));
     return bUsed;
 #else
     return pDoc->GetPieceTable()->IsPieceUsed(m_pid);
@@ -220,10 +300,20 @@ void CTrayPieceMove::DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup)
 
 void CTrayPieceMove::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
 {
+    m_locUndo.SaveLocation(pDoc, m_pid);
+    m_bUndo = TRUE;
+
     CTraySet& pYGrp = pDoc->GetTrayManager()->GetTraySet(m_nTrayNum);
     pDoc->PlacePieceInTray(m_pid, pYGrp, m_nPos);
 }
 
+void CTrayPieceMove::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    m_locUndo.RestoreLocation(pDoc, m_pid);
+    m_bUndo = FALSE;
+}
+
 void CTrayPieceMove::DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup)
 {
     CTraySet& pYGrp = pDoc->GetTrayManager()->GetTraySet(m_nTrayNum);
@@ -255,7 +345,7 @@ void CTrayPieceMove::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
     wsprintf(szBfr, "    tray = %zu, nPos = %zu, pid = %u\r\n",
-        m_nTrayNum, m_nPos, static_cast<WORD>(m_pid));
+        m_nTrayNum, m_nPos, static_cast<uint32_t>(m_pid));
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -268,7 +358,7 @@ BOOL CPieceSetSide::ValidatePieces(CGamDoc* pDoc)
 #ifdef _DEBUG
     BOOL bUsed = pDoc->GetPieceTable()->IsPieceUsed(m_pid);
     if (!bUsed)
-        TRACE1("CPieceSetSide::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(static_cast<WORD>(m_pid)));
+        TRACE1("CPieceSetSide::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(m_pid));
     return bUsed;
 #else
     return pDoc->GetPieceTable()->IsPieceUsed(m_pid);
@@ -321,6 +411,27 @@ void CPieceSetSide::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     CTraySet* pTray;
     CPieceObj* pObj;
 
+    m_bUndoTopUp = pDoc->GetPieceTable()->IsFrontUp(m_pid);
+    m_bUndo = TRUE;
+
+    if (pDoc->FindPieceCurrentLocation(m_pid, pTray, pPBoard, &pObj))
+        pDoc->InvertPlayingPieceOnBoard(*pObj, pPBoard);
+    else
+        pDoc->InvertPlayingPieceInTray(m_pid);
+}
+
+void CPieceSetSide::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    m_bUndo = FALSE;
+    // Single sided pieces are never flipped.
+    if (pDoc->GetPieceTable()->IsFrontUp(m_pid) == m_bUndoTopUp)
+        return;
+
+    CPlayBoard* pPBoard;
+    CTraySet* pTray;
+    CPieceObj* pObj;
+
     if (pDoc->FindPieceCurrentLocation(m_pid, pTray, pPBoard, &pObj))
         pDoc->InvertPlayingPieceOnBoard(*pObj, pPBoard);
     else
@@ -348,7 +459,7 @@ void CPieceSetSide::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
     wsprintf(szBfr, "    Piece %d is set to %s visible.\r\n",
-        value_preserving_cast<int>(static_cast<WORD>(m_pid)), m_bTopUp ? "top" : "bottom");
+        value_preserving_cast<int>(m_pid), m_bTopUp ? "top" : "bottom");
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -361,7 +472,7 @@ BOOL CPieceSetFacing::ValidatePieces(CGamDoc* pDoc)
 #ifdef _DEBUG
     BOOL bUsed = pDoc->GetPieceTable()->IsPieceUsed(m_pid);
     if (!bUsed)
-        TRACE1("CPieceSetFacing::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(static_cast<WORD>(m_pid)));
+        TRACE1("CPieceSetFacing::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(m_pid));
     return bUsed;
 #else
     return pDoc->GetPieceTable()->IsPieceUsed(m_pid);
@@ -392,12 +503,29 @@ void CPieceSetFacing::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     CTraySet* pTray;
     CPieceObj* pObj;
 
+    m_nUndoFacingDegCW = pDoc->GetPieceTable()->GetPieceFacing(m_pid);
+    m_bUndo = TRUE;
+
     if (pDoc->FindPieceCurrentLocation(m_pid, pTray, pPBoard, &pObj))
         pDoc->ChangePlayingPieceFacingOnBoard(*pObj, pPBoard, m_nFacingDegCW);
     else
         pDoc->ChangePlayingPieceFacingInTray(m_pid, m_nFacingDegCW);
 }
 
+void CPieceSetFacing::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    CPlayBoard* pPBoard;
+    CTraySet* pTray;
+    CPieceObj* pObj;
+
+    if (pDoc->FindPieceCurrentLocation(m_pid, pTray, pPBoard, &pObj))
+        pDoc->ChangePlayingPieceFacingOnBoard(*pObj, pPBoard, m_nUndoFacingDegCW);
+    else
+        pDoc->ChangePlayingPieceFacingInTray(m_pid, m_nUndoFacingDegCW);
+    m_bUndo = FALSE;
+}
+
 void CPieceSetFacing::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
@@ -428,7 +556,7 @@ void CPieceSetFacing::Serialize(CArchive& ar)
 void CPieceSetFacing::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
-    wsprintf(szBfr, "    Piece %d is rotated %d degrees.\r\n", value_preserving_cast<int>(static_cast<WORD>(m_pid)), m_nFacingDegCW);
+    wsprintf(szBfr, "    Piece %d is rotated %d degrees.\r\n", value_preserving_cast<int>(m_pid), m_nFacingDegCW);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -441,7 +569,7 @@ BOOL CPieceSetOwnership::ValidatePieces(CGamDoc* pDoc)
 #ifdef _DEBUG
     BOOL bUsed = pDoc->GetPieceTable()->IsPieceUsed(m_pid);
     if (!bUsed)
-        TRACE1("CPieceSetOwnership::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(static_cast<WORD>(m_pid)));
+        TRACE1("CPieceSetOwnership::ValidatePieces - Piece %u not in piece table.\n", value_preserving_cast<UINT>(m_pid));
     return bUsed;
 #else
     return pDoc->GetPieceTable()->IsPieceUsed(m_pid);
@@ -464,9 +592,18 @@ void CPieceSetOwnership::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     }
     else
         pDoc->SelectTrayItem(*pTray, m_pid);
+    m_dwUndoOwnerMask = pDoc->GetPieceTable()->GetOwnerMask(m_pid);
+    m_bUndo = TRUE;
     pDoc->SetPieceOwnership(m_pid, m_dwOwnerMask);
 }
 
+void CPieceSetOwnership::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    pDoc->SetPieceOwnership(m_pid, m_dwUndoOwnerMask);
+    m_bUndo = FALSE;
+}
+
 void CPieceSetOwnership::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
@@ -494,7 +631,7 @@ void CPieceSetOwnership::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
     wsprintf(szBfr, "    Piece %d has ownership changed to 0x%X.\r\n",
-        value_preserving_cast<int>(static_cast<WORD>(m_pid)), m_dwOwnerMask);
+        value_preserving_cast<int>(m_pid), m_dwOwnerMask);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -508,6 +645,7 @@ CMarkerSetFacing::CMarkerSetFacing(ObjectID dwObjID, MarkID mid, int nFacingDegC
     m_dwObjID = dwObjID;
     m_mid = mid;
     m_nFacingDegCW = nFacingDegCW;
+    m_bUndo = FALSE;
 }
 
 void CMarkerSetFacing::DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup)
@@ -532,12 +670,29 @@ void CMarkerSetFacing::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     CDrawObj* pObj;
     CPlayBoard* pPBoard = pDoc->FindObjectOnBoard(m_dwObjID, &pObj);
 
+    m_bUndo = pPBoard != NULL;
     if (pPBoard != NULL)
-        pDoc->ChangeMarkerFacingOnBoard(*static_cast<CMarkObj*>(pObj), pPBoard, m_nFacingDegCW);
+    {
+        CMarkObj& pMObj = *static_cast<CMarkObj*>(pObj);
+        m_nUndoFacingDegCW = pMObj.GetFacing();
+        pDoc->ChangeMarkerFacingOnBoard(pMObj, pPBoard, m_nFacingDegCW);
+    }
     else
         ASSERT(FALSE);          // SHOULDN'T HAPPEN
 }
 
+void CMarkerSetFacing::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    CDrawObj* pObj;
+    CPlayBoard* pPBoard = pDoc->FindObjectOnBoard(m_dwObjID, &pObj);
+
+    ASSERT(pPBoard != NULL);
+    if (pPBoard != NULL)
+        pDoc->ChangeMarkerFacingOnBoard(*static_cast<CMarkObj*>(pObj), pPBoard, m_nUndoFacingDegCW);
+    m_bUndo = FALSE;
+}
+
 void CMarkerSetFacing::Serialize(CArchive& ar)              // VER2.0 is first time used
 {
     CMoveRecord::Serialize(ar);
@@ -563,7 +718,7 @@ void CMarkerSetFacing::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
     wsprintf(szBfr, "    Marker dwObjID = %lX, mid = %d is rotated %d degrees.\r\n",
-        m_dwObjID, value_preserving_cast<int>(static_cast<WORD>(m_mid)), m_nFacingDegCW);
+        m_dwObjID, value_preserving_cast<int>(m_mid), m_nFacingDegCW);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -581,6 +736,7 @@ CBoardMarkerMove::CBoardMarkerMove(BoardID nBrdSerNum, ObjectID dwObjID, MarkID
     m_mid = mid;
     m_ptCtr = pnt;
     m_ePos = ePos;
+    m_bUndo = FALSE;
 }
 
 void CBoardMarkerMove::DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup)
@@ -614,9 +770,15 @@ void CBoardMarkerMove::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     CDrawObj* pObj;
     CPlayBoard* pPBrdFrom = pDoc->FindObjectOnBoard(m_dwObjID, &pObj);
 
+    m_bUndo = TRUE;
+    m_bUndoCreated = pPBrdFrom == NULL;
     if (pPBrdFrom != NULL)
     {
         CRect rct = pObj->GetRect();
+        m_nUndoBrdNum = pPBrdFrom->GetSerialNumber();
+        m_ptUndoCtr = GetMidRect(rct);
+        m_nUndoZOrder = pPBrdFrom->GetPieceList()->GetObjectZOrder(*pObj);
+
         CSize size = m_ptCtr - GetMidRect(rct);
         pDoc->PlaceObjectOnBoard(pPBrdDest, pObj, size, m_ePos);
     }
@@ -631,6 +793,32 @@ void CBoardMarkerMove::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     }
 }
 
+void CBoardMarkerMove::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    m_bUndo = FALSE;
+
+    CDrawObj* pObj;
+    CPlayBoard* pPBoard = pDoc->FindObjectOnBoard(m_dwObjID, &pObj);
+    ASSERT(pPBoard != NULL);
+    if (pPBoard == NULL)
+        return;
+
+    if (m_bUndoCreated)
+    {
+        std::vector<CB::not_null<CDrawObj*>> list;
+        list.push_back(pObj);
+        pDoc->DeleteObjectsInTable(list);
+    }
+    else
+    {
+        CPlayBoard* pPBrdPrev = pDoc->GetPBoardManager()->
+            GetPBoardBySerial(m_nUndoBrdNum);
+        ASSERT(pPBrdPrev != NULL);
+        pDoc->RestoreObjectOnBoard(pPBrdPrev, pObj, m_ptUndoCtr, m_nUndoZOrder);
+    }
+}
+
 void CBoardMarkerMove::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
@@ -660,7 +848,7 @@ void CBoardMarkerMove::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
     wsprintf(szBfr, "    board = %d, pos = %d, dwObjID = %lX, mid = %d, @(%d, %d)\r\n",
-        value_preserving_cast<int>(static_cast<WORD>(m_nBrdNum)), m_ePos, m_dwObjID, value_preserving_cast<int>(static_cast<WORD>(m_mid)), m_ptCtr.x, m_ptCtr.y);
+        value_preserving_cast<int>(m_nBrdNum), m_ePos, m_dwObjID, value_preserving_cast<int>(m_mid), m_ptCtr.x, m_ptCtr.y);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -672,6 +860,7 @@ CObjectDelete::CObjectDelete(ObjectID dwObjID)
 {
     m_eType = mrecDelObj;
     m_dwObjID = dwObjID;
+    m_bUndo = FALSE;
 }
 
 void CObjectDelete::DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup)
@@ -693,14 +882,41 @@ void CObjectDelete::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     CDrawObj* pObj;
     CPlayBoard* pPBoard = pDoc->FindObjectOnBoard(m_dwObjID, &pObj);
 
+    // Keep a copy so the deletion can be reversed.
+    m_bUndo = TRUE;
+    m_pUndoObj = nullptr;
     if (pPBoard != NULL)
     {
+        m_pUndoObj = pObj->Clone(pDoc);
+        m_nUndoBrdNum = pPBoard->GetSerialNumber();
+        m_nUndoZOrder = pPBoard->GetPieceList()->GetObjectZOrder(*pObj);
+        m_strUndoObjText = pDoc->GetGameElementString(MakeObjectIDElement(m_dwObjID));
+
         std::vector<CB::not_null<CDrawObj*>> list;
         list.push_back(pObj);
         pDoc->DeleteObjectsInTable(list);
     }
 }
 
+void CObjectDelete::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    m_bUndo = FALSE;
+    if (m_pUndoObj == NULL)
+        return;                     // Nothing was deleted
+
+    CPlayBoard* pPBoard = pDoc->GetPBoardManager()->
+        GetPBoardBySerial(m_nUndoBrdNum);
+    ASSERT(pPBoard != NULL);
+
+    CRect rct = m_pUndoObj->GetRect();
+    pDoc->RestoreObjectOnBoard(pPBoard, m_pUndoObj->Clone(pDoc),
+        GetMidRect(rct), m_nUndoZOrder);
+    if (!m_strUndoObjText.IsEmpty())
+        pDoc->SetGameElementString(MakeObjectIDElement(m_dwObjID), m_strUndoObjText);
+    m_pUndoObj = nullptr;
+}
+
 void CObjectDelete::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
@@ -728,6 +944,7 @@ CObjectSetText::CObjectSetText(GameElement elem, LPCTSTR pszText)
     m_elem = elem;
     if (pszText != NULL)
         m_strObjText = pszText;
+    m_bUndo = FALSE;
 }
 
 BOOL CObjectSetText::IsMoveHidden(CGamDoc* pDoc, int nMoveWithinGroup)
@@ -767,6 +984,9 @@ void CObjectSetText::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     CDrawObj* pObj;
     CPieceObj* pPObj;
 
+    m_strUndoObjText = pDoc->GetGameElementString(m_elem);
+    m_bUndo = TRUE;
+
     pDoc->SetGameElementString(m_elem,
         m_strObjText.IsEmpty() ? NULL : (LPCTSTR)m_strObjText);
 
@@ -794,18 +1014,25 @@ void CObjectSetText::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     }
 }
 
+void CObjectSetText::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    pDoc->SetGameElementString(m_elem,
+        m_strUndoObjText.IsEmpty() ? NULL : (LPCTSTR)m_strUndoObjText);
+    m_bUndo = FALSE;
+}
+
 void CObjectSetText::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
     if (ar.IsStoring())
     {
-        ar << (DWORD)m_elem;
+        SerializeGameElement(ar, m_elem);
         ar << m_strObjText;
     }
     else
     {
-        DWORD dwTmp;
-        ar >> dwTmp; m_elem = (GameElement)dwTmp;
+        SerializeGameElement(ar, m_elem);
         ar >> m_strObjText;
     }
 }
@@ -814,7 +1041,8 @@ void CObjectSetText::Serialize(CArchive& ar)
 void CObjectSetText::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
-    wsprintf(szBfr, "    elem = %lX, text = \"%s\"\r\n", m_elem, (LPCTSTR)m_strObjText);
+    wsprintf(szBfr, "    elem = %08lX%08lX, text = \"%s\"\r\n",
+        (DWORD)(m_elem >> 32), (DWORD)m_elem, (LPCTSTR)m_strObjText);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -827,6 +1055,7 @@ CObjectLockdown::CObjectLockdown(GameElement elem, BOOL bLockState)
     m_eType = mrecLockObj;
     m_elem = elem;
     m_bLockState = bLockState;
+    m_bUndo = FALSE;
 }
 
 BOOL CObjectLockdown::IsMoveHidden(CGamDoc* pDoc, int nMoveWithinGroup)
@@ -871,8 +1100,12 @@ void CObjectLockdown::DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup)
 
     ASSERT(pObj != NULL);
 
+    m_bUndo = pObj != NULL;
     if (pObj != NULL)
+    {
+        m_bUndoLockState = (pObj->GetDObjFlags() & dobjFlgLockDown) != 0;
         pObj->ModifyDObjFlags(dobjFlgLockDown, m_bLockState);
+    }
 
     if (pPBoard != NULL)
     {
@@ -915,19 +1148,39 @@ void CObjectLockdown::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     }
 }
 
+void CObjectLockdown::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    ASSERT(m_bUndo);
+    CDrawObj* pObj;
+    CPieceObj* pPObj;
+    CPlayBoard* pPBoard;
+
+    if (IsGameElementAPiece(m_elem))
+    {
+        pPBoard = pDoc->FindPieceOnBoard(GetPieceIDFromElement(m_elem), &pPObj);
+        pObj = pPObj;
+    }
+    else
+        pPBoard = pDoc->FindObjectOnBoard(static_cast<ObjectID>(m_elem), &pObj);
+
+    ASSERT(pObj != NULL);
+    if (pObj != NULL)
+        pObj->ModifyDObjFlags(dobjFlgLockDown, m_bUndoLockState);
+    m_bUndo = FALSE;
+}
+
 void CObjectLockdown::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
     if (ar.IsStoring())
     {
-        ar << (DWORD)m_elem;
+        SerializeGameElement(ar, m_elem);
         ar << (WORD)m_bLockState;
     }
     else
     {
-        DWORD dwTmp;
         WORD wTmp;
-        ar >> dwTmp; m_elem = (GameElement)dwTmp;
+        SerializeGameElement(ar, m_elem);
         ar >> wTmp; m_bLockState = (BOOL)wTmp;
     }
 }
@@ -936,7 +1189,8 @@ void CObjectLockdown::Serialize(CArchive& ar)
 void CObjectLockdown::DumpToTextFile(CFile& file)
 {
     char szBfr[256];
-    wsprintf(szBfr, "    elem = %lX, state = %d\r\n", m_elem, m_bLockState);
+    wsprintf(szBfr, "    elem = %08lX%08lX, state = %d\r\n",
+        (DWORD)(m_elem >> 32), (DWORD)m_elem, m_bLockState);
     file.Write(szBfr, lstrlen(szBfr));
 }
 #endif
@@ -1038,6 +1292,13 @@ void CMessageRcd::DoMove(CGamDoc* pDoc, int nMoveWithinGroup)
     pDoc->MsgSetMessageText(m_strMsg);
 }
 
+void CMessageRcd::UndoMove(CGamDoc* pDoc, int nMoveWithinGroup)
+{
+    CStringArray& astrMsgHist = pDoc->MsgGetMessageHistory();
+    if (!astrMsgHist.IsEmpty())
+        astrMsgHist.RemoveAt(astrMsgHist.GetUpperBound());
+}
+
 void CMessageRcd::Serialize(CArchive& ar)
 {
     CMoveRecord::Serialize(ar);
@@ -1101,7 +1362,7 @@ void CEventMessageRcd::Serialize(CArchive& ar)
         else
         {
             ar << value_preserving_cast<WORD>(m_nTray);
-            ar << value_preserving_cast<DWORD>(static_cast<WORD>(m_pieceID));
+            ar << value_preserving_cast<DWORD>(m_pieceID);
             ar << (DWORD)0;
         }
         ar << m_strMsg;
@@ -1120,7 +1381,9 @@ void CEventMessageRcd::Serialize(CArchive& ar)
         else
         {
             ar >> wTmp; m_nTray = value_preserving_cast<size_t>(wTmp);
-            ar >> dwTmp; m_pieceID = static_cast<PieceID>(dwTmp);
+            ar >> dwTmp;
+            m_pieceID = IsLoadingWideIDs() ? static_cast<PieceID>(dwTmp) :
+                PieceID::FromWORD(value_preserving_cast<WORD>(dwTmp));
             ar >> dwTmp;
         }
         ar >> m_strMsg;
@@ -1134,12 +1397,12 @@ void CEventMessageRcd::DumpToTextFile(CFile& file)
     if (m_bIsBoardEvent)
     {
         wsprintf(szBfr, "    BoardEvt = %s, nBoard = %d, (x, y) = (%d, %d)\r\n",
-                 (LPCTSTR)(m_bIsBoardEvent ? "TRUE" : "FALSE"), value_preserving_cast<int>(static_cast<WORD>(m_nBoard)), m_x, m_y);
+                 (LPCTSTR)(m_bIsBoardEvent ? "TRUE" : "FALSE"), value_preserving_cast<int>(m_nBoard), m_x, m_y);
     }
     else
     {
         wsprintf(szBfr, "    BoardEvt = %s, nTray = %zu, pieceID = %d\r\n",
-                 (LPCTSTR)(m_bIsBoardEvent ? "TRUE" : "FALSE"), m_nTray, value_preserving_cast<int>(static_cast<WORD>(m_pieceID)));
+                 (LPCTSTR)(m_bIsBoardEvent ? "TRUE" : "FALSE"), m_nTray, value_preserving_cast<int>(m_pieceID));
     }
     file.Write(szBfr, lstrlen(szBfr));
 }
@@ -1171,8 +1434,15 @@ void CCompoundMove::DumpToTextFile(CFile& file)
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
 
+// Defaults for the replay checkpoints. The budget bounds how many
+// game state snapshots a move list may hold. Once it is exceeded every
+// other checkpoint is dropped and the interval is doubled.
+size_t CMoveList::c_nCheckpointInterval = size_t(16);
+size_t CMoveList::c_nMaxCheckpoints = size_t(64);
+
 CMoveList::CMoveList()
 {
+    m_nCheckpointInterval = c_nCheckpointInterval;
     m_nSeqNum = 0;
     m_nSkipCount = 0;
     m_bSkipKeepInd = FALSE;
@@ -1182,6 +1452,9 @@ CMoveList::CMoveList()
     m_pCompoundBaseBookMark = NULL;
     m_bCompoundSingleStep = FALSE;
     m_pStateSave = NULL;
+    m_bIndexValid = TRUE;
+    m_bGroupStateHash = FALSE;
+    m_bDesyncReported = FALSE;
 }
 
 CMoveList::~CMoveList()
@@ -1199,6 +1472,9 @@ CMoveList::~CMoveList()
 
 OwnerPtr<CMoveList> CMoveList::CloneMoveList(CGamDoc* pDoc, CMoveList& pMoveList)
 {
+    // The copy is always in the current format.
+    SetLoadingVersionGuard<CGamDoc> setLoadingVersionGuard(
+        NumVersion(fileGmvVerMajor, fileGmvVerMinor));
     CMemFile memFile;
     CArchive arStore(&memFile, CArchive::store);
     arStore.m_pDocument = pDoc;
@@ -1241,19 +1517,11 @@ bool CMoveList::IsWithinCompoundMove(size_t nIndex)
 {
     if (nIndex == Invalid_v<size_t>)
         return false;
+    ASSERT(nIndex < size());
+    if (nIndex >= size())
+        return false;
 
-    iterator posPrev = FindIndex(nIndex);
-
-    // Start looking on previous record.
-    if (posPrev != end())
-        GetPrev(posPrev);
-    while (posPrev != end())
-    {
-        CMoveRecord& pRcd = GetPrev(posPrev);
-        if (pRcd.GetType() == CMoveRecord::mrecCompoundMove)
-            return static_cast<CCompoundMove&>(pRcd).IsGroupBegin();
-    }
-    return false;
+    return GetCompoundMoveBegin(nIndex) != Invalid_v<size_t>;
 }
 
 // Returns the starting move index
@@ -1290,11 +1558,19 @@ void CMoveList::PushAndSetState(CGamDoc* pDoc, size_t nIndex)
     m_bQuietPlaybackSave = pDoc->IsQuietPlayback();
     pDoc->SetQuietPlayback(TRUE);
 
-    size_t nCurIndex = SetStartingState();
-    if (nCurIndex < nIndex)
+    // Start from the closest checkpoint and leave new ones behind
+    // so the next backward step has less to replay.
+    size_t nCurIndex = RestoreNearestCheckpoint(pDoc, nIndex);
+    size_t nGroups = size_t(0);
+    while (nCurIndex < nIndex)
     {
-        while ((nCurIndex = DoMove(pDoc, nCurIndex)) < nIndex)
-            pDoc->FlushAllIndicators();
+        nCurIndex = DoMove(pDoc, nCurIndex);
+        pDoc->FlushAllIndicators();
+        if (nCurIndex < nIndex && ++nGroups >= m_nCheckpointInterval)
+        {
+            AddCheckpoint(pDoc, nCurIndex);
+            nGroups = size_t(0);
+        }
     }
     pDoc->FlushAllIndicators();
 }
@@ -1310,11 +1586,181 @@ void CMoveList::PopAndRestoreState(CGamDoc* pDoc)
     pDoc->SetQuietPlayback(m_bQuietPlaybackSave);
 }
 
-size_t CMoveList::FindPreviousMove(CGamDoc* pDoc, size_t nIndex)
+/////////////////////////////////////////////////////////////////////
+// Replay checkpoint support....
+
+void CMoveList::SetCheckpointPolicy(size_t nInterval, size_t nMaxCheckpoints)
 {
-    iterator     posPrev;
-    size_t       nCurIndex;
+    // An interval or budget of zero disables checkpoints.
+    c_nCheckpointInterval = nInterval;
+    c_nMaxCheckpoints = nMaxCheckpoints;
+}
+
+// Restores the game state to the checkpoint closest to (but not after)
+// nIndex. If there isn't one the starting state is used. Returns the
+// move index the state corresponds to.
+size_t CMoveList::RestoreNearestCheckpoint(CGamDoc* pDoc, size_t nIndex)
+{
+    std::map<size_t, OwnerPtr<CGameState>>::iterator pos =
+        m_mapCheckpoints.upper_bound(nIndex);
+    while (pos != m_mapCheckpoints.begin())
+    {
+        --pos;
+        if (pos->second->RestoreState())
+            return pos->first;
+        // Can't use it. Toss it and try an earlier one.
+        pos = m_mapCheckpoints.erase(pos);
+    }
+    return SetStartingState();
+}
+
+void CMoveList::AddCheckpoint(CGamDoc* pDoc, size_t nIndex)
+{
+    if (m_nCheckpointInterval == size_t(0) || c_nMaxCheckpoints == size_t(0))
+        return;
+    if (nIndex == Invalid_v<size_t> || nIndex >= size())
+        return;
+    if (m_mapCheckpoints.find(nIndex) != m_mapCheckpoints.end())
+        return;
+    // Replay treats compound moves as a unit so never start within one.
+    if (IsWithinCompoundMove(nIndex))
+        return;
+
+    OwnerPtr<CGameState> pState = MakeOwner<CGameState>(pDoc);
+    if (!pState->SaveState())
+        return;                     // Memory is tight. Do without.
+    m_mapCheckpoints.insert(std::make_pair(nIndex, std::move(pState)));
+
+    if (m_mapCheckpoints.size() > c_nMaxCheckpoints)
+    {
+        // Over budget. Thin out the checkpoints and space future
+        // ones further apart.
+        std::map<size_t, OwnerPtr<CGameState>>::iterator pos = m_mapCheckpoints.begin();
+        while (pos != m_mapCheckpoints.end())
+        {
+            pos = m_mapCheckpoints.erase(pos);
+            if (pos != m_mapCheckpoints.end())
+                ++pos;
+        }
+        m_nCheckpointInterval *= size_t(2);
+    }
+}
+
+// Discards checkpoints which follow move index nIndex.
+void CMoveList::PurgeCheckpoints(size_t nIndex /* = 0 */)
+{
+    if (nIndex == size_t(0))
+    {
+        m_mapCheckpoints.clear();
+        m_nCheckpointInterval = c_nCheckpointInterval;
+    }
+    else
+        m_mapCheckpoints.erase(m_mapCheckpoints.upper_bound(nIndex),
+            m_mapCheckpoints.end());
+}
+
+// Used during playback to skip forward from nFromIndex to the
+// checkpoint closest to nIndex. Message records in the skipped
+// range are still processed so the message history stays the same
+// as if every move had been played. Returns the move index reached.
+size_t CMoveList::SeekToCheckpoint(CGamDoc* pDoc, size_t nFromIndex, size_t nIndex)
+{
+    ASSERT(m_nPlaybackLock == 0);
+    if (m_nPlaybackLock != 0 || nFromIndex >= size())
+        return nFromIndex;
+
+    std::map<size_t, OwnerPtr<CGameState>>::iterator posChk =
+        m_mapCheckpoints.upper_bound(nIndex);
+    if (posChk == m_mapCheckpoints.begin())
+        return nFromIndex;
+    --posChk;
+    if (posChk->first <= nFromIndex)
+        return nFromIndex;
 
+    if (!posChk->second->RestoreState())
+    {
+        m_mapCheckpoints.erase(posChk);
+        return nFromIndex;
+    }
+    size_t nCurIndex = posChk->first;
+
+    ReplayMessages(pDoc, nFromIndex, nCurIndex);
+    return nCurIndex;
+}
+
+// Plays only the message records in the range so the message
+// history can be rebuilt without replaying the moves.
+void CMoveList::ReplayMessages(CGamDoc* pDoc, size_t nIndex, size_t nEndIndex)
+{
+    iterator pos = FindIndex(nIndex);
+    for (size_t i = nIndex; i < nEndIndex && pos != end(); i++)
+    {
+        CMoveRecord& pRcd = GetNext(pos);
+        if (pRcd.GetType() == CMoveRecord::mrecMsg)
+            pRcd.DoMove(pDoc, 0);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////
+// Move reversal support....
+
+// Returns true if every record in the range has captured the
+// state it replaced.
+bool CMoveList::CanUndoMoves(size_t nIndex, size_t nEndIndex)
+{
+    if (nEndIndex == Invalid_v<size_t> || nEndIndex > size())
+        nEndIndex = size();
+    if (nIndex >= nEndIndex)
+        return false;
+
+    iterator pos = FindIndex(nIndex);
+    for (size_t i = nIndex; i < nEndIndex; i++)
+    {
+        if (!GetNext(pos).CanUndo())
+            return false;
+    }
+    return true;
+}
+
+// Reverses the records in the range, last one first. The document
+// is left in the state it was in before record nIndex was played.
+void CMoveList::UndoMoves(CGamDoc* pDoc, size_t nIndex, size_t nEndIndex)
+{
+    ASSERT(m_nPlaybackLock == 0);
+    ASSERT(CanUndoMoves(nIndex, nEndIndex));
+    if (nEndIndex == Invalid_v<size_t> || nEndIndex > size())
+        nEndIndex = size();
+
+    m_nPlaybackLock++;                  // No playback or appends meanwhile
+
+    // Work out each record's position within its group the same
+    // way DoMove() does.
+    std::vector<std::pair<CMoveRecord*, int>> tblRcds;
+    tblRcds.reserve(nEndIndex - nIndex);
+    iterator pos = FindIndex(nIndex);
+    int nGrp = INT_MIN;
+    int nElementInGroup = 0;
+    for (size_t i = nIndex; i < nEndIndex; i++)
+    {
+        CMoveRecord& pRcd = GetNext(pos);
+        if (pRcd.GetType() == CMoveRecord::mrecCompoundMove)
+            continue;
+        if (pRcd.GetSeqNum() != nGrp)
+        {
+            nGrp = pRcd.GetSeqNum();
+            nElementInGroup = 0;
+        }
+        tblRcds.push_back(std::make_pair(&pRcd, nElementInGroup++));
+    }
+
+    for (size_t i = tblRcds.size(); i-- > size_t(0); )
+        tblRcds[i].first->UndoMove(pDoc, tblRcds[i].second);
+
+    m_nPlaybackLock--;
+}
+
+size_t CMoveList::FindPreviousMove(CGamDoc* pDoc, size_t nIndex)
+{
     BOOL bWithinCompoundMove = IsWithinCompoundMove(nIndex);
     if (bWithinCompoundMove && !m_bCompoundSingleStep)
     {
@@ -1322,36 +1768,85 @@ size_t CMoveList::FindPreviousMove(CGamDoc* pDoc, size_t nIndex)
         // and then turned of while we were stepping WITHIN a
         // compound move group. In this case we simply locate the
         // starting record and return that record number.
-        nCurIndex = nIndex;
-        posPrev = FindIndex(nCurIndex);
-        GetPrev(posPrev);           // Point to previous record.
-        while (TRUE)
-        {
-            CMoveRecord& pRcd = GetPrev(posPrev);
-            nCurIndex--;
-            if (pRcd.GetType() == CMoveRecord::mrecCompoundMove)
-                return nCurIndex;           // Found it.
-        }
+        return GetCompoundMoveBegin(nIndex);
+    }
+
+    while (TRUE)
+    {
+        BOOL bMayBeHidden;
+        size_t nCurIndex = StepToPreviousMove(nIndex, bMayBeHidden);
+        if (!bMayBeHidden)
+            return nCurIndex;
+
+        // If this move is hidden for this player, step back another move
+        // and try again.
+        PushAndSetState(pDoc, nCurIndex);   // Need to make sure game state is correct
+        BOOL bMoveIsHidden = IsMoveHidden(pDoc, nCurIndex);
+        PopAndRestoreState(pDoc);
+
+        if (!bMoveIsHidden)
+            return nCurIndex;
+        nIndex = nCurIndex;                 // Back another record
+    }
+}
+
+// Does what FindPreviousMove() does by reversing the records instead
+// of replaying them from an earlier state. The document must be in
+// the state for nIndex and is left in the state for the returned
+// index. Invalid_v<size_t> is returned if a record can't be reversed.
+// The document may have been backed up part way in that case.
+size_t CMoveList::UndoToPreviousMove(CGamDoc* pDoc, size_t nIndex)
+{
+    if (IsWithinCompoundMove(nIndex) && !m_bCompoundSingleStep)
+    {
+        size_t nCurIndex = GetCompoundMoveBegin(nIndex);
+        if (!CanUndoMoves(nCurIndex, nIndex))
+            return Invalid_v<size_t>;
+        UndoMoves(pDoc, nCurIndex, nIndex);
+        return nCurIndex;
+    }
+
+    while (nIndex != size_t(0))
+    {
+        BOOL bMayBeHidden;
+        size_t nCurIndex = StepToPreviousMove(nIndex, bMayBeHidden);
+        if (!CanUndoMoves(nCurIndex, nIndex))
+            break;
+        UndoMoves(pDoc, nCurIndex, nIndex);
+
+        // The game state is now what the move was played against
+        // so its visibility can be checked directly.
+        if (!bMayBeHidden || !IsMoveHidden(pDoc, nCurIndex))
+            return nCurIndex;
+        nIndex = nCurIndex;                 // Back another record
     }
+    return Invalid_v<size_t>;
+}
+
+// Returns the index of the move group before nIndex. bMayBeHidden is
+// set if the group has to be checked for being hidden from the
+// current player.
+size_t CMoveList::StepToPreviousMove(size_t nIndex, BOOL& bMayBeHidden)
+{
+    size_t       nCurIndex;
+
+    bMayBeHidden = FALSE;
 
 CHECK_AGAIN:
     if (nIndex != Invalid_v<size_t>)
     {
-        nCurIndex = nIndex - size_t(1);
-        posPrev = FindIndex(nIndex);
-        ASSERT(posPrev != end());
-        if (posPrev == end())
+        ASSERT(nIndex < size());
+        if (nIndex >= size())
             return size_t(0);
-        CMoveRecord& pRcd = GetPrev(posPrev);// First GetPrev() gets current record
+        nCurIndex = nIndex - size_t(1);
     }
     else
     {
         // We are past the end of the list. Last record is end
         // of previous move.
-        posPrev = --end();
         nCurIndex = size() - size_t(1);
     }
-    CB::not_null<CMoveRecord*> pRcd = &GetPrev(posPrev);
+    CB::not_null<CMoveRecord*> pRcd = &GetRecordAt(nCurIndex);
 
     // Another weird special case...If the record is an end of compound
     // move record and we are in single step mode, then step back one more
@@ -1360,54 +1855,31 @@ CHECK_AGAIN:
         pRcd->GetType() == CMoveRecord::mrecCompoundMove &&
         !static_cast<CCompoundMove&>(*pRcd).IsGroupBegin())
     {
-        pRcd = &GetPrev(posPrev);
         nCurIndex--;
+        pRcd = &GetRecordAt(nCurIndex);
     }
 
     // Use different search approach depending on whether or not the
     // previous record ended a compound move.
 
-    ASSERT(nCurIndex >= 0);
     if (pRcd->GetType() == CMoveRecord::mrecCompoundMove &&
         !static_cast<CCompoundMove&>(*pRcd).IsGroupBegin() && !m_bCompoundSingleStep)
     {
-        // Previous move ended a compound move. Search for
-        // starting record of this compound move grouping.
-        while (TRUE)
-        {
-            pRcd = &GetPrev(posPrev);
-            nCurIndex--;
-            if (pRcd->GetType() == CMoveRecord::mrecCompoundMove)
-                break;          // Found it.
-        }
+        // Previous move ended a compound move. The starting record
+        // of this compound move grouping is in the index.
+        nCurIndex = GetCompoundMoveBegin(nCurIndex);
     }
     else
     {
-        // Search for starting record with this sequence number.
-        int nSeqNum = pRcd->GetSeqNum();
-        do
-        {
-            pRcd = &GetPrev(posPrev);
-            nCurIndex--;
-        }
-        while (pRcd->GetSeqNum() == nSeqNum);
-        nCurIndex++;
-        if ((pRcd->GetType() == CMoveRecord::mrecCompoundMove && m_bCompoundSingleStep))
-        {
-            nIndex = nCurIndex;
-            goto CHECK_AGAIN;       // Back another record
-        }
-        // If this move is hidden for this player, step back another move
-        // and try again.
-        PushAndSetState(pDoc, nCurIndex);   // Need to make sure game state is correct
-        BOOL bMoveIsHidden = IsMoveHidden(pDoc, nCurIndex);
-        PopAndRestoreState(pDoc);
-
-        if (bMoveIsHidden)
+        // Starting record with this sequence number is in the index.
+        nCurIndex = GetGroupStart(nCurIndex);
+        if (m_bCompoundSingleStep && nCurIndex > size_t(0) &&
+            GetRecordAt(nCurIndex - size_t(1)).GetType() == CMoveRecord::mrecCompoundMove)
         {
             nIndex = nCurIndex;
             goto CHECK_AGAIN;       // Back another record
         }
+        bMayBeHidden = TRUE;
     }
     ASSERT(nCurIndex != Invalid_v<size_t>);
     return nCurIndex;
@@ -1493,8 +1965,19 @@ size_t CMoveList::DoMove(CGamDoc* pDoc, size_t nIndex, BOOL bAutoStepHiddenMove
             if (posFirst == end())
                 break;
 
-            // First check for compound move record...
+            // The state the group was recorded against should be
+            // the state it's played against. If not the games have
+            // drifted apart. Players are told once per move list.
             CMoveRecord& pRcd = GetAt(posFirst);
+            if (pRcd.HasStateHash() && !m_bDesyncReported &&
+                pRcd.GetStateHash() != CGameState::CalcMoveStateHash(*pDoc))
+            {
+                m_bDesyncReported = TRUE;
+                TRACE1("CMoveList::DoMove - Game state differs at move %zu\n", nIndex);
+                AfxMessageBox(IDS_WARN_MOVE_DESYNC, MB_OK | MB_ICONEXCLAMATION);
+            }
+
+            // First check for compound move record...
             if (pRcd.GetType() == CMoveRecord::mrecCompoundMove)
             {
                 GetNext(posFirst);              // Step past record
@@ -1630,10 +2113,38 @@ CMoveList::iterator CMoveList::AppendMoveRecord(OwnerPtr<CMoveRecord> pRec)
         return end();
 
     pRec->SetSeqNum(m_nSeqNum);
+    if (m_bGroupStateHash)
+    {
+        pRec->SetStateHash(m_nGroupStateHash);
+        m_bGroupStateHash = FALSE;
+    }
     push_back(std::move(pRec));
+    if (m_bIndexValid)
+        IndexRecord(size() - size_t(1));
     return --end();
 }
 
+CMoveList::iterator CMoveList::insert(iterator pos, OwnerPtr<CMoveRecord> pRec)
+{
+    PurgeCheckpoints();
+    InvalidateIndex();
+    return BASE::insert(pos, std::move(pRec));
+}
+
+CMoveList::iterator CMoveList::erase(iterator pos)
+{
+    PurgeCheckpoints();
+    InvalidateIndex();
+    return BASE::erase(pos);
+}
+
+void CMoveList::pop_front()
+{
+    PurgeCheckpoints();
+    InvalidateIndex();
+    BASE::erase(begin());
+}
+
 CMoveList::iterator CMoveList::PrependMoveRecord(OwnerPtr<CMoveRecord> pRec,
     BOOL bSetSeqNum /* = TRUE */)
 {
@@ -1643,8 +2154,9 @@ CMoveList::iterator CMoveList::PrependMoveRecord(OwnerPtr<CMoveRecord> pRec,
 
     if (bSetSeqNum)
         pRec->SetSeqNum(m_nSeqNum);
-    push_front(std::move(pRec));
-    return begin();
+    PurgeCheckpoints();
+    InvalidateIndex();
+    return BASE::insert(begin(), std::move(pRec));
 }
 
 void CMoveList::PurgeAfter(size_t nIndex)
@@ -1667,9 +2179,13 @@ void CMoveList::PurgeAfter(size_t nIndex)
     iterator pos = FindIndex(nIndex);
     if (pos == end())
         return;             // Doesn't exist
-    while (pos != end())
+    PurgeCheckpoints(nIndex);
+    BASE::erase(pos, end());
+    if (m_bIndexValid)
     {
-        erase(pos++);
+        // Entries for the remaining records are unaffected.
+        m_tblGroupStart.resize(nIndex);
+        m_tblCompoundBegin.resize(nIndex);
     }
 }
 
@@ -1686,7 +2202,11 @@ void CMoveList::Clear()
     m_nCompoundBaseIndex = Invalid_v<size_t>;
 
     m_nSeqNum = 0;
+    PurgeCheckpoints();
     clear();
+    m_tblGroupStart.clear();
+    m_tblCompoundBegin.clear();
+    m_bIndexValid = TRUE;
 }
 
 void CMoveList::BeginRecordingCompoundMove(CGamDoc* pDoc)
@@ -1787,14 +2307,14 @@ void CMoveList::Serialize(CArchive& ar, BOOL bSaveUndo)
     {
         ASSERT(m_pStateSave == NULL); // Should never save with this active!
 
-        ar << (short)m_nSeqNum;
+        ar << (LONG)m_nSeqNum;
         ar << (WORD)m_bCompoundMove;
         ar << value_preserving_cast<DWORD>(m_nCompoundBaseIndex);
         ar << (BYTE)(m_pCompoundBaseBookMark != NULL ? 1 : 0);
         if (m_pCompoundBaseBookMark)
             m_pCompoundBaseBookMark->Serialize(ar);
 
-        ar << value_preserving_cast<WORD>(size());
+        ar << value_preserving_cast<DWORD>(size());
         iterator pos;
         for (pos = begin(); pos != end(); )
         {
@@ -1806,10 +2326,19 @@ void CMoveList::Serialize(CArchive& ar, BOOL bSaveUndo)
     else
     {
         Clear();
-        WORD wCount;
-        short sTmp;
+        size_t nCount;
+        BOOL bWide = CGamDoc::GetLoadingVersion() >= NumVersion(4, 0);  // V4.00
 
-        ar >> sTmp; m_nSeqNum = (int)sTmp;
+        if (bWide)
+        {
+            LONG lTmp;
+            ar >> lTmp; m_nSeqNum = (int)lTmp;
+        }
+        else
+        {
+            short sTmp;
+            ar >> sTmp; m_nSeqNum = (int)sTmp;
+        }
 
         if (CGamDoc::GetLoadingVersion() >= NumVersion(0, 60))
         {
@@ -1829,8 +2358,19 @@ void CMoveList::Serialize(CArchive& ar, BOOL bSaveUndo)
             }
         }
 
-        ar >> wCount;
-        for (WORD i = 0; i < wCount; i++)
+        if (bWide)
+        {
+            DWORD dwCount;
+            ar >> dwCount; nCount = value_preserving_cast<size_t>(dwCount);
+        }
+        else
+        {
+            WORD wCount;
+            ar >> wCount; nCount = value_preserving_cast<size_t>(wCount);
+        }
+        InvalidateIndex();
+        reserve(nCount);
+        for (size_t i = 0; i < nCount; i++)
         {
             OwnerOrNullPtr<CMoveRecord> pRcd;
             short sType;
@@ -1936,10 +2476,60 @@ CMoveList::iterator CMoveList::FindIndex(size_t nIndex)
         ASSERT(!"out of bounds");
         return end();
     }
-    iterator retval = begin();
-    for (size_t i = size_t(0) ; i < nIndex ; ++i)
+    return begin() + value_preserving_cast<ptrdiff_t>(nIndex);
+}
+
+/////////////////////////////////////////////////////////////////////
+// Record index support....
+
+// Returns the index of the first record in nIndex's move group.
+size_t CMoveList::GetGroupStart(size_t nIndex)
+{
+    ASSERT(nIndex < size());
+    if (!m_bIndexValid)
     {
-        ++retval;
+        m_tblGroupStart.clear();
+        m_tblCompoundBegin.clear();
+        m_tblGroupStart.reserve(size());
+        m_tblCompoundBegin.reserve(size());
+        for (size_t i = size_t(0); i < size(); i++)
+            IndexRecord(i);
+        m_bIndexValid = TRUE;
     }
-    return retval;
+    return m_tblGroupStart[nIndex];
+}
+
+// Returns the index of the compound move begin record that nIndex
+// follows or Invalid_v<size_t> if it isn't within a compound move.
+size_t CMoveList::GetCompoundMoveBegin(size_t nIndex)
+{
+    GetGroupStart(nIndex);              // Make sure index is current
+    return m_tblCompoundBegin[nIndex];
+}
+
+// Adds the index entries for a record. All records prior to it
+// must already be indexed.
+void CMoveList::IndexRecord(size_t nIndex)
+{
+    ASSERT(m_tblGroupStart.size() == nIndex && m_tblCompoundBegin.size() == nIndex);
+    if (nIndex == size_t(0))
+    {
+        m_tblGroupStart.push_back(nIndex);
+        m_tblCompoundBegin.push_back(Invalid_v<size_t>);
+        return;
+    }
+    CMoveRecord& pPrev = GetRecordAt(nIndex - size_t(1));
+
+    if (pPrev.GetSeqNum() == GetRecordAt(nIndex).GetSeqNum())
+        m_tblGroupStart.push_back(m_tblGroupStart[nIndex - size_t(1)]);
+    else
+        m_tblGroupStart.push_back(nIndex);
+
+    if (pPrev.GetType() == CMoveRecord::mrecCompoundMove)
+    {
+        m_tblCompoundBegin.push_back(static_cast<CCompoundMove&>(pPrev).IsGroupBegin() ?
+            nIndex - size_t(1) : Invalid_v<size_t>);
+    }
+    else
+        m_tblCompoundBegin.push_back(m_tblCompoundBegin[nIndex - size_t(1)]);
 }
@@ -25,9 +25,14 @@
 #ifndef _MOVEMGR_H
 #define _MOVEMGR_H
 
-//#include <list>
+#include <vector>
+#include <map>
 #include "GamState.h"
 
+#ifndef     _DRAWOBJ_H
+#include    "DrawObj.h"
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 
 class CMoveRecord
@@ -46,7 +51,7 @@ public:
         mrecMax };
 
 public:
-    CMoveRecord() { m_nSeqNum = -1; m_eType = mrecUnknown; }
+    CMoveRecord() { m_nSeqNum = -1; m_eType = mrecUnknown; m_bHasStateHash = FALSE; }
     virtual ~CMoveRecord() {}
 
 public:
@@ -54,6 +59,12 @@ public:
     // -------- //
     void SetSeqNum(int nSeq) { m_nSeqNum = nSeq; }
     int  GetSeqNum() { return m_nSeqNum; }
+    // The first record of a move group holds the game's state hash
+    // from when the group was recorded. (3.91)
+    void SetStateHash(uint64_t nHash)
+        { m_nStateHash = nHash; m_bHasStateHash = TRUE; }
+    BOOL HasStateHash() { return m_bHasStateHash; }
+    uint64_t GetStateHash() { return m_nStateHash; }
 
 public:
     virtual BOOL IsMoveHidden(CGamDoc* pDoc, int nMoveWithinGroup) { return FALSE; }
@@ -61,6 +72,12 @@ public:
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup) {}
     virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup) {}
 
+    // Records which change the game state capture whatever they
+    // replace each time they are played (not serialized). Once that's
+    // happened the record can be reversed.
+    virtual BOOL CanUndo() { return FALSE; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup) {}
+
     virtual BOOL ValidatePieces(CGamDoc* pDoc) { return TRUE; }
 
     virtual void Serialize(CArchive& ar);
@@ -71,22 +88,47 @@ public:
 protected:
     int     m_nSeqNum;              // Used to group move records
     RcdType m_eType;                // Type of record
+    BOOL    m_bHasStateHash;
+    uint64_t m_nStateHash;          // Game state before the group
 };
 
 ///////////////////////////////////////////////////////////////////////
 
 enum PlacePos;
 
+// Where a piece was before a move record was played. Used to
+// reverse the move.
+struct PieceUndoLocation
+{
+    PieceUndoLocation() { m_bOnBoard = FALSE; m_dwOwnerMask = 0; }
+
+    void SaveLocation(CGamDoc* pDoc, PieceID pid);
+    void RestoreLocation(CGamDoc* pDoc, PieceID pid);
+
+    BOOL        m_bOnBoard;
+    BoardID     m_nBrdNum;          // Location if on a board...
+    CPoint      m_ptCtr;
+    size_t      m_nZOrder;
+    size_t      m_nTrayNum;         // ...otherwise it's in a tray.
+    size_t      m_nTrayPos;
+    DWORD       m_dwOwnerMask;
+};
+
+///////////////////////////////////////////////////////////////////////
+
 class CBoardPieceMove : public CMoveRecord
 {
 public:
-    CBoardPieceMove() { m_eType = mrecPMove; }
+    CBoardPieceMove() { m_eType = mrecPMove; m_bUndo = FALSE; }
     CBoardPieceMove(BoardID nBrdSerNum, PieceID pid, CPoint pnt, PlacePos ePos);
 
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual BOOL ValidatePieces(CGamDoc* pDoc);
 
     virtual void Serialize(CArchive& ar);
@@ -99,6 +141,9 @@ protected:
     PieceID     m_pid;
     BoardID     m_nBrdNum;
     PlacePos    m_ePos;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    PieceUndoLocation m_locUndo;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -106,13 +151,16 @@ protected:
 class CTrayPieceMove : public CMoveRecord
 {
 public:
-    CTrayPieceMove() { m_eType = mrecTMove; }
+    CTrayPieceMove() { m_eType = mrecTMove; m_bUndo = FALSE; }
     CTrayPieceMove(size_t nTrayNum, PieceID pid, size_t nPos);
 
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual BOOL ValidatePieces(CGamDoc* pDoc);
 
     virtual void Serialize(CArchive& ar);
@@ -124,6 +172,9 @@ protected:
     PieceID     m_pid;
     size_t      m_nTrayNum;
     size_t      m_nPos;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    PieceUndoLocation m_locUndo;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -131,14 +182,17 @@ protected:
 class CPieceSetSide : public CMoveRecord
 {
 public:
-    CPieceSetSide() { m_eType = mrecPSide; }
+    CPieceSetSide() { m_eType = mrecPSide; m_bUndo = FALSE; }
     CPieceSetSide(PieceID pid, BOOL bTopUp)
-        { m_eType = mrecPSide; m_pid = pid; m_bTopUp = bTopUp; }
+        { m_eType = mrecPSide; m_pid = pid; m_bTopUp = bTopUp; m_bUndo = FALSE; }
 
     virtual BOOL IsMoveHidden(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual BOOL ValidatePieces(CGamDoc* pDoc);
 
     virtual void Serialize(CArchive& ar);
@@ -149,6 +203,9 @@ public:
 protected:
     PieceID     m_pid;
     BOOL        m_bTopUp;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    BOOL        m_bUndoTopUp;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -156,14 +213,17 @@ protected:
 class CPieceSetFacing : public CMoveRecord
 {
 public:
-    CPieceSetFacing() { m_eType = mrecPFacing; }
+    CPieceSetFacing() { m_eType = mrecPFacing; m_bUndo = FALSE; }
     CPieceSetFacing(PieceID pid, int nFacingDegCW)
-        { m_eType = mrecPFacing; m_pid = pid; m_nFacingDegCW = nFacingDegCW; }
+        { m_eType = mrecPFacing; m_pid = pid; m_nFacingDegCW = nFacingDegCW; m_bUndo = FALSE; }
 
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 //  virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual BOOL ValidatePieces(CGamDoc* pDoc);
 
     virtual void Serialize(CArchive& ar);
@@ -174,6 +234,9 @@ public:
 protected:
     PieceID     m_pid;
     int         m_nFacingDegCW;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    int         m_nUndoFacingDegCW;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -181,12 +244,15 @@ protected:
 class CPieceSetOwnership : public CMoveRecord
 {
 public:
-    CPieceSetOwnership() { m_eType = mrecPOwner; }
+    CPieceSetOwnership() { m_eType = mrecPOwner; m_bUndo = FALSE; }
     CPieceSetOwnership(PieceID pid, DWORD dwOwnerMask)
-        { m_eType = mrecPOwner; m_pid = pid; m_dwOwnerMask = dwOwnerMask; }
+        { m_eType = mrecPOwner; m_pid = pid; m_dwOwnerMask = dwOwnerMask; m_bUndo = FALSE; }
 
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual BOOL ValidatePieces(CGamDoc* pDoc);
 
     virtual void Serialize(CArchive& ar);
@@ -197,6 +263,9 @@ public:
 protected:
     PieceID     m_pid;
     DWORD       m_dwOwnerMask;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    DWORD       m_dwUndoOwnerMask;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -204,13 +273,16 @@ protected:
 class CMarkerSetFacing : public CMoveRecord
 {
 public:
-    CMarkerSetFacing() { m_eType = mrecMFacing; }
+    CMarkerSetFacing() { m_eType = mrecMFacing; m_bUndo = FALSE; }
     CMarkerSetFacing(ObjectID dwObjID, MarkID mid, int nFacingDegCW);
 
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 //  virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -220,6 +292,9 @@ protected:
     ObjectID    m_dwObjID;
     MarkID      m_mid;
     int         m_nFacingDegCW;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    int         m_nUndoFacingDegCW;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -227,13 +302,16 @@ protected:
 class CBoardMarkerMove : public CMoveRecord
 {
 public:
-    CBoardMarkerMove() { m_eType = mrecMMove; }
+    CBoardMarkerMove() { m_eType = mrecMMove; m_bUndo = FALSE; }
     CBoardMarkerMove(BoardID nBrdSerNum, ObjectID dwObjID, MarkID mid,
         CPoint pnt, PlacePos ePos);
 
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -245,6 +323,12 @@ protected:
     MarkID      m_mid;
     BoardID     m_nBrdNum;
     PlacePos    m_ePos;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    BOOL        m_bUndoCreated;     // Marker was created by the move
+    BoardID     m_nUndoBrdNum;
+    CPoint      m_ptUndoCtr;
+    size_t      m_nUndoZOrder;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -252,13 +336,16 @@ protected:
 class CObjectDelete : public CMoveRecord
 {
 public:
-    CObjectDelete() { m_eType = mrecDelObj; }
+    CObjectDelete() { m_eType = mrecDelObj; m_bUndo = FALSE; }
     CObjectDelete(ObjectID dwObjID);
 
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 //  virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -266,6 +353,12 @@ public:
 #endif
 protected:
     ObjectID    m_dwObjID;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    OwnerOrNullPtr<CDrawObj> m_pUndoObj;// Copy of deleted object
+    BoardID     m_nUndoBrdNum;
+    size_t      m_nUndoZOrder;
+    CString     m_strUndoObjText;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -273,7 +366,7 @@ protected:
 class CObjectSetText : public CMoveRecord
 {
 public:
-    CObjectSetText() { m_eType = mrecSetObjText; }
+    CObjectSetText() { m_eType = mrecSetObjText; m_bUndo = FALSE; }
     CObjectSetText(GameElement elem, LPCTSTR pszText);
 
     virtual BOOL IsMoveHidden(CGamDoc* pDoc, int nMoveWithinGroup);
@@ -281,6 +374,9 @@ public:
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 //  virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -289,6 +385,9 @@ public:
 protected:
     DWORD       m_elem;
     CString     m_strObjText;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    CString     m_strUndoObjText;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -296,13 +395,16 @@ protected:
 class CObjectLockdown : public CMoveRecord
 {
 public:
-    CObjectLockdown() { m_eType = mrecLockObj; }
+    CObjectLockdown() { m_eType = mrecLockObj; m_bUndo = FALSE; }
     CObjectLockdown(GameElement elem, BOOL bLockState);
 
     virtual BOOL IsMoveHidden(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return m_bUndo; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -311,6 +413,9 @@ public:
 protected:
     DWORD       m_elem;
     BOOL        m_bLockState;
+
+    BOOL        m_bUndo;            // Undo info is valid (NOSAVE)
+    BOOL        m_bUndoLockState;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -356,6 +461,8 @@ public:
     virtual void DoMoveSetup(CGamDoc* pDoc, int nMoveWithinGroup);
     virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return TRUE; }     // Only indicates
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -377,6 +484,11 @@ public:
 
     virtual void DoMove(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    // Records are undone last one first so the message is the last
+    // one in the history.
+    virtual BOOL CanUndo() { return TRUE; }
+    virtual void UndoMove(CGamDoc* pDoc, int nMoveWithinGroup);
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -399,6 +511,8 @@ public:
 
     virtual void DoMoveCleanup(CGamDoc* pDoc, int nMoveWithinGroup);
 
+    virtual BOOL CanUndo() { return TRUE; }     // Only notifies
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -434,6 +548,8 @@ public:
 
     BOOL IsGroupBegin() { return m_bGroupBegin; }
 
+    virtual BOOL CanUndo() { return TRUE; }
+
     virtual void Serialize(CArchive& ar);
 
 #ifdef _DEBUG
@@ -447,18 +563,16 @@ protected:
 ///////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////
 
-// CMoveRecord is polymorphic
-class CMoveList : private std::list<OwnerPtr<CMoveRecord>>
+// CMoveRecord is polymorphic. Records are kept in index order so
+// playback can address them directly.
+class CMoveList : private std::vector<OwnerPtr<CMoveRecord>>
 {
-    typedef std::list<OwnerPtr<CMoveRecord>> BASE;
+    typedef std::vector<OwnerPtr<CMoveRecord>> BASE;
 public:
     using BASE::iterator;
     using BASE::begin;
     using BASE::end;
-    using BASE::erase;
     using BASE::front;
-    using BASE::insert;
-    using BASE::pop_front;
 
     CMoveList();
     CMoveList(const CMoveList&) = delete;
@@ -473,15 +587,37 @@ public:
 public:
     static OwnerPtr<CMoveList> CloneMoveList(CGamDoc* pDoc, CMoveList& pMoveList);
 
-    void AssignNewMoveGroup() { m_nSeqNum++; }
+    void AssignNewMoveGroup() { m_nSeqNum++; m_bGroupStateHash = FALSE; }
+    void AssignNewMoveGroup(uint64_t nStateHash)
+        { m_nSeqNum++; m_nGroupStateHash = nStateHash; m_bGroupStateHash = TRUE; }
     iterator AppendMoveRecord(OwnerPtr<CMoveRecord> pRec);
     iterator PrependMoveRecord(OwnerPtr<CMoveRecord> pRec, BOOL bSetSeqNum = TRUE);
+    // These shift record indices so they discard the replay checkpoints
+    iterator insert(iterator pos, OwnerPtr<CMoveRecord> pRec);
+    iterator erase(iterator pos);
+    void pop_front();
 
     void PushAndSetState(CGamDoc* pDoc, size_t nIndex);
     void PopAndRestoreState(CGamDoc* pDoc);
     size_t SetStartingState();
 
+    // Replay checkpoints are snapshots of the game state taken every
+    // few move groups while replaying quietly. They allow stepping
+    // backward to restart from the closest snapshot instead of the
+    // starting state record.
+    static void SetCheckpointPolicy(size_t nInterval, size_t nMaxCheckpoints);
+    size_t SeekToCheckpoint(CGamDoc* pDoc, size_t nFromIndex, size_t nIndex);
+    void PurgeCheckpoints(size_t nIndex = size_t(0));
+
     size_t FindPreviousMove(CGamDoc* pDoc, size_t nIndex);
+    size_t UndoToPreviousMove(CGamDoc* pDoc, size_t nIndex);
+
+    // Moves whose records have all been played can be reversed in
+    // place instead of replaying from an earlier state. nEndIndex
+    // is the index following the last record to undo.
+    bool CanUndoMoves(size_t nIndex, size_t nEndIndex);
+    void UndoMoves(CGamDoc* pDoc, size_t nIndex, size_t nEndIndex);
+    void ReplayMessages(CGamDoc* pDoc, size_t nIndex, size_t nEndIndex);
 
     // Compound moves are a sequence of moves done one at a time.
     // For example: move piece, change facing, move again, change facing,
@@ -498,6 +634,7 @@ public:
         { m_bCompoundSingleStep = bSingleStep; }
     bool IsWithinCompoundMove(size_t nIndex);
     bool IsMoveHidden(CGamDoc* pDoc, size_t nIndex);
+    size_t StepToPreviousMove(size_t nIndex, BOOL& bMayBeHidden);
     BOOL IsDoMoveActive() { return m_nPlaybackLock != 0; }
 
     void PurgeAfter(size_t nIndex);
@@ -527,6 +664,8 @@ public:
     }
     CMoveRecord& GetFirstRecord()
         { return *front(); }
+    CMoveRecord& GetRecordAt(size_t nIndex)
+        { return *BASE::operator[](nIndex); }
 
     void Clear();
     void Serialize(CArchive& ar, BOOL bSaveUndo = TRUE);
@@ -537,6 +676,12 @@ public:
 // Implementation
 protected:
     iterator FindIndex(size_t nIndex);
+    size_t GetGroupStart(size_t nIndex);
+    size_t GetCompoundMoveBegin(size_t nIndex);
+    void IndexRecord(size_t nIndex);
+    void InvalidateIndex() { m_bIndexValid = FALSE; }
+    size_t RestoreNearestCheckpoint(CGamDoc* pDoc, size_t nIndex);
+    void AddCheckpoint(CGamDoc* pDoc, size_t nIndex);
 
 protected:
     int         m_nPlaybackLock;        // Lock count used to stop recursion
@@ -547,6 +692,26 @@ protected:
     CGameState* m_pStateSave;           // Used to push/pos state
     BOOL        m_bQuietPlaybackSave;
 
+    // State hash for the first record of the group being recorded
+    // and whether playback found a mismatch yet (NOSAVE)
+    BOOL        m_bGroupStateHash;
+    uint64_t    m_nGroupStateHash;
+    BOOL        m_bDesyncReported;
+
+    // Replay checkpoints keyed by the move index they precede (NOSAVE)
+    std::map<size_t, OwnerPtr<CGameState>> m_mapCheckpoints;
+    size_t      m_nCheckpointInterval;  // Groups between checkpoints
+
+    static size_t c_nCheckpointInterval;// Initial groups between checkpoints
+    static size_t c_nMaxCheckpoints;    // Memory budget in snapshots
+
+    // Record index (NOSAVE). Appends extend it. Other changes cause
+    // it to be rebuilt when next used.
+    BOOL        m_bIndexValid;
+    std::vector<size_t> m_tblGroupStart;    // First record of each record's group
+    std::vector<size_t> m_tblCompoundBegin; // Open compound move begin record
+                                            // preceding each record (or invalid)
+
     // Serialize the following...
     int         m_nSeqNum;
 
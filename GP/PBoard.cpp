@@ -77,8 +77,8 @@ CPlayBoard::CPlayBoard()
     m_bShowSelListAndTinyMap = TRUE;
     // m_wReserved4 = 0;                // Replaced by m_bOpenBoardOnLoad
     // ------- //
-    m_pPceList = MakeOwner<CDrawList>();
-    m_pIndList = MakeOwner<CDrawList>();
+    m_pPceList = std::make_shared<CDrawList>();
+    m_pIndList = std::make_shared<CDrawList>();
     // ------- //
     m_bPlotMode = FALSE;
     m_ptPrevPlot = CPoint(-1, -1);
@@ -288,11 +288,15 @@ void CPlayBoard::SetBoard(CBoard& pBoard, BOOL bInheritSettings /* = FALSE */)
 
 //////////////////////////////////////////////////////////////////////
 
+// The draw lists of a cloned board are shared with any other saved
+// states taken while the lists were unchanged. They must not be
+// modified.
+
 CPlayBoard CPlayBoard::Clone(CGamDoc *pDoc)
 {
     CPlayBoard pBrd;
-    pBrd.m_pPceList = MakeOwner<CDrawList>(m_pPceList->Clone(pDoc));
-    pBrd.m_pIndList = MakeOwner<CDrawList>(m_pIndList->Clone(pDoc));
+    pBrd.m_pPceList = m_pPceList->GetSharedClone(pDoc);
+    pBrd.m_pIndList = m_pIndList->GetSharedClone(pDoc);
     pBrd.m_bPlotMode = m_bPlotMode;
     pBrd.m_ptPrevPlot = m_ptPrevPlot;
     pBrd.m_nSerialNum = m_nSerialNum;
@@ -302,8 +306,8 @@ CPlayBoard CPlayBoard::Clone(CGamDoc *pDoc)
 
 void CPlayBoard::Restore(CGamDoc *pDoc, CPlayBoard& pBrd)
 {
-    m_pPceList->Restore(pDoc, *pBrd.m_pPceList);
-    m_pIndList->Restore(pDoc, *pBrd.m_pIndList);
+    m_pPceList->RestoreShared(pDoc, pBrd.m_pPceList);
+    m_pIndList->RestoreShared(pDoc, pBrd.m_pIndList);
     m_bPlotMode = pBrd.m_bPlotMode;
     m_ptPrevPlot = pBrd.m_ptPrevPlot;
     m_nSerialNum = pBrd.m_nSerialNum;
@@ -323,6 +327,17 @@ bool CPlayBoard::Compare(CPlayBoard& pBrd)
     return m_pIndList->Compare(*pBrd.m_pIndList);
 }
 
+// Indicators are left out of the hashes stored with moves since
+// playback doesn't draw the same ones the player saw.
+uint64_t CPlayBoard::GetStateHash(BOOL bIndicators /* = TRUE */) const
+{
+    uint64_t nHash = CombineStateHash(0, value_preserving_cast<uint64_t>(m_nSerialNum));
+    nHash = CombineStateHash(nHash, m_pPceList->GetStateHash());
+    if (!bIndicators)
+        return nHash;
+    return CombineStateHash(nHash, m_pIndList->GetStateHash());
+}
+
 void CPlayBoard::Serialize(CArchive& ar)
 {
     if (ar.IsStoring())
@@ -496,11 +511,11 @@ void CPlayBoard::Serialize(CArchive& ar)
         }
 
         ASSERT(m_pPceList == NULL);
-        m_pPceList = MakeOwner<CDrawList>();
+        m_pPceList = std::make_shared<CDrawList>();
         m_pPceList->Serialize(ar);  // Board's piece and annotation list
 
         ASSERT(m_pIndList == NULL);
-        m_pIndList = MakeOwner<CDrawList>();
+        m_pIndList = std::make_shared<CDrawList>();
         m_pIndList->Serialize(ar);  // Board's indicator list
     }
 }
@@ -512,6 +527,7 @@ CPBoardManager::CPBoardManager()
 {
     m_pBMgr = NULL;
     m_pDoc = NULL;
+    m_bTrackPieceLocs = FALSE;
     m_nNextGeoSerialNum = BoardID(GEO_BOARD_SERNUM_BASE);
     //m_wReserved1 = 0;
     m_wReserved2 = 0;
@@ -521,12 +537,12 @@ CPBoardManager::CPBoardManager()
 
 BoardID CPBoardManager::IssueGeoSerialNumber()
 {
-    if (static_cast<WORD>(m_nNextGeoSerialNum) > maxBoards)
+    if (static_cast<uint32_t>(m_nNextGeoSerialNum) > maxBoards)
     {
         AfxThrowMemoryException();
     }
     BoardID retval = m_nNextGeoSerialNum;
-    m_nNextGeoSerialNum = static_cast<BoardID>(static_cast<WORD>(m_nNextGeoSerialNum) + 1);
+    m_nNextGeoSerialNum = static_cast<BoardID>(static_cast<uint32_t>(m_nNextGeoSerialNum) + 1);
     return retval;
 }
 
@@ -603,6 +619,8 @@ void CPBoardManager::AddBoard(CBoard* pBoard, BOOL bInheritSettings)
     resize(size() + size_t(1));
     back().SetDocument(m_pDoc);
     back().SetBoard(CheckedDeref(pBoard), bInheritSettings);
+    if (m_bTrackPieceLocs)
+        back().GetPieceList()->TrackPieceLocations(m_pDoc);
 }
 
 void CPBoardManager::AddBoard(CGeomorphicBoard* pGeoBoard, BOOL bInheritSettings)
@@ -610,6 +628,8 @@ void CPBoardManager::AddBoard(CGeomorphicBoard* pGeoBoard, BOOL bInheritSettings
     resize(size() + size_t(1));
     back().SetDocument(m_pDoc);
     back().SetBoard(CheckedDeref(pGeoBoard), bInheritSettings);
+    if (m_bTrackPieceLocs)
+        back().GetPieceList()->TrackPieceLocations(m_pDoc);
 }
 
 void CPBoardManager::DeletePBoard(size_t nBrd)
@@ -706,6 +726,25 @@ CPlayBoard* CPBoardManager::FindPieceOnBoard(PieceID pid, CPieceObj** ppObj)
     return NULL;
 }
 
+CPlayBoard* CPBoardManager::GetPBoardByPieceList(const CDrawList& pPceList)
+{
+    for (size_t i = 0; i < GetNumPBoards(); i++)
+    {
+        CPlayBoard& pPBrd = GetPBoard(i);
+        if (pPBrd.GetPieceList() == &pPceList)
+            return &pPBrd;
+    }
+    return NULL;
+}
+
+void CPBoardManager::TrackPieceLocations()
+{
+    ASSERT(m_pDoc != NULL);
+    m_bTrackPieceLocs = TRUE;
+    for (size_t i = 0; i < GetNumPBoards(); i++)
+        GetPBoard(i).GetPieceList()->TrackPieceLocations(m_pDoc);
+}
+
 CPlayBoard* CPBoardManager::FindObjectOnBoard(CDrawObj* pObj)
 {
     ASSERT(pObj != NULL);
@@ -755,6 +794,14 @@ bool CPBoardManager::Compare(CPBoardManager& pMgr)
     return true;
 }
 
+uint64_t CPBoardManager::GetStateHash(BOOL bIndicators /* = TRUE */) const
+{
+    uint64_t nHash = CombineStateHash(0, GetNumPBoards());
+    for (size_t i = 0; i < GetNumPBoards(); i++)
+        nHash = CombineStateHash(nHash, GetPBoard(i).GetStateHash(bIndicators));
+    return nHash;
+}
+
 //////////////////////////////////////////////////////////////////////
 
 void CPBoardManager::Serialize(CArchive& ar)
@@ -792,6 +839,8 @@ void CPBoardManager::Serialize(CArchive& ar)
         {
             GetPBoard(i).SetDocument(m_pDoc);
             GetPBoard(i).Serialize(ar);
+            if (m_bTrackPieceLocs)
+                GetPBoard(i).GetPieceList()->TrackPieceLocations(m_pDoc);
         }
     }
 }
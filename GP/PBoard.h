@@ -122,6 +122,7 @@ public:
     CPlayBoard Clone(CGamDoc *pDoc);
     void Restore(CGamDoc *pDoc, CPlayBoard& pBrd);
     bool Compare(CPlayBoard& pBrd);
+    uint64_t GetStateHash(BOOL bIndicators = TRUE) const;
     // ------- //
     void Serialize(CArchive& ar);
 
@@ -214,8 +215,9 @@ protected:
     CPoint  m_ptPrevPlot;       // Previous selected move point
     BOOL    m_bPlotMode;        // Plot move mode
 
-    OwnerOrNullPtr<CDrawList> m_pPceList;      // Piece draw list
-    OwnerOrNullPtr<CDrawList> m_pIndList;      // Indicator draw list.
+    // Saved game state boards share their lists (see Clone())
+    std::shared_ptr<CDrawList> m_pPceList;      // Piece draw list
+    std::shared_ptr<CDrawList> m_pIndList;      // Indicator draw list.
 
     // For reference only...
     CBoard*     m_pBoard;       // Loaded from Game Box
@@ -260,12 +262,19 @@ public:
     CPlayBoard* FindObjectOnBoard(CDrawObj* pObj);
     CPlayBoard* FindObjectOnBoard(ObjectID oid, CDrawObj** ppObj);
     CPlayBoard* FindPieceOnBoard(PieceID pid, CPieceObj** ppObj = NULL);
+    CPlayBoard* GetPBoardByPieceList(const CDrawList& pPceList);
+
+    // The piece lists of these boards (including boards added or
+    // loaded later) report the pieces they gain and lose to the
+    // document's piece location index.
+    void TrackPieceLocations();
 
     CDrawObj* RemoveObjectID(ObjectID oid);    // Doesn't delete it
     // ------- //
     CPBoardManager* Clone(CGamDoc *pDoc);
     void Restore(CGamDoc *pDoc, CPBoardManager& pMgr);
     bool Compare(CPBoardManager& pMgr);
+    uint64_t GetStateHash(BOOL bIndicators = TRUE) const;
     // ------- //
     void Serialize(CArchive& ar);
 
@@ -277,6 +286,7 @@ protected:
 protected:
     CGamDoc*        m_pDoc;
     CBoardManager*  m_pBMgr;
+    BOOL            m_bTrackPieceLocs;  // Piece lists report to doc (NOSAVE)
 
     BoardID m_nNextGeoSerialNum;        // Next geomorphic board serial number to issue (WAS m_wReserved1)
     // WORD m_wReserved1;           // For future need (set to 0) // Now is m_nNextGeoSerialNum
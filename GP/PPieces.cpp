@@ -52,6 +52,7 @@ CPieceTable::CPieceTable()
     m_wReserved3 = 0;
     m_wReserved4 = 0;
     // ------ //
+    m_nTblSize = 0;
     m_pPMgr = NULL;
 }
 
@@ -60,7 +61,7 @@ CPieceTable::CPieceTable()
 // is in use and are part of a particular piece set.
 
 void CPieceTable::LoadUnusedPieceList(std::vector<PieceID>& pPTbl, size_t nPieceSet,
-    BOOL bClear)
+    BOOL bClear) const
 {
     ASSERT(m_pPMgr != NULL);
     CPieceSet& pPSet = m_pPMgr->GetPieceSet(nPieceSet);
@@ -68,7 +69,7 @@ void CPieceTable::LoadUnusedPieceList(std::vector<PieceID>& pPTbl, size_t nPiece
 }
 
 void CPieceTable::LoadUnusedPieceList(std::vector<PieceID>& pPTbl, const CPieceSet& pPceSet,
-    BOOL bClear)
+    BOOL bClear) const
 {
     if (bClear) pPTbl.clear();
     const std::vector<PieceID>& pPidTbl = pPceSet.GetPieceIDTable();
@@ -117,9 +118,9 @@ void CPieceTable::PurgeUndefinedPieceIDs()
 
     size_t nPiecesDeleted = 0;
 
-    for (size_t i = 0; i < m_pPieceTbl.GetSize(); i++)
+    for (size_t i = 0; i < GetTableSize(); i++)
     {
-        Piece* pPce;
+        const Piece* pPce;
         const PieceDef* pDef;
         GetPieceDefinitionPair(static_cast<PieceID>(i), pPce, pDef);
         if (pDef->IsEmpty())
@@ -131,7 +132,7 @@ void CPieceTable::PurgeUndefinedPieceIDs()
                 pYMgr->RemovePieceIDFromTraySets(static_cast<PieceID>(i));
                 CDrawObj* pObj = pPBMgr->RemoveObjectID(static_cast<ObjectID>(static_cast<PieceID>(i)));
                 if (pObj != NULL) delete pObj;
-                pPce->SetUnused();      // Render it gone!
+                GetPiece(static_cast<PieceID>(i)).SetUnused();  // Render it gone!
                 nPiecesDeleted++;
             }
         }
@@ -162,7 +163,7 @@ void CPieceTable::CreatePlayingPieceTable()
     ASSERT(nPieces < maxPieces);
     if (nPieces == 0)
         return;
-    m_pPieceTbl.ResizeTable(nPieces, &Piece::SetUnused);
+    ResizeTable(nPieces);
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -172,7 +173,7 @@ void CPieceTable::SetPieceFacing(PieceID pid, int nFacingDegCW)
     GetPiece(pid).SetFacing(nFacingDegCW);
 }
 
-int  CPieceTable::GetPieceFacing(PieceID pid)
+int  CPieceTable::GetPieceFacing(PieceID pid) const
 {
     return GetPiece(pid).GetFacing();
 }
@@ -190,12 +191,12 @@ void CPieceTable::SetPieceUnused(PieceID pid)
     GetPiece(pid).SetUnused();
 }
 
-BOOL CPieceTable::IsPieceUsed(PieceID pid)
+BOOL CPieceTable::IsPieceUsed(PieceID pid) const
 {
     return GetPiece(pid).IsUsed();
 }
 
-BOOL CPieceTable::IsFrontUp(PieceID pid)
+BOOL CPieceTable::IsFrontUp(PieceID pid) const
 {
     return GetPiece(pid).IsFrontUp();
 }
@@ -212,8 +213,12 @@ BOOL CPieceTable::Is2Sided(PieceID pid) const
 
 void CPieceTable::ClearAllOwnership()
 {
-    for (size_t i = 0; i < m_pPieceTbl.GetSize(); i++)
-        m_pPieceTbl[static_cast<PieceID>(i)].SetOwnerMask(0);
+    for (size_t i = 0; i < GetTableSize(); i++)
+    {
+        // Only touch owned pieces so unchanged pages stay shared.
+        if (std::as_const(*this).GetPiece(static_cast<PieceID>(i)).IsOwned())
+            GetPiece(static_cast<PieceID>(i)).SetOwnerMask(0);
+    }
 }
 
 BOOL CPieceTable::IsPieceOwned(PieceID pid) const
@@ -376,16 +381,59 @@ TileID CPieceTable::GetFacedTileID(PieceID pid, TileID tidBase, int nFacing, int
 
 void CPieceTable::Clear()
 {
-    m_pPieceTbl.Clear();
+    m_tblPages.clear();
+    m_nTblSize = 0;
+}
+
+// Size is rounded up the same way as other ID tables. New entries
+// are marked unused.
+void CPieceTable::ResizeTable(size_t nEntsNeeded)
+{
+    if (nEntsNeeded == 0)
+    {
+        Clear();
+        return;
+    }
+    size_t nNewSize = CalcAllocSize(nEntsNeeded, pieceTblBaseSize, pieceTblIncrSize);
+    size_t nPages = (nNewSize + pieceTblPageSize - 1) / pieceTblPageSize;
+
+    // Entries dropped from the last kept page are marked unused so
+    // whole pages can be hashed.
+    size_t nLimit = CB::min(m_nTblSize, nPages * pieceTblPageSize);
+    for (size_t i = nNewSize; i < nLimit; i++)
+        GetPiece(static_cast<PieceID>(i)).SetUnused();
+
+    m_tblPages.resize(nPages);
+    for (size_t i = 0; i < m_tblPages.size(); i++)
+    {
+        if (!m_tblPages[i])
+        {
+            m_tblPages[i] = std::make_shared<PiecePage>();
+            for (size_t j = 0; j < pieceTblPageSize; j++)
+                m_tblPages[i]->m_tblPieces[j].SetUnused();
+        }
+    }
+    m_nTblSize = nNewSize;
 }
 
 ///////////////////////////////////////////////////////////////////////
 
 const Piece& CPieceTable::GetPiece(PieceID pid) const
 {
-    ASSERT(m_pPieceTbl != NULL);
-    ASSERT(m_pPieceTbl.Valid(pid));
-    return m_pPieceTbl[pid];
+    size_t nIdx = value_preserving_cast<size_t>(pid);
+    ASSERT(nIdx < m_nTblSize);
+    return m_tblPages[nIdx / pieceTblPageSize]->m_tblPieces[nIdx % pieceTblPageSize];
+}
+
+Piece& CPieceTable::GetPiece(PieceID pid)
+{
+    size_t nIdx = value_preserving_cast<size_t>(pid);
+    ASSERT(nIdx < m_nTblSize);
+    std::shared_ptr<PiecePage>& pPage = m_tblPages[nIdx / pieceTblPageSize];
+    if (pPage.use_count() > 1)
+        pPage = std::make_shared<PiecePage>(*pPage);    // Copy on write
+    pPage->m_bStateHashValid = false;                   // Caller may change it
+    return pPage->m_tblPieces[nIdx % pieceTblPageSize];
 }
 
 const PieceDef& CPieceTable::GetPieceDef(PieceID pid) const
@@ -405,31 +453,66 @@ void CPieceTable::GetPieceDefinitionPair(PieceID pid, const Piece*& pPce,
 
 ///////////////////////////////////////////////////////////////////////
 
+// Clones and restores share the pages. They are only copied
+// when they're changed.
+
 CPieceTable* CPieceTable::Clone(CGamDoc *pDoc) const
 {
     CPieceTable* pTbl = new CPieceTable;
-    pTbl->m_pPieceTbl = m_pPieceTbl;
+    pTbl->m_tblPages = m_tblPages;
+    pTbl->m_nTblSize = m_nTblSize;
     return pTbl;
 }
 
 void CPieceTable::Restore(CGamDoc *pDoc, const CPieceTable& pTbl)
 {
-    Clear();
-    m_pPieceTbl = pTbl.m_pPieceTbl;
+    m_tblPages = pTbl.m_tblPages;
+    m_nTblSize = pTbl.m_nTblSize;
 }
 
 BOOL CPieceTable::Compare(const CPieceTable& pTbl) const
 {
-    if (m_pPieceTbl.GetSize() != pTbl.m_pPieceTbl.GetSize())
+    if (GetTableSize() != pTbl.GetTableSize())
         return FALSE;
-    for (size_t i = 0; i < m_pPieceTbl.GetSize(); i++)
+    for (size_t i = 0; i < GetTableSize(); i++)
     {
-        if (m_pPieceTbl[static_cast<PieceID>(i)] != pTbl.m_pPieceTbl[static_cast<PieceID>(i)])
+        if (i % pieceTblPageSize == 0 &&
+            m_tblPages[i / pieceTblPageSize] == pTbl.m_tblPages[i / pieceTblPageSize])
+        {
+            i += pieceTblPageSize - 1;      // Shared page is the same
+            continue;
+        }
+        if (GetPiece(static_cast<PieceID>(i)) != pTbl.GetPiece(static_cast<PieceID>(i)))
             return FALSE;
     }
     return TRUE;
 }
 
+// Like Compare(), the hash ignores piece ownership.
+uint64_t CPieceTable::GetStateHash() const
+{
+    uint64_t nHash = CombineStateHash(0, m_nTblSize);
+    for (size_t i = 0; i < m_tblPages.size(); i++)
+        nHash = CombineStateHash(nHash, m_tblPages[i]->GetStateHash());
+    return nHash;
+}
+
+uint64_t CPieceTable::PiecePage::GetStateHash() const
+{
+    if (!m_bStateHashValid)
+    {
+        m_nStateHash = 0;
+        for (size_t i = 0; i < m_tblPieces.size(); i++)
+        {
+            const Piece& pce = m_tblPieces[i];
+            m_nStateHash = CombineStateHash(m_nStateHash,
+                static_cast<uint64_t>(pce.GetSide()) << 16 | static_cast<uint64_t>(pce.GetFacing()));
+        }
+        m_bStateHashValid = true;
+    }
+    return m_nStateHash;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 void CPieceTable::Serialize(CArchive& ar)
@@ -441,7 +524,10 @@ void CPieceTable::Serialize(CArchive& ar)
         ar << m_wReserved3;
         ar << m_wReserved4;
 
-        ar << m_pPieceTbl;
+        // Same layout as the ID tables
+        ar << value_preserving_cast<DWORD>(m_nTblSize);
+        for (size_t i = 0; i < m_nTblSize; i++)
+            m_tblPages[i / pieceTblPageSize]->m_tblPieces[i % pieceTblPageSize].Serialize(ar);
     }
     else
     {
@@ -455,18 +541,33 @@ void CPieceTable::Serialize(CArchive& ar)
         ar >> m_wReserved3;
         ar >> m_wReserved4;
 
-        ar >> m_pPieceTbl;
+        size_t nCount;
+        if (CGamDoc::GetLoadingVersion() >= NumVersion(4, 0))  // V4.00
+        {
+            DWORD dwTmp;
+            ar >> dwTmp; nCount = value_preserving_cast<size_t>(dwTmp);
+        }
+        else
+        {
+            WORD wTmp;
+            ar >> wTmp; nCount = value_preserving_cast<size_t>(wTmp);
+        }
+        if (nCount > maxPieces)
+            AfxThrowArchiveException(CArchiveException::badSchema);
+        ResizeTable(nCount);
+        for (size_t i = 0; i < nCount; i++)
+            GetPiece(static_cast<PieceID>(i)).Serialize(ar);
 
         // Check for consistancy with game box piece table.
 
         ASSERT(m_pPMgr != NULL);
         size_t nDefSize = m_pPMgr->GetPieceTableSize();
-        if (m_pPieceTbl.GetSize() < nDefSize)
+        if (GetTableSize() < nDefSize)
         {
             // Need to increase the size of the playing piece table.
-            m_pPieceTbl.ResizeTable(nDefSize, &Piece::SetUnused);
+            ResizeTable(nDefSize);
         }
-        else if (m_pPieceTbl.GetSize() > nDefSize)
+        else if (GetTableSize() > nDefSize)
         {
             // Piece table in Game box was truncated. Probably
             // bad news.
@@ -474,12 +575,12 @@ void CPieceTable::Serialize(CArchive& ar)
                     MB_ICONEXCLAMATION) != IDOK)
                 AfxThrowArchiveException(CArchiveException::genericException);
             // Need to decrease the size of the playing piece table.
-            size_t nOldTblSize = m_pPieceTbl.GetSize();
-            m_pPieceTbl.ResizeTable(nDefSize, nullptr);
+            size_t nOldTblSize = GetTableSize();
+            ResizeTable(nDefSize);
             // Purge pieces in use that don't exist anymore
             CTrayManager* pYMgr = m_pDoc->GetTrayManager();
             CPBoardManager* pPBMgr = m_pDoc->GetPBoardManager();
-            for (size_t i = m_pPieceTbl.GetSize(); i < nOldTblSize; i++)
+            for (size_t i = GetTableSize(); i < nOldTblSize; i++)
             {
                 pYMgr->RemovePieceIDFromTraySets(static_cast<PieceID>(i));
                 CDrawObj* pObj = pPBMgr->RemoveObjectID(static_cast<ObjectID>(static_cast<PieceID>(i)));
@@ -534,7 +635,7 @@ void CPieceTable::DumpToTextFile(CFile& file)
     file.Write(szHead, lstrlen(szHead));
 
     char szBfr[256];
-    for (size_t i = 0; i < m_pPieceTbl.GetSize(); i++)
+    for (size_t i = 0; i < GetTableSize(); i++)
     {
         const Piece* pPce;
         const PieceDef* pDef;
@@ -542,8 +643,8 @@ void CPieceTable::DumpToTextFile(CFile& file)
         wsprintf(szBfr, "PieceID %5.5d: m_nSide=%02X, m_nFacing=%3u, "
             "m_tidFront=%5u, m_tidBack=%5u\r\n", i,
             (UINT)pPce->m_nSide, (UINT)pPce->m_nFacing,
-            (UINT)static_cast<WORD>(pDef->m_tidFront),
-            (UINT)static_cast<WORD>(pDef->m_tidBack));
+            value_preserving_cast<UINT>(pDef->m_tidFront),
+            value_preserving_cast<UINT>(pDef->m_tidBack));
         file.Write(szBfr, lstrlen(szBfr));
     }
 }
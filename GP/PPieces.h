@@ -29,6 +29,8 @@
 #include    <afxtempl.h>
 #endif
 
+#include    <array>
+
 #ifndef     _PIECES_H
 #include    "Pieces.h"
 #endif
@@ -106,20 +108,20 @@ public:
 // Operations
 public:
     void LoadUnusedPieceList(std::vector<PieceID>& pPTbl, size_t nPieceSet,
-        BOOL bClear = TRUE);
+        BOOL bClear = TRUE) const;
     void LoadUnusedPieceList(std::vector<PieceID>& pPTbl, const CPieceSet& pPceSet,
-        BOOL bClear = TRUE);
+        BOOL bClear = TRUE) const;
     void SetPieceListAsUnused(const std::vector<PieceID>& pPTbl);
     void SetPieceListAsFrontUp(const std::vector<PieceID>& pPTbl);
 
     void FlipPieceOver(PieceID pid);
 
     void SetPieceFacing(PieceID pid, int nFacingDegCW);
-    int  GetPieceFacing(PieceID pid);
+    int  GetPieceFacing(PieceID pid) const;
 
-    BOOL IsFrontUp(PieceID pid);
+    BOOL IsFrontUp(PieceID pid) const;
     BOOL Is2Sided(PieceID pid) const;
-    BOOL IsPieceUsed(PieceID pid);
+    BOOL IsPieceUsed(PieceID pid) const;
 
     BOOL IsPieceOwned(PieceID pid) const;
     BOOL IsPieceOwnedBy(PieceID pid, DWORD dwOwnerMask) const;
@@ -150,6 +152,7 @@ public:
     CPieceTable* Clone(CGamDoc *pDoc) const;
     void Restore(CGamDoc *pDoc, const CPieceTable& pTbl);
     BOOL Compare(const CPieceTable& pTbl) const;
+    uint64_t GetStateHash() const;
 
     void Serialize(CArchive& ar);
 
@@ -159,9 +162,23 @@ public:
 
 // Implementation
 protected:
-    XxxxIDTable<PieceID, Piece,
-                maxPieces, pieceTblBaseSize, pieceTblIncrSize,
-                true> m_pPieceTbl;
+    // The pieces are stored in fixed size pages. A cloned table (used
+    // for saved game states) shares its pages with the table it was
+    // cloned from. A shared page is copied the first time one of its
+    // pieces is changed. Each page caches the state hash of its
+    // pieces. Entries past the end of the table are always unused.
+    enum { pieceTblPageSize = 256 };
+    struct PiecePage
+    {
+        std::array<Piece, pieceTblPageSize> m_tblPieces;
+        mutable uint64_t m_nStateHash = 0;
+        mutable bool m_bStateHashValid = false;
+
+        uint64_t GetStateHash() const;
+    };
+
+    std::vector<std::shared_ptr<PiecePage>> m_tblPages;
+    size_t      m_nTblSize;         // Number of pieces in table
 
     WORD        m_wReserved1;       // For future need (set to 0)
     WORD        m_wReserved2;       // For future need (set to 0)
@@ -171,15 +188,16 @@ protected:
     CPieceManager* m_pPMgr;         // To get access to piece defs.
     CGamDoc*       m_pDoc;          // Used for serialize fixups
     // ------- //
+    size_t GetTableSize() const { return m_nTblSize; }
+    void ResizeTable(size_t nEntsNeeded);
     const Piece& GetPiece(PieceID pid) const;
-    Piece& GetPiece(PieceID pid) { return const_cast<Piece&>(std::as_const(*this).GetPiece(pid)); }
+    Piece& GetPiece(PieceID pid);           // Unshares the piece's page
     const PieceDef& GetPieceDef(PieceID pid) const;
     void GetPieceDefinitionPair(PieceID pid, const Piece*& pPce, const PieceDef*& pDef) const;
     void GetPieceDefinitionPair(PieceID pid, Piece*& pPce, const PieceDef*& pDef)
     {
-        const Piece* temp;
-        GetPieceDefinitionPair(pid, temp, pDef);
-        pPce = const_cast<Piece*>(temp);
+        pPce = &GetPiece(pid);
+        pDef = &GetPieceDef(pid);
     }
 
     TileID GetFacedTileID(PieceID pid, TileID tidBase, int nFacing, int nSide) const;
@@ -177,6 +177,7 @@
 #define IDS_MESSAGE_WND                 672
 #define IDS_INFO_REF_CREATED2           673
 #define IDS_INFO_GAME_CREATED           673
+#define IDS_WARN_MOVE_DESYNC            674
 #define IDD_ABOUTBOX                    2000
 #define IDD_SCNPROP                     2002
 #define IDD_PBRDPROP                    2004
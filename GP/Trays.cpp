@@ -41,6 +41,10 @@ static char THIS_FILE[] = __FILE__;
 
 CTraySet::CTraySet()
 {
+    m_pidTbl = std::make_shared<std::vector<PieceID>>();
+    m_nStateHash = 0;
+    m_bStateHashValid = FALSE;
+    m_pLocDoc = NULL;
     m_dwOwnerMask = 0;
     m_bNonOwnerAccess = FALSE;
     m_bRandomPull = FALSE;
@@ -50,9 +54,10 @@ CTraySet::CTraySet()
 
 BOOL CTraySet::HasPieceID(PieceID pid) const
 {
-    for (size_t i = 0; i < m_pidTbl.size(); i++)
+    const std::vector<PieceID>& pidTbl = GetPieceIDTable();
+    for (size_t i = 0; i < pidTbl.size(); i++)
     {
-        if (m_pidTbl.at(i) == pid)
+        if (pidTbl.at(i) == pid)
             return TRUE;
     }
     return FALSE;
@@ -60,9 +65,10 @@ BOOL CTraySet::HasPieceID(PieceID pid) const
 
 size_t CTraySet::GetPieceIDIndex(PieceID pid) const
 {
-    for (size_t i = 0; i < m_pidTbl.size(); i++)
+    const std::vector<PieceID>& pidTbl = GetPieceIDTable();
+    for (size_t i = 0; i < pidTbl.size(); i++)
     {
-        if (m_pidTbl.at(i) == pid)
+        if (pidTbl.at(i) == pid)
             return i;
     }
     return Invalid_v<size_t>;
@@ -70,26 +76,53 @@ size_t CTraySet::GetPieceIDIndex(PieceID pid) const
 
 void CTraySet::RemovePieceID(PieceID pid)
 {
-    for (size_t i = 0; i < m_pidTbl.size(); i++)
+    size_t nIdx = GetPieceIDIndex(pid);
+    if (nIdx != Invalid_v<size_t>)
     {
-        if (m_pidTbl.at(i) == pid)
-        {
-            m_pidTbl.erase(m_pidTbl.begin() + value_preserving_cast<ptrdiff_t>(i));
-            return;
-        }
+        std::vector<PieceID>& pidTbl = GetPieceIDTableForUpdate();
+        pidTbl.erase(pidTbl.begin() + value_preserving_cast<ptrdiff_t>(nIdx));
+        if (m_pLocDoc != NULL)
+            m_pLocDoc->NotePieceRemoved(pid, *this);
     }
 }
 
 void CTraySet::AddPieceID(PieceID pid, size_t nPos /* = Invalid_v<size_t> */)
 {
+    std::vector<PieceID>& pidTbl = GetPieceIDTableForUpdate();
     if (nPos == Invalid_v<size_t>)
-        m_pidTbl.push_back(pid);
+        pidTbl.push_back(pid);
     else
     {
-        if (nPos > m_pidTbl.size())          // Prevent indexing of the list
-            nPos = m_pidTbl.size();
-        m_pidTbl.insert(m_pidTbl.begin() + value_preserving_cast<ptrdiff_t>(nPos), pid);
+        if (nPos > pidTbl.size())           // Prevent indexing of the list
+            nPos = pidTbl.size();
+        pidTbl.insert(pidTbl.begin() + value_preserving_cast<ptrdiff_t>(nPos), pid);
     }
+    if (m_pLocDoc != NULL)
+        m_pLocDoc->NotePieceAdded(pid, *this);
+}
+
+void CTraySet::TrackPieceLocations(CGamDoc* pDoc)
+{
+    const std::vector<PieceID>& pidTbl = GetPieceIDTable();
+    if (m_pLocDoc != NULL)
+    {
+        for (size_t i = 0; i < pidTbl.size(); i++)
+            m_pLocDoc->NotePieceRemoved(pidTbl[i], *this);
+    }
+    m_pLocDoc = pDoc;
+    if (m_pLocDoc != NULL)
+    {
+        for (size_t i = 0; i < pidTbl.size(); i++)
+            m_pLocDoc->NotePieceAdded(pidTbl[i], *this);
+    }
+}
+
+std::vector<PieceID>& CTraySet::GetPieceIDTableForUpdate()
+{
+    if (m_pidTbl.use_count() > 1)
+        m_pidTbl = std::make_shared<std::vector<PieceID>>(*m_pidTbl);  // Copy on write
+    m_bStateHashValid = FALSE;
+    return *m_pidTbl;
 }
 
 void CTraySet::AddPieceList(const std::vector<PieceID>& pTbl, size_t nPos)
@@ -111,27 +144,43 @@ void CTraySet::RemovePieceList(const std::vector<PieceID>& pTbl)
 CTraySet CTraySet::Clone(CGamDoc *pDoc) const
 {
     CTraySet pSet;
-    pSet.m_pidTbl = m_pidTbl;
+    pSet.m_pidTbl = m_pidTbl;           // Shared until changed
+    pSet.m_nStateHash = m_nStateHash;
+    pSet.m_bStateHashValid = m_bStateHashValid;
     // Don't need to save the name.
     return pSet;
 }
 
 void CTraySet::Restore(CGamDoc *pDoc, const CTraySet& pSet)
 {
+    if (m_pidTbl == pSet.m_pidTbl)
+        return;                         // Unchanged since the clone
+    CGamDoc* pLocDoc = m_pLocDoc;
+    TrackPieceLocations(NULL);
     m_pidTbl = pSet.m_pidTbl;
+    m_nStateHash = pSet.m_nStateHash;
+    m_bStateHashValid = pSet.m_bStateHashValid;
+    TrackPieceLocations(pLocDoc);
 }
 
 BOOL CTraySet::Compare(const CTraySet& pYGrp) const
 {
-    if (m_pidTbl.size() != pYGrp.m_pidTbl.size())
-        return FALSE;
+    if (m_pidTbl == pYGrp.m_pidTbl)
+        return TRUE;
+    return *m_pidTbl == *pYGrp.m_pidTbl;
+}
 
-    for (size_t i = 0; i < m_pidTbl.size(); i++)
+uint64_t CTraySet::GetStateHash() const
+{
+    if (!m_bStateHashValid)
     {
-        if (m_pidTbl.at(i) != pYGrp.m_pidTbl.at(i))
-            return FALSE;
+        const std::vector<PieceID>& pidTbl = GetPieceIDTable();
+        m_nStateHash = CombineStateHash(0, pidTbl.size());
+        for (size_t i = 0; i < pidTbl.size(); i++)
+            m_nStateHash = CombineStateHash(m_nStateHash, value_preserving_cast<uint64_t>(pidTbl[i]));
+        m_bStateHashValid = TRUE;
     }
-    return TRUE;
+    return m_nStateHash;
 }
 
 BOOL CTraySet::IsOwnedButNotByCurrentPlayer(CGamDoc* pDoc)
@@ -141,10 +190,11 @@ BOOL CTraySet::IsOwnedButNotByCurrentPlayer(CGamDoc* pDoc)
 
 void CTraySet::PropagateOwnerMaskToAllPieces(CGamDoc* pDoc)
 {
-    for (size_t i = 0; i < m_pidTbl.size(); i++)
+    const std::vector<PieceID>& pidTbl = GetPieceIDTable();
+    for (size_t i = 0; i < pidTbl.size(); i++)
     {
         pDoc->GetPieceTable()->SetOwnerMask(
-            m_pidTbl[i], GetOwnerMask());
+            pidTbl[i], GetOwnerMask());
     }
 }
 
@@ -161,7 +211,7 @@ void CTraySet::Serialize(CArchive& ar)
         ar << m_dwOwnerMask;
         ar << (WORD)m_bNonOwnerAccess;
 
-        ar << m_pidTbl;
+        ar << GetPieceIDTable();
     }
     else
     {
@@ -190,7 +240,9 @@ void CTraySet::Serialize(CArchive& ar)
                 ar >> m_dwOwnerMask;
             ar >> wTmp; m_bNonOwnerAccess = (BOOL)wTmp;
         }
-        ar >> m_pidTbl;
+        m_pidTbl = std::make_shared<std::vector<PieceID>>();
+        m_bStateHashValid = FALSE;
+        ar >> *m_pidTbl;
     }
 }
 
@@ -203,22 +255,35 @@ CTrayManager::CTrayManager()
     m_wReserved3 = 0;
     m_wReserved4 = 0;
     m_pTMgr = NULL;
+    m_pLocDoc = NULL;
 }
 
 void CTrayManager::Clear()
 {
+    for (size_t i = 0; i < GetNumTraySets(); i++)
+        GetTraySet(i).TrackPieceLocations(NULL);
     m_YSetTbl.clear();
 }
 
+void CTrayManager::TrackPieceLocations(CGamDoc* pDoc)
+{
+    m_pLocDoc = pDoc;
+    for (size_t i = 0; i < GetNumTraySets(); i++)
+        GetTraySet(i).TrackPieceLocations(pDoc);
+}
+
 size_t CTrayManager::CreateTraySet(const char* pszName)
 {
-    m_YSetTbl.resize(m_YSetTbl.size() + 1);
-    m_YSetTbl.back().SetName(pszName);
+    m_YSetTbl.push_back(MakeOwner<CTraySet>());
+    CTraySet& pYSet = *m_YSetTbl.back();
+    pYSet.SetName(pszName);
+    pYSet.TrackPieceLocations(m_pLocDoc);
     return m_YSetTbl.size() - 1;
 }
 
 void CTrayManager::DeleteTraySet(size_t nYSet)
 {
+    GetTraySet(nYSet).TrackPieceLocations(NULL);
     m_YSetTbl.erase(m_YSetTbl.begin() + value_preserving_cast<ptrdiff_t>(nYSet));
 }
 
@@ -291,10 +356,7 @@ CTrayManager CTrayManager::Clone(CGamDoc *pDoc) const
 
     pMgr.m_YSetTbl.reserve(GetNumTraySets());
     for (size_t i = 0; i < GetNumTraySets(); i++)
-    {
-        CTraySet pSet = GetTraySet(i).Clone(pDoc);
-        pMgr.m_YSetTbl.push_back(std::move(pSet));
-    }
+        pMgr.m_YSetTbl.push_back(MakeOwner<CTraySet>(GetTraySet(i).Clone(pDoc)));
     return pMgr;
 }
 
@@ -318,6 +380,14 @@ BOOL CTrayManager::Compare(const CTrayManager& pYMgr) const
     return TRUE;
 }
 
+uint64_t CTrayManager::GetStateHash() const
+{
+    uint64_t nHash = CombineStateHash(0, GetNumTraySets());
+    for (size_t i = 0; i < GetNumTraySets(); i++)
+        nHash = CombineStateHash(nHash, GetTraySet(i).GetStateHash());
+    return nHash;
+}
+
 void CTrayManager::Serialize(CArchive& ar)
 {
     if (ar.IsStoring())
@@ -353,8 +423,9 @@ void CTrayManager::SerializeTraySets(CArchive& ar)
         m_YSetTbl.reserve(wSize);
         for (size_t i = 0; i < wSize; i++)
         {
-            CTraySet pYSet;
-            pYSet.Serialize(ar);
+            OwnerPtr<CTraySet> pYSet = MakeOwner<CTraySet>();
+            pYSet->Serialize(ar);
+            pYSet->TrackPieceLocations(m_pLocDoc);
             m_YSetTbl.push_back(std::move(pYSet));
         }
     }
@@ -56,8 +56,8 @@ public:
 
 // Attributes
 public:
-    const std::vector<PieceID>& GetPieceIDTable() const { return m_pidTbl; }
-    BOOL IsEmpty() const { return m_pidTbl.empty(); }
+    const std::vector<PieceID>& GetPieceIDTable() const { return *m_pidTbl; }
+    BOOL IsEmpty() const { return m_pidTbl->empty(); }
     BOOL HasPieceID(PieceID pid) const;
     size_t GetPieceIDIndex(PieceID pid) const;
 
@@ -82,6 +82,11 @@ public:
     BOOL IsOwnedBy(DWORD dwMask) { return (BOOL)(m_dwOwnerMask & dwMask); }
     BOOL IsOwnedButNotByCurrentPlayer(CGamDoc* pDOc);
 
+    // The document's own tray sets report the pieces they gain and
+    // lose to the document's piece location index. Saved game state
+    // tray sets don't. NULL stops reporting.
+    void TrackPieceLocations(CGamDoc* pDoc);
+
 // Operations
 public:
     void AddPieceID(PieceID pid, size_t nPos = Invalid_v<size_t>);
@@ -95,13 +100,22 @@ public:
     CTraySet Clone(CGamDoc *pDoc) const;
     void Restore(CGamDoc *pDoc, const CTraySet& pTbl);
     BOOL Compare(const CTraySet& pYGrp) const;
+    uint64_t GetStateHash() const;
 
     void Serialize(CArchive& ar);
 
 // Implementation
+protected:
+    std::vector<PieceID>& GetPieceIDTableForUpdate();
+
 protected:
     CString     m_strName;
-    std::vector<PieceID> m_pidTbl;
+    // The table is shared with clones (saved game states) and
+    // is copied when first changed.
+    std::shared_ptr<std::vector<PieceID>> m_pidTbl;
+    mutable uint64_t m_nStateHash;  // Cached hash of m_pidTbl (NOSAVE)
+    mutable BOOL m_bStateHashValid;
+    CGamDoc*  m_pLocDoc;            // Doc whose piece index is kept (NOSAVE)
 
     DWORD     m_dwOwnerMask;        // Who can change the tray (0=no owners)
     BOOL      m_bNonOwnerAccess;    // Allow non-owner access. Visiblity is still enforced.
@@ -126,7 +140,7 @@ public:
 public:
     size_t GetNumTraySets() const { return m_YSetTbl.size(); }
     const CTraySet& GetTraySet(size_t nYSet) const
-        { return m_YSetTbl.at(nYSet); }
+        { return *m_YSetTbl.at(nYSet); }
     CTraySet& GetTraySet(size_t nYSet)
     {
         return const_cast<CTraySet&>(std::as_const(*this).GetTraySet(nYSet));
@@ -144,6 +158,8 @@ public:
     size_t FindTrayByRef(const CTraySet& pYSet) const;
 
     void Clear();
+    // See CTraySet::TrackPieceLocations()
+    void TrackPieceLocations(CGamDoc* pDoc);
 
     void ClearAllOwnership();
     void PropagateOwnerMaskToAllPieces(CGamDoc* pDoc);
@@ -151,19 +167,23 @@ public:
     CTrayManager Clone(CGamDoc *pDoc) const;
     void Restore(CGamDoc *pDoc, const CTrayManager& pMgr);
     BOOL Compare(const CTrayManager& pYMgr) const;
+    uint64_t GetStateHash() const;
 
     void Serialize(CArchive& ar);
     void SerializeTraySets(CArchive& ar);
 
 // Implementation
 protected:
-    std::vector<CTraySet> m_YSetTbl;
+    // Tray sets are held by pointer so their addresses don't change
+    // as tray sets are added and removed.
+    std::vector<OwnerPtr<CTraySet>> m_YSetTbl;
     WORD        m_wReserved1;   // For future need (set to 0)
     WORD        m_wReserved2;   // For future need (set to 0)
     WORD        m_wReserved3;   // For future need (set to 0)
     WORD        m_wReserved4;   // For future need (set to 0)
     // ------- //
     CTileManager* m_pTMgr;      // Supporting tile manager
+    CGamDoc*    m_pLocDoc;      // Doc whose piece index is kept (NOSAVE)
 };
 
 #endif
@@ -28,6 +28,7 @@
 #include    "GamDoc.h"
 #include    "Board.h"
 #include    "PBoard.h"
+#include    "BrdCache.h"
 #include    "PPieces.h"
 #include    "ToolPlay.h"
 #include    "SelOPlay.h"
@@ -199,6 +200,8 @@ void CPlayBoardView::OnInitialUpdate()
     }
 
     ASSERT(m_pPBoard != NULL);
+    // The board may have been changed while no view of it was open.
+    g_brdCache.InvalidateBoard(*m_pPBoard->GetBoard());
     SetOurScrollSizes(m_nZoom);
     CScrollView::OnInitialUpdate();
 }
@@ -219,6 +222,8 @@ void CPlayBoardView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
             ASSERT(pFrm != NULL);
             pFrm->PostMessage(WM_CLOSE, 0, 0L);
         }
+        else
+            g_brdCache.InvalidateBoard(*m_pPBoard->GetBoard());  // Board settings may have changed
     }
     else if (lHint == HINT_UPDATEOBJECT && ph->GetArgs<HINT_UPDATEOBJECT>().m_pPBoard == m_pPBoard)
     {
@@ -357,7 +362,8 @@ LRESULT CPlayBoardView::OnMessageWindowState(WPARAM wParam, LPARAM lParam)
             for (size_t i = 0; i < tblObjPtrs.size(); i++)
             {
                 CDrawObj& pObj = *tblObjPtrs.at(i);
-                ar << value_preserving_cast<DWORD>(GetDocument()->GetGameElementCodeForObject(pObj));
+                GameElement elem = GetDocument()->GetGameElementCodeForObject(pObj);
+                SerializeGameElement(ar, elem);
             }
         }
         else
@@ -383,7 +389,7 @@ LRESULT CPlayBoardView::OnMessageWindowState(WPARAM wParam, LPARAM lParam)
         while (dwSelCount--)
         {
             GameElement elem;
-            ar >> dwTmp; elem = (GameElement)dwTmp;
+            SerializeGameElement(ar, elem);
             CDrawObj* pObj = NULL;
             if (IsGameElementAPiece(elem))
                 pObj = m_pPBoard->FindPieceID(GetPieceIDFromElement(elem));
@@ -430,20 +436,31 @@ void CPlayBoardView::SetOurScrollSizes(TileScale nZoom)
 // CPlayBoardView drawing
 
 void CPlayBoardView::OnDraw(CDC* pDC)
+{
+    // Separately invalidated areas (such as where a piece moved from
+    // and to) are drawn one at a time.
+    std::vector<CRect> tblRects;
+    GetPaintRects(pDC, tblRects);
+    SetupPalette(pDC);
+
+    if (tblRects.empty())
+        return;                 // Nothing to do
+
+    for (size_t i = size_t(0); i < tblRects.size(); ++i)
+        DrawArea(pDC, tblRects[i]);
+
+    ResetPalette(pDC);
+}
+
+// Draws the part of the board, pieces and selections inside oRct.
+void CPlayBoardView::DrawArea(CDC* pDC, CRect oRct)
 {
     CBoard*     pBoard = m_pPBoard->GetBoard();
     CDC         dcMem;
     CBitmap     bmMem;
-    CRect       oRct;
     CRect       oRctSave;
     CBitmap*    pPrvBMap;
 
-    pDC->GetClipBox(&oRct);
-    SetupPalette(pDC);
-
-    if (oRct.IsRectEmpty())
-        return;                 // Nothing to do
-
     bmMem.Attach(Create16BitDIBSection(pDC->m_hDC,
         oRct.Width(), oRct.Height()));
     dcMem.CreateCompatibleDC(pDC);
@@ -460,9 +477,13 @@ void CPlayBoardView::OnDraw(CDC* pDC)
     SetupPalette(&dcMem);
 
     // Draw base board image...
+    BOOL bCellBorders = m_nZoom == smallScale ?
+        m_pPBoard->m_bSmallCellBorders : m_pPBoard->m_bCellBorders;
     pBoard->SetMaxDrawLayer();          // Make sure all layers are drawn
-    pBoard->Draw(&dcMem, &oRct, m_nZoom,
-        m_nZoom == smallScale ? m_pPBoard->m_bSmallCellBorders : m_pPBoard->m_bCellBorders);
+    if (pDC->IsPrinting())
+        pBoard->Draw(&dcMem, &oRct, m_nZoom, bCellBorders);
+    else
+        g_brdCache.Draw(&dcMem, oRct, *pBoard, m_nZoom, bCellBorders);
 
     // Draw pieces etc.....
 
@@ -493,8 +514,6 @@ void CPlayBoardView::OnDraw(CDC* pDC)
 
     ResetPalette(&dcMem);
     dcMem.SelectObject(pPrvBMap);
-
-    ResetPalette(pDC);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -2205,11 +2224,9 @@ void CPlayBoardView::OnActTakeOwnership()
             value_preserving_cast<int>(pntCenter.x), value_preserving_cast<int>(pntCenter.y));
     }
 
+    m_selList.InvalidateListHandles();
     pDoc->SetPieceOwnershipTable(tblPieces, pDoc->GetCurrentPlayerMask());
-
-    CGamDocHint hint;
-    hint.GetArgs<HINT_UPDATEBOARD>().m_pPBoard = m_pPBoard;
-    pDoc->UpdateAllViews(NULL, HINT_UPDATEBOARD, &hint);
+    m_selList.UpdateObjects(TRUE, FALSE);   // Pieces may have changed size
 
     NotifySelectListChange();
 }
@@ -2255,11 +2272,9 @@ void CPlayBoardView::OnActReleaseOwnership()
             value_preserving_cast<int>(pntCenter.x), value_preserving_cast<int>(pntCenter.y));
     }
 
+    m_selList.InvalidateListHandles();
     pDoc->SetPieceOwnershipTable(tblPieces, 0);
-
-    CGamDocHint hint;
-    hint.GetArgs<HINT_UPDATEBOARD>().m_pPBoard = m_pPBoard;
-    pDoc->UpdateAllViews(NULL, HINT_UPDATEBOARD, &hint);
+    m_selList.UpdateObjects(TRUE, FALSE);   // Pieces may have changed size
 
     NotifySelectListChange();
 }
@@ -2313,11 +2328,9 @@ void CPlayBoardView::OnActSetOwner()
             value_preserving_cast<int>(pntCenter.x), value_preserving_cast<int>(pntCenter.y));
     }
 
+    m_selList.InvalidateListHandles();
     pDoc->SetPieceOwnershipTable(tblPieces, dwNewOwnerMask);
-
-    CGamDocHint hint;
-    hint.GetArgs<HINT_UPDATEBOARD>().m_pPBoard = m_pPBoard;
-    pDoc->UpdateAllViews(NULL, HINT_UPDATEBOARD, &hint);
+    m_selList.UpdateObjects(TRUE, FALSE);   // Pieces may have changed size
 
     NotifySelectListChange();
 }
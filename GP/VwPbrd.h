@@ -165,6 +165,7 @@ protected:
 
     PToolType MapToolType(UINT nToolResID);
 
+    void DrawArea(CDC* pDC, CRect oRct);
     void SetupDrawListDC(CDC* pDC, CRect* pRct);
     void RestoreDrawListDC(CDC *pDC);
 
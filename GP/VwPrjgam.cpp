@@ -440,7 +440,7 @@ void CGamProjView::DoUpdateProjectList(BOOL bUpdateItem /* = TRUE */)
         {
             CString strTmp = str;
             str.Format("[%d] %s",
-                static_cast<WORD>(pPBMgr->GetPBoard(i).GetBoard()->GetSerialNumber()), (LPCTSTR)strTmp);
+                value_preserving_cast<int>(pPBMgr->GetPBoard(i).GetBoard()->GetSerialNumber()), (LPCTSTR)strTmp);
         }
         if (pPBoard.IsOwned())
         {
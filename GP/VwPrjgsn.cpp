@@ -433,7 +433,7 @@ void CGsnProjView::DoUpdateProjectList(BOOL bUpdateItem /* = TRUE */)
         {
             CString strTmp = str;
             str.Format("[%d] %s",
-                static_cast<WORD>(pPBoard.GetBoard()->GetSerialNumber()), (LPCTSTR)strTmp);
+                value_preserving_cast<int>(pPBoard.GetBoard()->GetSerialNumber()), (LPCTSTR)strTmp);
         }
         if (pPBoard.IsOwned())
         {
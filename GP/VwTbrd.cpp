@@ -28,6 +28,7 @@
 #include    "FrmMain.h"
 #include    "Board.h"
 #include    "PBoard.h"
+#include    "BrdCache.h"
 #include    "VwTbrd.h"
 #include    "WinPoptb.h"
 #include    "GMisc.h"
@@ -60,12 +61,10 @@ END_MESSAGE_MAP()
 CTinyBoardView::CTinyBoardView()
 {
     m_pPBoard = NULL;
-    m_pBMap = NULL;
 }
 
 CTinyBoardView::~CTinyBoardView()
 {
-    if (m_pBMap != NULL) delete m_pBMap;
 }
 
 BOOL CTinyBoardView::PreCreateWindow(CREATESTRUCT& cs)
@@ -112,8 +111,6 @@ void CTinyBoardView::OnUpdate(CView* pSender, LPARAM lHint, CObject* pHint)
     }
     else if (lHint == HINT_UPDATEBOARD && ph->GetArgs<HINT_UPDATEBOARD>().m_pPBoard == m_pPBoard)
     {
-        if (m_pBMap != NULL) delete m_pBMap;
-        m_pBMap = NULL;
         Invalidate();
     }
     else if (lHint == HINT_ALWAYSUPDATE || lHint == HINT_GAMESTATEUSED)
@@ -151,20 +148,21 @@ LRESULT CTinyBoardView::OnMessageWindowState(WPARAM wParam, LPARAM lParam)
 void CTinyBoardView::OnDraw(CDC* pDC)
 {
     SetupPalette(pDC);          // (moved to top)
-    if (m_pBMap == NULL)
-        RegenCachedMap(pDC);
-    ASSERT(m_pBMap != NULL);
 
+    std::vector<CRect> tblRects;
+    GetPaintRects(pDC, tblRects);
+    for (size_t i = size_t(0); i < tblRects.size(); ++i)
+        DrawArea(pDC, tblRects[i]);
+}
+
+// Draws the part of the board and pieces inside oRct.
+void CTinyBoardView::DrawArea(CDC* pDC, CRect oRct)
+{
     CDC      dcMem;
     CBitmap  bmMem;
-    CRect    oRct;
     CRect    oRctSave;
     CBitmap* pPrvBMap;
 
-    pDC->GetClipBox(&oRct);
-    if (oRct.IsRectEmpty())
-        return;                 // Nothing to do
-
     bmMem.Attach(Create16BitDIBSection(pDC->m_hDC, oRct.Width(), oRct.Height()));
     dcMem.CreateCompatibleDC(pDC);
     pPrvBMap = dcMem.SelectObject(&bmMem);
@@ -182,7 +180,7 @@ void CTinyBoardView::OnDraw(CDC* pDC)
     SetupPalette(&dcMem);
 
     // Draw updated part of board image
-    BitmapBlt(&dcMem, CPoint(0, 0), m_pBMap);
+    DrawBoardImage(&dcMem, oRct);
 
     // Draw pieces etc. (Need to rescale the DC and the update rect)
 
@@ -223,8 +221,8 @@ void CTinyBoardView::DrawFullMap(CDC* pDC, CBitmap& bmap)
     CBitmap* pPrvBMap = dcMem.SelectObject(&bmap);
     SetupPalette(&dcMem);
 
-    // Draw updated part of board image
-    BitmapBlt(&dcMem, CPoint(0, 0), m_pBMap);
+    // Draw board image
+    DrawBoardImage(&dcMem, CRect(CPoint(0, 0), size));
 
     // Draw pieces etc. (Need to rescale the DC and the update rect)
 
@@ -237,30 +235,13 @@ void CTinyBoardView::DrawFullMap(CDC* pDC, CBitmap& bmap)
     dcMem.SelectObject(pPrvBMap);
 }
 
-void CTinyBoardView::RegenCachedMap(CDC* pDC)
+// Draws the board beneath the pieces. The chunks of it are kept
+// in the shared board cache.
+void CTinyBoardView::DrawBoardImage(CDC* pDC, const CRect& rct)
 {
-    BeginWaitCursor();
-    SetupPalette(pDC);
-
-    if (m_pBMap != NULL) delete m_pBMap;
-    m_pBMap = new CBitmap;
-
     CBoard* pBoard = m_pPBoard->GetBoard();
-    CSize size = pBoard->GetSize(smallScale);   // Get pixel size of board
-    m_pBMap->Attach(Create16BitDIBSection(pDC->m_hDC, size.cx, size.cy));
-
-    CDC dcMem;
-    dcMem.CreateCompatibleDC(pDC);
-    CBitmap* pPrvBMap = dcMem.SelectObject(m_pBMap);
-    SetupPalette(&dcMem);
-
-    CRect rct(CPoint(0, 0), size);
     pBoard->SetMaxDrawLayer();                  // Make sure all layers are drawn
-    pBoard->Draw(&dcMem, &rct, smallScale, m_pPBoard->m_bSmallCellBorders);
-
-    ResetPalette(&dcMem);
-    dcMem.SelectObject(pPrvBMap);
-    EndWaitCursor();
+    g_brdCache.Draw(pDC, rct, *pBoard, smallScale, m_pPBoard->m_bSmallCellBorders);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -342,9 +323,6 @@ void CTinyBoardView::OnLButtonDown(UINT nFlags, CPoint point)
 
 void CTinyBoardView::OnRButtonDown(UINT nFlags, CPoint point)
 {
-    if (m_pBMap == NULL)
-        return;
-
     CTinyBoardPopup* pTBrd = new CTinyBoardPopup;
 
     {
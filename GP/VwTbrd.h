@@ -41,11 +41,11 @@ public:
 // Implementation
 protected:
     CPlayBoard* m_pPBoard;          // The playing board we are viewing
-    CBitmap*    m_pBMap;            // Cached predrawn board bitmap
 
     TileScale   m_nZoom;
 
-    void RegenCachedMap(CDC* pDC);
+    void DrawArea(CDC* pDC, CRect oRct);
+    void DrawBoardImage(CDC* pDC, const CRect& rct);
     void DrawFullMap(CDC* pDC, CBitmap& bmap);
 
 // Implementation
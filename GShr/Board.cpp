@@ -45,6 +45,8 @@ static char THIS_FILE[] = __FILE__;
 ///////////////////////////////////////////////////////////////////
 // CBoard Class
 
+DWORD CBoard::c_dwLastDrawVersion = 0;
+
 CBoard::CBoard()
 {
     m_pBrdAry = NULL;
@@ -60,6 +62,7 @@ CBoard::CBoard()
     m_wReserved2 = 0;
     m_wReserved3 = 0;
     m_wReserved4 = 0;
+    BumpDrawVersion();
 }
 
 CBoard::~CBoard()
@@ -500,7 +503,7 @@ size_t CBoardManager::FindBoardBySerial(BoardID nSerialNum) const
 {
     for (size_t i = 0; i < GetNumBoards(); i++)
     {
-        TRACE2("Board %zu has serial number %d\n", i, value_preserving_cast<int>(static_cast<WORD>(GetBoard(i).GetSerialNumber())));
+        TRACE2("Board %zu has serial number %d\n", i, value_preserving_cast<int>(GetBoard(i).GetSerialNumber()));
         if (GetBoard(i).GetSerialNumber() == nSerialNum)
             return i;
     }
@@ -521,12 +524,12 @@ BOOL CBoardManager::DoBoardFontDialog()
 
 BoardID CBoardManager::IssueSerialNumber()
 {
-    if (static_cast<WORD>(m_nNextSerialNumber) == GEO_BOARD_SERNUM_BASE)
+    if (static_cast<uint32_t>(m_nNextSerialNumber) == GEO_BOARD_SERNUM_BASE)
     {
         AfxThrowMemoryException();
     }
     BoardID retval = m_nNextSerialNumber;
-    m_nNextSerialNumber = static_cast<BoardID>(static_cast<WORD>(m_nNextSerialNumber) + 1);
+    m_nNextSerialNumber = static_cast<BoardID>(static_cast<uint32_t>(m_nNextSerialNumber) + 1);
     return retval;
 }
 
@@ -38,7 +38,7 @@
 #endif
 
 typedef XxxxID<'B'> BoardID;
-const       BoardID nullBid = BoardID(0xFFFF);
+const       BoardID nullBid = BoardID(0xFFFFFFFF);
 const size_t maxBoards = 32000;
 // The starting serial number for geomorpically created boards.
 const size_t GEO_BOARD_SERNUM_BASE = 1000;
@@ -155,6 +155,10 @@ public:
     void SetCellBorder(BOOL bShow) { m_bShowCellBorder = bShow; }
     BOOL GetCellBorderOnTop() { return m_bCellBorderOnTop; }
     void SetCellBorderOnTop(BOOL bOnTop) { m_bCellBorderOnTop = bOnTop; }
+    // Identifies the board's current appearance to the board cache.
+    // A new value is never one any board has had before.
+    DWORD GetDrawVersion() const { return m_dwDrawVersion; }
+    void BumpDrawVersion() { m_dwDrawVersion = ++c_dwLastDrawVersion; }
 
 // Operations
 public:
@@ -180,6 +184,8 @@ protected:
     WORD    m_wReserved2;           // For future need (set to 0)
     WORD    m_wReserved3;           // For future need (set to 0)
     WORD    m_wReserved4;           // For future need (set to 0)
+    DWORD   m_dwDrawVersion;        // Not saved
+    static DWORD c_dwLastDrawVersion;
     // Saved in file...
     CBoardArray* m_pBrdAry;     // Actual board definition
     // List of outer layer drawing primitives (lines, polygons, text...);
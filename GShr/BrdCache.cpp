@@ -0,0 +1,207 @@
+// BrdCache.cpp
+//
+// Copyright (c) 1994-2020 By Dale L. Larson, All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include    "stdafx.h"
+#include    "GdiTools.h"
+#include    "GMisc.h"
+#include    "BrdCache.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+#ifdef  _DEBUG
+#define new DEBUG_NEW
+#endif
+
+//////////////////////////////////////////////////////////////////
+
+CBoardCache g_brdCache;
+
+//////////////////////////////////////////////////////////////////
+
+CBoardCache::CBoardCache()
+{
+    m_nBudget = size_t(64) * 1024 * 1024;
+}
+
+void CBoardCache::SetBudget(size_t nBytes)
+{
+    m_nBudget = nBytes;
+    TrimToBudget(0);
+}
+
+void CBoardCache::Clear()
+{
+    m_mapChunks.clear();
+    m_lstChunks.clear();
+}
+
+void CBoardCache::InvalidateBoard(CBoard& board)
+{
+    DWORD dwDrawVersion = board.GetDrawVersion();
+    ChunkList::iterator pos = m_lstChunks.begin();
+    while (pos != m_lstChunks.end())
+    {
+        ChunkList::iterator posCur = pos++;
+        if (posCur->m_key.m_dwDrawVersion == dwDrawVersion)
+            EraseChunk(posCur);
+    }
+    // Chunks of the old appearance can never be found again.
+    board.BumpDrawVersion();
+}
+
+void CBoardCache::InvalidateRect(CBoard& board, const CRect& rctWorkspace)
+{
+    if (rctWorkspace.IsRectEmpty())
+        return;
+
+    DWORD dwDrawVersion = board.GetDrawVersion();
+    ChunkList::iterator pos = m_lstChunks.begin();
+    while (pos != m_lstChunks.end())
+    {
+        ChunkList::iterator posCur = pos++;
+        const ChunkKey& key = posCur->m_key;
+        if (key.m_dwDrawVersion != dwDrawVersion)
+            continue;
+
+        // Map the area to the chunk's scale. It's widened a little
+        // since scaled drawing rounds outward.
+        CRect rct(rctWorkspace);
+        if (key.m_eScale != fullScale)
+        {
+            CSize wsize, vsize;
+            board.GetBoardArray()->GetBoardScaling(key.m_eScale, wsize, vsize);
+            ScaleRect(rct, vsize, wsize);
+        }
+        rct.InflateRect(2, 2);
+
+        CRect rctChunk(CPoint(key.m_nCol * chunkSize, key.m_nRow * chunkSize),
+            CSize(chunkSize, chunkSize));
+        CRect rctOverlap;
+        if (rctOverlap.IntersectRect(&rctChunk, &rct))
+            EraseChunk(posCur);
+    }
+}
+
+//////////////////////////////////////////////////////////////////
+
+void CBoardCache::Draw(CDC* pDC, const CRect& rct, CBoard& board,
+    TileScale eScale, int nCellBorder /* = -1 */, int nApplyVisible /* = -1 */)
+{
+    if (rct.IsRectEmpty())
+        return;
+    if (m_nBudget == 0)
+    {
+        CRect rctDraw(rct);
+        board.Draw(pDC, &rctDraw, eScale, nCellBorder, nApplyVisible);
+        return;
+    }
+
+    ChunkKey key;
+    key.m_dwDrawVersion = board.GetDrawVersion();
+    key.m_eScale = eScale;
+    key.m_iMaxLayer = board.GetMaxDrawLayer();
+    key.m_bCellBorders = nCellBorder == -1 ? board.GetCellBorder() : nCellBorder;
+    key.m_bApplyVisible = nApplyVisible == -1 ? board.GetApplyVisible() : nApplyVisible;
+
+    CDC dcChunk;
+    dcChunk.CreateCompatibleDC(pDC);
+    CBitmap* pPrvBMap = dcChunk.GetCurrentBitmap();
+
+    int nRowLast = ChunkIndex(rct.bottom - 1);
+    int nColLast = ChunkIndex(rct.right - 1);
+    for (key.m_nRow = ChunkIndex(rct.top); key.m_nRow <= nRowLast; key.m_nRow++)
+    {
+        for (key.m_nCol = ChunkIndex(rct.left); key.m_nCol <= nColLast; key.m_nCol++)
+        {
+            CRect rctChunk(CPoint(key.m_nCol * chunkSize, key.m_nRow * chunkSize),
+                CSize(chunkSize, chunkSize));
+            CRect rctPart;
+            rctPart.IntersectRect(&rctChunk, &rct);
+
+            dcChunk.SelectObject(&GetChunk(dcChunk, key, board));
+            pDC->BitBlt(rctPart.left, rctPart.top, rctPart.Width(), rctPart.Height(),
+                &dcChunk, rctPart.left - rctChunk.left, rctPart.top - rctChunk.top,
+                SRCCOPY);
+        }
+    }
+    dcChunk.SelectObject(pPrvBMap);
+}
+
+// Returns the chunk's image, rendering it if it isn't cached. dcChunk
+// is used to render it. The chunk becomes the most recently drawn
+// one so it survives trimming until the next call.
+CBitmap& CBoardCache::GetChunk(CDC& dcChunk, const ChunkKey& key,
+    CBoard& board)
+{
+    std::map<ChunkKey, ChunkList::iterator>::iterator pos = m_mapChunks.find(key);
+    if (pos != m_mapChunks.end())
+    {
+        m_lstChunks.splice(m_lstChunks.begin(), m_lstChunks, pos->second);
+        return *pos->second->m_pBMap;
+    }
+
+    OwnerPtr<CBitmap> pBMap = MakeOwner<CBitmap>();
+    pBMap->Attach(Create16BitDIBSection(dcChunk.m_hDC, chunkSize, chunkSize));
+
+    CRect rctChunk(CPoint(key.m_nCol * chunkSize, key.m_nRow * chunkSize),
+        CSize(chunkSize, chunkSize));
+    dcChunk.SelectObject(pBMap.get());
+    SetupPalette(&dcChunk);
+    dcChunk.SetViewportOrg(-rctChunk.left, -rctChunk.top);
+
+    board.Draw(&dcChunk, &rctChunk, key.m_eScale, key.m_bCellBorders,
+        key.m_bApplyVisible);
+
+    dcChunk.SetViewportOrg(0, 0);
+    ResetPalette(&dcChunk);
+
+    m_lstChunks.push_front(Chunk{ key, std::move(pBMap) });
+    m_mapChunks.emplace(key, m_lstChunks.begin());
+    TrimToBudget(1);
+    return *m_lstChunks.front().m_pBMap;
+}
+
+void CBoardCache::EraseChunk(ChunkList::iterator pos)
+{
+    m_mapChunks.erase(pos->m_key);
+    m_lstChunks.erase(pos);
+}
+
+// Throws away the least recently drawn chunks until the budget is
+// met. The nKeep most recent ones are never thrown away.
+void CBoardCache::TrimToBudget(size_t nKeep)
+{
+    while (m_lstChunks.size() > nKeep && GetBytesUsed() > m_nBudget)
+        EraseChunk(std::prev(m_lstChunks.end()));
+}
+
+// Chunk row or column holding the pixel. Rounds down for negative
+// positions too.
+int CBoardCache::ChunkIndex(int nPos)
+{
+    return nPos >= 0 ? nPos / chunkSize : -((-nPos + chunkSize - 1) / chunkSize);
+}
@@ -0,0 +1,112 @@
+// BrdCache.h
+//
+// Copyright (c) 1994-2020 By Dale L. Larson, All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _BRDCACHE_H
+#define _BRDCACHE_H
+
+#include    <list>
+#include    <map>
+#include    <tuple>
+
+#ifndef     _BOARD_H
+#include    "Board.h"
+#endif
+
+//////////////////////////////////////////////////////////////////
+// Rendered images of boards (background, base drawing, cells, grid
+// and top drawing). Boards are cut into fixed size chunks that are
+// rendered the first time part of them is drawn. Painting a view
+// then copies chunks instead of drawing the board from scratch.
+// The chunks of every board and view share one byte budget. The
+// least recently drawn chunks are thrown away when it's exceeded.
+
+class CBoardCache
+{
+public:
+    CBoardCache();
+
+    // Draws the part of the board inside rct. The viewport of pDC
+    // must map board pixels at eScale. The board's current layer
+    // limit and the overrides (-1 means use the board's own
+    // setting) select which rendering of the board is used.
+    void Draw(CDC* pDC, const CRect& rct, CBoard& board, TileScale eScale,
+        int nCellBorder = -1, int nApplyVisible = -1);
+
+    // Throws away the board's chunks. Must be called when anything
+    // about the board's appearance changes.
+    void InvalidateBoard(CBoard& board);
+    // Throws away the board's chunks that overlap rctWorkspace (in
+    // full scale board coordinates) at any scale.
+    void InvalidateRect(CBoard& board, const CRect& rctWorkspace);
+    void Clear();
+
+    // Zero disables the cache. The board is then drawn directly.
+    void SetBudget(size_t nBytes);
+    size_t GetBudget() const { return m_nBudget; }
+    size_t GetBytesUsed() const { return m_lstChunks.size() * chunkBytes; }
+
+protected:
+    enum { chunkSize = 256 };       // Pixels per side of a chunk
+    enum { chunkBytes = chunkSize * chunkSize * 2 };    // 16 bit pixels
+
+    struct ChunkKey
+    {
+        DWORD       m_dwDrawVersion;    // CBoard::GetDrawVersion()
+        TileScale   m_eScale;
+        int         m_iMaxLayer;
+        BOOL        m_bCellBorders;
+        BOOL        m_bApplyVisible;
+        int         m_nCol;
+        int         m_nRow;
+
+        bool operator<(const ChunkKey& rhs) const
+        {
+            return std::tie(m_dwDrawVersion, m_eScale, m_iMaxLayer,
+                    m_bCellBorders, m_bApplyVisible, m_nRow, m_nCol) <
+                std::tie(rhs.m_dwDrawVersion, rhs.m_eScale, rhs.m_iMaxLayer,
+                    rhs.m_bCellBorders, rhs.m_bApplyVisible, rhs.m_nRow, rhs.m_nCol);
+        }
+    };
+    struct Chunk
+    {
+        ChunkKey    m_key;
+        OwnerPtr<CBitmap> m_pBMap;
+    };
+    typedef std::list<Chunk> ChunkList;
+
+    size_t      m_nBudget;          // Bytes
+    // Most recently drawn first.
+    ChunkList   m_lstChunks;
+    std::map<ChunkKey, ChunkList::iterator> m_mapChunks;
+
+    CBitmap& GetChunk(CDC& dcChunk, const ChunkKey& key, CBoard& board);
+    void EraseChunk(ChunkList::iterator pos);
+    void TrimToBudget(size_t nKeep);
+    static int ChunkIndex(int nPos);
+};
+
+extern CBoardCache g_brdCache;      // Shared by all board views
+
+#endif
+
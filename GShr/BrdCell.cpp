@@ -509,14 +509,32 @@ void CBoardArray::GetCellNumberStr(int row, int col, CString& str)
 
 ///////////////////////////////////////////////////////////////////////////
 
+// Version 4.00 and later follow a tileKey color with a 32 bit
+// TileID. Older files hold a 16 bit TileID in the low word of the
+// color (0xFFFFxxxx).
 void BoardCell::Serialize(CArchive& ar)
 {
     if (ar.IsStoring())
+    {
         ar << (DWORD)m_crCell;
+        if (m_crCell == tileKey)
+            ar << m_tidCell;
+    }
     else
     {
         DWORD dwTmp;
-        ar >> dwTmp; m_crCell = (COLORREF)dwTmp;
+        ar >> dwTmp;
+        if (IsLoadingWideIDs())
+        {
+            m_crCell = (COLORREF)dwTmp;
+            m_tidCell = nullTid;
+            if (m_crCell == tileKey)
+                ar >> m_tidCell;
+        }
+        else if (HIWORD(dwTmp) == 0xFFFF)
+            SetTID(TileID::FromWORD(LOWORD(dwTmp)));
+        else
+            SetColor((COLORREF)dwTmp);
     }
 }
 
@@ -532,11 +550,12 @@ BoardCell::BoardCell()
 void BoardCell::Clear()
 {
     m_crCell = noColor;
+    m_tidCell = nullTid;
 }
 
 BOOL BoardCell::IsTileID()
 {
-    return tid.m_key == 0xFFFF && tid.m_tidCell != nullTid;
+    return m_crCell == tileKey && m_tidCell != nullTid;
 }
 
 BOOL BoardCell::IsEmpty()
@@ -546,13 +565,13 @@ BOOL BoardCell::IsEmpty()
 
 TileID BoardCell::GetTID()
 {
-    return tid.m_key == 0xFFFF ? tid.m_tidCell : nullTid;
+    return m_crCell == tileKey ? m_tidCell : nullTid;
 }
 
 void BoardCell::SetTID(TileID id)
 {
-    tid.m_tidCell = id;
-    tid.m_key = 0xFFFF;
+    m_tidCell = id;
+    m_crCell = tileKey;
 }
 
 COLORREF BoardCell::GetColor()
@@ -563,6 +582,7 @@ COLORREF BoardCell::GetColor()
 void BoardCell::SetColor(COLORREF cr)
 {
     m_crCell = cr;
+    m_tidCell = nullTid;
 }
 #endif
 
@@ -35,15 +35,10 @@
 
 struct BoardCell
 {
-    union
-    {
-        COLORREF    m_crCell;   // 0xFFFFxxxx is TileID, 0xFF000000 is noColor
-        struct TID
-        {
-            TileID  m_tidCell;  // Typically terrain bitmap
-            WORD    m_key;
-        } tid;
-    };
+    COLORREF    m_crCell;       // tileKey if cell has a tile, 0xFF000000 is noColor
+    TileID      m_tidCell;      // Typically terrain bitmap
+
+    enum : COLORREF { tileKey = 0xFFFFFFFF };
     // -------- //
     BoardCell();
     // -------- //
@@ -178,16 +173,16 @@ protected:
 
 #ifndef _DEBUG
 inline  BoardCell::BoardCell() { Clear(); }
-inline  void BoardCell::Clear() { m_crCell = noColor; }
+inline  void BoardCell::Clear() { m_crCell = noColor; m_tidCell = nullTid; }
 inline  BOOL BoardCell::IsTileID()
-    { return tid.m_key == 0xFFFF && tid.m_tidCell != nullTid; }
+    { return m_crCell == tileKey && m_tidCell != nullTid; }
 inline  BOOL BoardCell::IsEmpty()  { return m_crCell == noColor; }
 inline  TileID BoardCell::GetTID()
-    { return tid.m_key == 0xFFFF ? tid.m_tidCell : nullTid; }
+    { return m_crCell == tileKey ? m_tidCell : nullTid; }
 inline  void BoardCell::SetTID(TileID id)
-    { tid.m_tidCell = id; tid.m_key = 0xFFFF; }
+    { m_tidCell = id; m_crCell = tileKey; }
 inline  COLORREF BoardCell::GetColor() { return m_crCell; }
-inline  void BoardCell::SetColor(COLORREF cr) { m_crCell = cr; }
+inline  void BoardCell::SetColor(COLORREF cr) { m_crCell = cr; m_tidCell = nullTid; }
 #endif
 
 #endif
@@ -304,85 +304,139 @@ BOOL CDib::AppendDIB(CDib *pDib)
 
 CArchive& AFXAPI operator<<(CArchive& ar, const CDib& dib)
 {
-    if (dib.m_hDib)
-    {
-        DWORD dwSize = GlobalSize(dib.m_hDib);
-        ASSERT(dwSize > 0);
-        ASSERT(dib.m_nCompressLevel >= Z_NO_COMPRESSION
-            && dib.m_nCompressLevel <= Z_BEST_COMPRESSION);
-        if (dib.m_nCompressLevel > Z_NO_COMPRESSION)
-        {
-            // Store size of the uncompressed dib bfr with upper bit set.
-            // The set upper bit allows us to detect loading of uncompressed
-            // bitmaps.
-            ar << (dwSize | 0x80000000);
-
-            // Use zlib to compress the dib before writing it out the the archive.
-            DWORD dwDestLen = MulDiv(dwSize, 1001, 1000) + 12;
-            LPVOID pDestBfr = GlobalAlloc(GPTR, dwDestLen);
-            if (pDestBfr == NULL)
-                AfxThrowMemoryException();
-            int err = compress2((LPBYTE)pDestBfr, &dwDestLen, (LPBYTE)dib.m_lpDib,
-                dwSize, dib.m_nCompressLevel);
-            if (err != Z_OK)
-            {
-                GlobalFree(GlobalHandle(pDestBfr));
-                AfxThrowMemoryException();
-            }
-            ar << dwDestLen;                    // Store the compressed size of the bitmap
-            ar.Write(pDestBfr, dwDestLen);      // Store the compressed bitmap
-            GlobalFree(GlobalHandle(pDestBfr));
-        }
-        else
-        {
-            // Store size of the raw dib
-            ar << dwSize;
-            ar.Write(dib.m_lpDib, dwSize);      // Store the uncompressed bitmap
-        }
-    }
-    else
-        ar << (DWORD)0;
+    CPackedDib pdib;
+    pdib.Pack(dib, dib.m_nCompressLevel);
+    ar << pdib;
     return ar;
 }
 
 CArchive& AFXAPI operator>>(CArchive& ar, CDib& dib)
 {
-    dib.ClearDib();
-    DWORD dwSize;
-    ar >> dwSize;
-    if ((dwSize & 0x80000000) != 0)
-    {
-        // Load compressed bitmap...
-        dwSize &= 0x7FFFFFFF;       // Remove flag bit
+    CPackedDib pdib;
+    ar >> pdib;
+    pdib.Unpack(dib);
+    return ar;
+}
 
-        DWORD dwCompSize;
-        ar >> dwCompSize;           // Get compressed data size
+///////////////////////////////////////////////////////////////
 
-        LPVOID pCompBfr = GlobalAlloc(GPTR, dwCompSize);
-        if (pCompBfr == NULL)
-            AfxThrowMemoryException();
+void CPackedDib::Clear()
+{
+    m_dwSize = 0;
+    m_tblData.clear();
+    m_tblData.shrink_to_fit();
+    memset(&m_bmiHdr, 0, sizeof(m_bmiHdr));
+}
+
+void CPackedDib::Pack(const CDib& dib, int nCompressLevel)
+{
+    Clear();
+    if (dib.m_hDib == NULL)
+        return;
 
-        if ((dib.m_hDib = (HDIB)GlobalAlloc(GHND, dwSize)) == NULL)
+    DWORD dwSize = GlobalSize(dib.m_hDib);
+    ASSERT(dwSize > 0);
+    ASSERT(nCompressLevel >= Z_NO_COMPRESSION && nCompressLevel <= Z_BEST_COMPRESSION);
+    memcpy(&m_bmiHdr, dib.m_lpDib, sizeof(m_bmiHdr));
+    if (nCompressLevel > Z_NO_COMPRESSION)
+    {
+        // Store size of the uncompressed dib bfr with upper bit set.
+        // The set upper bit allows us to detect loading of uncompressed
+        // bitmaps.
+        m_dwSize = dwSize | 0x80000000;
+
+        // Use zlib to compress the dib.
+        uLongf dwDestLen = compressBound(dwSize);
+        m_tblData.resize(value_preserving_cast<size_t>(dwDestLen));
+        int err = compress2(m_tblData.data(), &dwDestLen, (LPBYTE)dib.m_lpDib,
+            dwSize, nCompressLevel);
+        if (err != Z_OK)
+        {
+            Clear();
             AfxThrowMemoryException();
-        dib.m_lpDib = (LPSTR)GlobalLock((HGLOBAL)dib.m_hDib);
+        }
+        m_tblData.resize(value_preserving_cast<size_t>(dwDestLen));
+        m_tblData.shrink_to_fit();
+    }
+    else
+    {
+        // Store the raw dib
+        m_dwSize = dwSize;
+        m_tblData.assign((LPBYTE)dib.m_lpDib, (LPBYTE)dib.m_lpDib + dwSize);
+    }
+}
 
-        ar.Read(pCompBfr, dwCompSize);
+void CPackedDib::Unpack(CDib& dib) const
+{
+    dib.ClearDib();
+    if (IsEmpty())
+        return;
 
-        int err = uncompress((LPBYTE)dib.m_lpDib, &dwSize,
-            (LPBYTE)pCompBfr, dwCompSize);
+    DWORD dwSize = GetDibSize();
+    if ((dib.m_hDib = (HDIB)GlobalAlloc(GHND, dwSize)) == NULL)
+        AfxThrowMemoryException();
+    dib.m_lpDib = (LPSTR)GlobalLock((HGLOBAL)dib.m_hDib);
 
-        GlobalFree(GlobalHandle(pCompBfr));
+    if (IsCompressed())
+    {
+        int err = uncompress((LPBYTE)dib.m_lpDib, &dwSize,
+            m_tblData.data(), value_preserving_cast<uLong>(m_tblData.size()));
         if (err != Z_OK)
+        {
+            dib.ClearDib();
             AfxThrowMemoryException();
+        }
     }
-    else if (dwSize > 0)
+    else
+        memcpy(dib.m_lpDib, m_tblData.data(), dwSize);
+}
+
+// Same stream format as a CDib.
+CArchive& AFXAPI operator<<(CArchive& ar, const CPackedDib& pdib)
+{
+    ar << pdib.m_dwSize;
+    if (pdib.IsCompressed())
+        ar << value_preserving_cast<DWORD>(pdib.m_tblData.size());
+    if (!pdib.IsEmpty())
+        ar.Write(pdib.m_tblData.data(), value_preserving_cast<UINT>(pdib.m_tblData.size()));
+    return ar;
+}
+
+CArchive& AFXAPI operator>>(CArchive& ar, CPackedDib& pdib)
+{
+    pdib.Clear();
+    ar >> pdib.m_dwSize;
+    DWORD dwDataSize = pdib.m_dwSize;
+    if (pdib.IsCompressed())
+        ar >> dwDataSize;           // Get compressed data size
+    if (dwDataSize == 0)
+        return ar;
+
+    pdib.m_tblData.resize(value_preserving_cast<size_t>(dwDataSize));
+    ar.Read(pdib.m_tblData.data(), dwDataSize);
+
+    // Decode just enough of the DIB to get its header.
+    if (pdib.IsCompressed())
     {
-        // Load uncompressed bitmap...
-        if ((dib.m_hDib = (HDIB)GlobalAlloc(GHND, dwSize)) == NULL)
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        strm.next_in = pdib.m_tblData.data();
+        strm.avail_in = dwDataSize;
+        strm.next_out = (LPBYTE)&pdib.m_bmiHdr;
+        strm.avail_out = sizeof(pdib.m_bmiHdr);
+        if (inflateInit(&strm) != Z_OK)
             AfxThrowMemoryException();
-        dib.m_lpDib = (LPSTR)GlobalLock((HGLOBAL)dib.m_hDib);
-
-        ar.Read(dib.m_lpDib, dwSize);
+        int err = inflate(&strm, Z_SYNC_FLUSH);
+        inflateEnd(&strm);
+        if ((err != Z_OK && err != Z_STREAM_END) || strm.avail_out != 0)
+            AfxThrowMemoryException();
+    }
+    else
+    {
+        // A truncated or corrupt file can't be parsed.
+        if (dwDataSize < sizeof(pdib.m_bmiHdr))
+            AfxThrowArchiveException(CArchiveException::badSchema);
+        memcpy(&pdib.m_bmiHdr, pdib.m_tblData.data(), sizeof(pdib.m_bmiHdr));
     }
     return ar;
 }
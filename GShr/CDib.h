@@ -84,5 +84,38 @@ public:
     friend CArchive& AFXAPI operator>>(CArchive& ar, CDib& dib);
 };
 
+// A DIB kept in the form it was archived in (usually zlib compressed).
+// The header is decoded on load so the DIB's size is known without
+// inflating the bits. Unpack() produces the CDib.
+class CPackedDib
+{
+public:
+    CPackedDib() { Clear(); }
+    void Clear();
+    BOOL IsEmpty() const { return m_tblData.empty(); }
+    // ---------- //
+    int Height() const { return (int)m_bmiHdr.biHeight; }
+    int Width() const { return (int)m_bmiHdr.biWidth; }
+    int NumColors() const { return m_bmiHdr.biBitCount; }
+    size_t GetPackedSize() const { return m_tblData.size(); }
+    const BYTE* GetPackedData() const { return m_tblData.data(); }
+    // ---------- //
+    // Pack() and Unpack() only touch memory so they can run on
+    // worker threads.
+    void Pack(const CDib& dib, int nCompressLevel);
+    void Unpack(CDib& dib) const;
+    // ---------- //
+    friend CArchive& AFXAPI operator<<(CArchive& ar, const CPackedDib& pdib);
+    friend CArchive& AFXAPI operator>>(CArchive& ar, CPackedDib& pdib);
+
+protected:
+    DWORD       m_dwSize;       // Archived size word (upper bit set if compressed)
+    std::vector<BYTE> m_tblData;
+    BITMAPINFOHEADER m_bmiHdr;
+
+    BOOL IsCompressed() const { return (m_dwSize & 0x80000000) != 0; }
+    DWORD GetDibSize() const { return m_dwSize & 0x7FFFFFFF; }
+};
+
 #endif
 
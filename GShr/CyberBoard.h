@@ -26,10 +26,13 @@
 #define _CYBERBOARD_H
 
 // use explicitly sized ints for portable file format control
+#include <algorithm>
 #include <cinttypes>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -568,6 +571,11 @@ namespace CB
 
 /////////////////////////////////////////////////////////////////////////////
 
+/* File version 4.00 and later store IDs, ID table sizes and
+    move indices as 32 bit values.  Each program implements
+    this using the loading version of its CGamDoc. */
+bool IsLoadingWideIDs();
+
 template<char PREFIX_>
 class XxxxID
 {
@@ -575,21 +583,24 @@ public:
     static constexpr char PREFIX = PREFIX_;
 
     XxxxID() = default;
-    // goal is 32bit ids, but currently ids are 16 bit
-    explicit constexpr XxxxID(uint32_t i) : id(value_preserving_cast<uint16_t>(i)) {}
+    explicit constexpr XxxxID(uint32_t i) : id(i) {}
 
     template<typename T>
     explicit constexpr XxxxID(T i) : XxxxID(value_preserving_cast<uint32_t>(i)) { static_assert(std::is_integral_v<T>, "id must be an integer"); }
 
     ~XxxxID() = default;
 
-    explicit constexpr operator WORD() const { return id; }
+    explicit constexpr operator uint32_t() const { return id; }
+
+    /* Files before version 4.00 hold 16 bit IDs with 0xFFFF as
+        the null ID.  All ones is the null ID of every XxxxID. */
+    static constexpr XxxxID FromWORD(WORD w) { return XxxxID(w == WORD(0xFFFF) ? uint32_t(0xFFFFFFFF) : uint32_t(w)); }
 
     bool operator==(const XxxxID& rhs) const { return id == rhs.id; }
     bool operator!=(const XxxxID& rhs) const { return !operator==(rhs); }
 
 private:
-    uint16_t id;
+    uint32_t id;
 };
 
 template<char PREFIX>
@@ -599,8 +610,7 @@ CArchive& operator<<(CArchive& ar, const XxxxID<PREFIX>& oid)
     {
         AfxThrowArchiveException(CArchiveException::readOnly);
     }
-    static_assert(sizeof(uint16_t) == sizeof(oid), "wrong serialize type");
-    return ar << reinterpret_cast<const uint16_t&>(oid);
+    return ar << static_cast<DWORD>(static_cast<uint32_t>(oid));
 }
 
 template<char PREFIX>
@@ -610,21 +620,19 @@ CArchive& operator>>(CArchive& ar, XxxxID<PREFIX>& oid)
     {
         AfxThrowArchiveException(CArchiveException::writeOnly);
     }
-    static_assert(sizeof(uint16_t) == sizeof(oid), "wrong serialize type");
-    return ar >> reinterpret_cast<uint16_t&>(oid);
-}
-
-// KLUDGE:  use unique_ptr since CWordArray doesn't have move operators
-template<char PREFIX>
-std::unique_ptr<const CWordArray> ToCWordArray(const std::vector<XxxxID<PREFIX>>& v)
-{
-    std::unique_ptr<CWordArray> retval(new CWordArray);
-    retval->SetSize(value_preserving_cast<INT_PTR>(v.size()));
-    for (INT_PTR i = 0; i < retval->GetSize(); ++i)
+    if (IsLoadingWideIDs())
     {
-        (*retval)[i] = static_cast<WORD>(v[value_preserving_cast<size_t>(i)]);
+        DWORD dwTmp;
+        ar >> dwTmp;
+        oid = static_cast<XxxxID<PREFIX>>(dwTmp);
     }
-    return retval;
+    else
+    {
+        WORD wTmp;
+        ar >> wTmp;
+        oid = XxxxID<PREFIX>::FromWORD(wTmp);
+    }
+    return ar;
 }
 
 template<typename T>
@@ -635,7 +643,7 @@ std::vector<T> ToVector(const CWordArray& a)
     retval.resize(value_preserving_cast<size_t>(a.GetSize()));
     for (INT_PTR i = 0; i < a.GetSize(); ++i)
     {
-        retval[value_preserving_cast<size_t>(i)] = static_cast<T>(a[i]);
+        retval[value_preserving_cast<size_t>(i)] = T::FromWORD(a[i]);
     }
     return retval;
 }
@@ -647,8 +655,10 @@ CArchive& operator<<(CArchive& ar, const std::vector<XxxxID<PREFIX>>& v)
     {
         AfxThrowArchiveException(CArchiveException::readOnly);
     }
-    // KLUDGE:  current file format uses MFC CWordArray
-    const_cast<CWordArray*>(ToCWordArray(v).get())->Serialize(ar);
+    // Same count encoding as CWordArray, but with 32 bit IDs
+    ar.WriteCount(value_preserving_cast<DWORD_PTR>(v.size()));
+    for (size_t i = 0; i < v.size(); ++i)
+        ar << v[i];
     return ar;
 }
 
@@ -659,27 +669,49 @@ CArchive& operator>>(CArchive& ar, std::vector<XxxxID<PREFIX>>& v)
     {
         AfxThrowArchiveException(CArchiveException::writeOnly);
     }
-    // KLUDGE:  current file format uses MFC CWordArray
-    CWordArray temp;
-    temp.Serialize(ar);
-    v = ToVector<XxxxID<PREFIX>>(temp);
+    if (IsLoadingWideIDs())
+    {
+        v.clear();
+        v.resize(value_preserving_cast<size_t>(ar.ReadCount()));
+        for (size_t i = 0; i < v.size(); ++i)
+            ar >> v[i];
+    }
+    else
+    {
+        // KLUDGE:  older file formats use MFC CWordArray
+        CWordArray temp;
+        temp.Serialize(ar);
+        v = ToVector<XxxxID<PREFIX>>(temp);
+    }
     return ar;
 }
 
 template<typename DEST, char PREFIX>
-constexpr std::enable_if_t<is_always_value_preserving_v<DEST, WORD>, DEST> value_preserving_cast(XxxxID<PREFIX> src)
+constexpr std::enable_if_t<is_always_value_preserving_v<DEST, uint32_t>, DEST> value_preserving_cast(XxxxID<PREFIX> src)
 {
-    return static_cast<DEST>(static_cast<WORD>(src));
+    return static_cast<DEST>(static_cast<uint32_t>(src));
 }
 
 template<typename DEST, char PREFIX>
-constexpr std::enable_if_t<!is_always_value_preserving_v<DEST, WORD>, DEST> value_preserving_cast(XxxxID<PREFIX> src)
+constexpr std::enable_if_t<!is_always_value_preserving_v<DEST, uint32_t>, DEST> value_preserving_cast(XxxxID<PREFIX> src)
 {
-    if (!is_value_preserving<DEST>(static_cast<WORD>(src)))
+    if (!is_value_preserving<DEST>(static_cast<uint32_t>(src)))
     {
         CbThrowBadCastException();
     }
-    return static_cast<DEST>(static_cast<WORD>(src));
+    return static_cast<DEST>(static_cast<uint32_t>(src));
+}
+
+namespace std
+{
+    template<char PREFIX>
+    struct hash<XxxxID<PREFIX>>
+    {
+        size_t operator()(const XxxxID<PREFIX>& id) const
+        {
+            return hash<uint32_t>()(static_cast<uint32_t>(id));
+        }
+    };
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -710,28 +742,42 @@ public:
 
     XxxxIDTable& operator=(const XxxxIDTable& other)
     {
-        ResizeTable(other.GetSize(), nullptr);
-        /* ELEMENT is trivially copyable, so this is safe
-            (and more efficient than for loop with assignments) */
-        memcpy(m_pTbl, other.m_pTbl, GetSize()*sizeof(ELEMENT));
+        if (this == &other)
+            return *this;
+        Clear();
+        if (other.GetSize() != size_t(0))
+        {
+            ResizeTable(other.GetSize(), nullptr);
+            /* ELEMENT is trivially copyable, so this is safe
+                (and more efficient than for loop with assignments) */
+            memcpy(m_pTbl, other.m_pTbl, GetSize()*sizeof(ELEMENT));
+        }
+        m_tblFree = other.m_tblFree;
         return *this;
     }
 
     XxxxIDTable(XxxxIDTable&& other) noexcept
     {
         m_pTbl = other.m_pTbl;
-        m_nTblSize = other.m_pTbl;
+        m_nTblSize = other.m_nTblSize;
+        m_tblFree = std::move(other.m_tblFree);
         other.m_pTbl = NULL;
-        other.m_pTbl = 0;
+        other.m_nTblSize = 0;
+        other.m_tblFree.clear();
     }
 
     XxxxIDTable& operator=(XxxxIDTable&& other) noexcept
     {
+        if (this == &other)
+            return *this;
         if (m_pTbl != NULL) free(m_pTbl);
         m_pTbl = other.m_pTbl;
-        m_nTblSize = other.m_pTbl;
+        m_nTblSize = other.m_nTblSize;
+        m_tblFree = std::move(other.m_tblFree);
         other.m_pTbl = NULL;
-        other.m_pTbl = 0;
+        other.m_nTblSize = 0;
+        other.m_tblFree.clear();
+        return *this;
     }
 
     ~XxxxIDTable()
@@ -743,9 +789,9 @@ public:
     bool operator!=(nullptr_t) const { return !operator==(nullptr); }
     bool Empty() const { return !m_pTbl; }
     size_t GetSize() const { return m_nTblSize; }
-    bool Valid(KEY tid) const { return static_cast<WORD>(tid) < m_nTblSize; }
+    bool Valid(KEY tid) const { return static_cast<uint32_t>(tid) < m_nTblSize; }
 
-    const ELEMENT& operator[](KEY tid) const { return m_pTbl[static_cast<WORD>(tid)]; }
+    const ELEMENT& operator[](KEY tid) const { return m_pTbl[static_cast<uint32_t>(tid)]; }
     ELEMENT& operator[](KEY tid) { return const_cast<ELEMENT&>(std::as_const(*this)[tid]); }
 
     void Clear()
@@ -753,16 +799,21 @@ public:
         if (m_pTbl != NULL) free(m_pTbl);
         m_pTbl = NULL;
         m_nTblSize = 0;
+        m_tblFree.clear();
     }
 
     /* WARNING:  will need to be generalized if an ELEMENT
         without IsEmpty() wants to use this */
+    /* Always hands out the lowest empty entry (same as the
+        old linear scan) so ID assignment stays deterministic.
+        The caller is expected to fill the entry right away. */
     KEY CreateIDEntry(void (ELEMENT::*initializer)())
     {
         // Allocate from empty entry if possible
-        for (size_t i = 0; i < m_nTblSize; i++)
+        while (!m_tblFree.empty())
         {
-            if (m_pTbl[i].IsEmpty())
+            size_t i = PopFreeEntry();
+            if (i < m_nTblSize && m_pTbl[i].IsEmpty())
                 return static_cast<KEY>(i);
         }
         // Get TileID from end of table.
@@ -771,10 +822,31 @@ public:
             AfxThrowMemoryException();
         }
         KEY newXid = static_cast<KEY>(m_nTblSize);
+        size_t nOldSize = m_nTblSize;
         ResizeTable(m_nTblSize + 1, initializer);
+        // Spare entries from rounding up the allocation are free
+        for (size_t i = nOldSize + 1; i < m_nTblSize; i++)
+        {
+            if (!initializer)
+                m_pTbl[i].SetEmpty();
+            if (m_pTbl[i].IsEmpty())
+                PushFreeEntry(i);
+        }
         return newXid;
     }
 
+    /* Empties an entry and makes its ID available to
+        CreateIDEntry() again.  Entries must not be emptied
+        through operator[] or the ID won't be reused. */
+    void DeleteIDEntry(KEY tid)
+    {
+        ASSERT(Valid(tid));
+        ELEMENT& elem = m_pTbl[static_cast<uint32_t>(tid)];
+        ASSERT(!elem.IsEmpty());
+        elem.SetEmpty();
+        PushFreeEntry(static_cast<uint32_t>(tid));
+    }
+
     void ResizeTable(size_t nEntsNeeded, void (ELEMENT::*initializer)())
     {
         if (nEntsNeeded == 0)
@@ -819,27 +891,139 @@ public:
                 ;
             if (!inGplay || saveInGPlay)
             {
-                ar << value_preserving_cast<WORD>(m_nTblSize);
-                for (size_t i = 0; i < m_nTblSize; i++)
-                    m_pTbl[i].Serialize(ar);
+                if constexpr (bulkSerialize)
+                {
+                    ar << bulkMarker;
+                    ar << bulkVersion;
+                    ar << bulkLittleEndian;
+                    ar << value_preserving_cast<WORD>(sizeof(ELEMENT));
+                    ar << value_preserving_cast<DWORD>(m_nTblSize);
+                    ar.Write(m_pTbl, value_preserving_cast<UINT>(m_nTblSize * sizeof(ELEMENT)));
+                }
+                else
+                {
+                    ar << value_preserving_cast<DWORD>(m_nTblSize);
+                    for (size_t i = 0; i < m_nTblSize; i++)
+                        m_pTbl[i].Serialize(ar);
+                }
             }
         }
         else
         {
-            WORD wTmp;
-            ar >> wTmp;
-            if (wTmp > 0)
+            Clear();
+            size_t nLoaded = 0;
+            if (IsLoadingWideIDs() && !bulkSerialize)
+            {
+                DWORD dwTmp;
+                ar >> dwTmp;
+                nLoaded = SerializeElementsLoad(ar, dwTmp);
+            }
+            else
             {
-                ResizeTable(value_preserving_cast<size_t>(wTmp), nullptr);
-                for (size_t i = 0; i < wTmp; i++)
-                    m_pTbl[i].Serialize(ar);
+                WORD wTmp;
+                ar >> wTmp;
+                if (wTmp == bulkMarker)
+                    nLoaded = SerializeBulkLoad(ar);
+                else if (!IsLoadingWideIDs())
+                    nLoaded = SerializeElementsLoad(ar, wTmp);
+                else
+                    AfxThrowArchiveException(CArchiveException::badSchema);
             }
+            // Pad entries past the loaded ones are free
+            for (size_t i = nLoaded; i < m_nTblSize; i++)
+                m_pTbl[i].SetEmpty();
+            RebuildFreeList();
         }
     }
 
 private:
+    /* Elements without padding are written as one memory
+        image (version 3.92).  The block starts with a WORD
+        marker that can't be a table size, so older files
+        still take the per-element path.  (Files before 4.00
+        held at most 32000 entries per table, and 4.00 files
+        only use the WORD marker for bulk tables.)  Version 1
+        blocks (file version 3.92) hold 16 bit IDs and are laid
+        out exactly like the per-element records of that
+        version.  Version 2 blocks (file version 4.00) hold
+        32 bit IDs. */
+    static constexpr bool bulkSerialize = std::has_unique_object_representations_v<ELEMENT>;
+    static_assert(maxSize < 0xFFFFFFFF, "IDs must stay below the null ID");
+    static constexpr WORD bulkMarker = 0xFFFF;
+    static constexpr BYTE bulkVersion = 2;
+    static constexpr BYTE bulkLittleEndian = 'L';
+
+    size_t SerializeElementsLoad(CArchive& ar, DWORD dwCount)
+    {
+        if (dwCount > maxSize)
+            AfxThrowArchiveException(CArchiveException::badSchema);
+        size_t nCount = value_preserving_cast<size_t>(dwCount);
+        if (nCount > 0)
+        {
+            ResizeTable(nCount, nullptr);
+            for (size_t i = 0; i < nCount; i++)
+                m_pTbl[i].Serialize(ar);
+        }
+        return nCount;
+    }
+
+    size_t SerializeBulkLoad(CArchive& ar)
+    {
+        BYTE byVersion, byEndian;
+        WORD wElemSize;
+        DWORD dwCount;
+        ar >> byVersion;
+        ar >> byEndian;
+        ar >> wElemSize;
+        ar >> dwCount;
+        if (byVersion == 1 && !IsLoadingWideIDs())
+            return SerializeElementsLoad(ar, dwCount);
+        if (!bulkSerialize || byVersion != bulkVersion ||
+            byEndian != bulkLittleEndian || wElemSize != sizeof(ELEMENT) ||
+            dwCount > maxSize)
+        {
+            AfxThrowArchiveException(CArchiveException::badSchema);
+        }
+        size_t nCount = value_preserving_cast<size_t>(dwCount);
+        if (nCount > 0)
+        {
+            ResizeTable(nCount, nullptr);
+            UINT nBytes = value_preserving_cast<UINT>(nCount * sizeof(ELEMENT));
+            if (ar.Read(m_pTbl, nBytes) != nBytes)
+                AfxThrowArchiveException(CArchiveException::endOfFile);
+        }
+        return nCount;
+    }
+
+    void RebuildFreeList()
+    {
+        m_tblFree.clear();
+        for (size_t i = 0; i < m_nTblSize; i++)
+        {
+            if (m_pTbl[i].IsEmpty())
+                m_tblFree.push_back(i);
+        }
+        // Ascending order is already a valid min-heap
+    }
+
+    void PushFreeEntry(size_t i)
+    {
+        m_tblFree.push_back(i);
+        std::push_heap(m_tblFree.begin(), m_tblFree.end(), std::greater<size_t>());
+    }
+
+    size_t PopFreeEntry()
+    {
+        ASSERT(!m_tblFree.empty());
+        std::pop_heap(m_tblFree.begin(), m_tblFree.end(), std::greater<size_t>());
+        size_t i = m_tblFree.back();
+        m_tblFree.pop_back();
+        return i;
+    }
+
     ELEMENT*    m_pTbl;         // Global def'ed
     size_t      m_nTblSize;     // Number of alloc'ed ents in tile table
+    std::vector<size_t> m_tblFree;  // Min-heap of empty entry indices
 };
 
 template<typename KEY, typename ELEMENT,
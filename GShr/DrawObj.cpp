@@ -24,6 +24,8 @@
 
 #include    "stdafx.h"
 #include    <limits.h>
+#include    <algorithm>
+#include    <unordered_set>
 #ifdef      GPLAY
     #include    "Gp.h"
     #include    "GamDoc.h"
@@ -49,10 +51,17 @@
 #define new DEBUG_NEW
 #endif
 
+// Spacing of the draw order keys of a draw list's grid entries
+static const uint64_t gridOrderGap = uint64_t(1) << 32;
+
 #if defined(GPLAY)
 static_assert(sizeof(ObjectID) == sizeof(uint32_t), "size error");
 static_assert(sizeof(ObjectID) == sizeof(DWORD), "size error");
 static_assert(alignof(ObjectID) == alignof(uint32_t), "align error");
+
+// Multiplier for the order dependent draw list state hash (odd)
+static const uint64_t stateHashMult = 0x100000001B3;
+
 namespace {
     class ObjectIDCheck
     {
@@ -83,8 +92,10 @@ ObjectID::ObjectID(uint16_t i, uint16_t s, CDrawObj::CDrawObjType t) :
 
 ObjectID::ObjectID(PieceID pid)
 {
-    id = static_cast<uint16_t>(pid);
-    serial = 0;
+    uint32_t nPid = static_cast<uint32_t>(pid);
+    ASSERT(nPid < 0x10000000 || !"PieceID doesn't fit an ObjectID");
+    id = static_cast<uint16_t>(nPid & 0xFFFF);
+    serial = static_cast<uint16_t>((nPid >> 16) & 0x0FFF);
     subtype = 0;
 }
 
@@ -99,7 +110,6 @@ ObjectID::ObjectID(DWORD dw)
 
 CPen*   CDrawObj::c_pPrvPen = NULL;
 CBrush* CDrawObj::c_pPrvBrush = NULL;
-BOOL    CDrawObj::c_bHitTestDraw = FALSE;
 
 //////////////////////////////////////////////////////////////////
 // Class CDrawObj
@@ -123,10 +133,18 @@ ObjectID CDrawObj::GetObjectID() const
     return ObjectID();
 }
 
+// Plain drawing objects can be in a board's indicator list so
+// they need a hash even though they can't be compared.
+uint64_t CDrawObj::GetStateHash() const
+{
+    return CombineStateHash(GetType(), m_rctExtent);
+}
+
 void CDrawObj::MoveObject(CPoint ptUpLeft)
 {
     m_rctExtent += CPoint(ptUpLeft.x - m_rctExtent.left,
         ptUpLeft.y - m_rctExtent.top);
+    NoteChanged();
 }
 #endif
 
@@ -134,9 +152,16 @@ void CDrawObj::MoveObject(CPoint ptUpLeft)
 void CDrawObj::OffsetObject(CPoint offset)
 {
     m_rctExtent += offset;
+    NoteChanged();
 }
 //DFM991129
 
+void CDrawObj::NoteChanged()
+{
+    if (m_pDrawList != NULL)
+        m_pDrawList->OnObjectChanged(*this);
+}
+
 BOOL CDrawObj::IsExtentOutOfZone(const CRect& pRctZone, CPoint& pnt) const
 {
     CRect rct;
@@ -159,25 +184,15 @@ BOOL CDrawObj::IsExtentOutOfZone(const CRect& pRctZone, CPoint& pnt) const
 
 void CDrawObj::SetUpDraw(CDC& pDC, CPen& pPen, CBrush& pBrush) const
 {
-    if (c_bHitTestDraw)
-        pPen.CreateStockObject(BLACK_PEN);
-    else
+    if (GetLineColor() != noColor)
     {
-        if (GetLineColor() != noColor)
-        {
-            pPen.CreatePen(PS_SOLID, GetLineWidth(), GetLineColor());
-        }
-        else
-            pPen.CreateStockObject(NULL_PEN);
+        pPen.CreatePen(PS_SOLID, GetLineWidth(), GetLineColor());
     }
+    else
+        pPen.CreateStockObject(NULL_PEN);
 
     if (GetFillColor() != noColor)
-    {
-        if (c_bHitTestDraw)
-            pBrush.CreateStockObject(BLACK_BRUSH);
-        else
-            pBrush.CreateSolidBrush(GetFillColor());
-    }
+        pBrush.CreateSolidBrush(GetFillColor());
     else
         pBrush.CreateStockObject(NULL_BRUSH);
 
@@ -191,45 +206,56 @@ void CDrawObj::CleanUpDraw(CDC& pDC) const
     pDC.SelectObject(c_pPrvBrush);
 }
 
-const int hitZone = 5;          // Must be odd and <= 15
-
-static WORD bmapSeed[hitZone] =
-    { 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF };
+// Points within this many pixels of a drawn edge (plus half the
+// line width) count as hits.
+const int hitZone = 2;
 
-BOOL CDrawObj::BitBlockHitTest(CPoint pt)
+static int GetHitTolerance(UINT nLineWidth)
 {
-    CDC dcmem;
-    CBitmap bmap;
-
-    dcmem.CreateCompatibleDC(NULL);
-    bmap.CreateBitmap(8, 8, 1, 1, NULL);
-
-    CBitmap* pPrvBMap = dcmem.SelectObject(&bmap);
-    dcmem.PatBlt(0, 0, 8, 8, WHITENESS);
-
-    dcmem.SetViewportOrg(-(pt.x - hitZone/2), -(pt.y - hitZone/2));
+    return hitZone + value_preserving_cast<int>(nLineWidth / 2);
+}
 
-    c_bHitTestDraw = TRUE;
-    Draw(dcmem, fullScale);
-    c_bHitTestDraw = FALSE;
+// Squared distance from the point to the line segment.
+static double DistSqToSegment(CPoint pt, CPoint ptBeg, CPoint ptEnd)
+{
+    double dx = double(ptEnd.x - ptBeg.x);
+    double dy = double(ptEnd.y - ptBeg.y);
+    double px = double(pt.x - ptBeg.x);
+    double py = double(pt.y - ptBeg.y);
+    double dLenSq = dx * dx + dy * dy;
+    if (dLenSq > 0.0)
+    {
+        double t = (px * dx + py * dy) / dLenSq;
+        if (t < 0.0)
+            t = 0.0;
+        else if (t > 1.0)
+            t = 1.0;
+        px -= t * dx;
+        py -= t * dy;
+    }
+    return px * px + py * py;
+}
 
-    BOOL bHit = FALSE;
-    dcmem.SetViewportOrg(0, 0);
+static BOOL IsNearSegment(CPoint pt, CPoint ptBeg, CPoint ptEnd, int nTol)
+{
+    return DistSqToSegment(pt, ptBeg, ptEnd) <= double(nTol) * double(nTol);
+}
 
-    for (int x = 0; x < hitZone; x++)
+// Even-odd rule to match GDI's default ALTERNATE polygon fill.
+static BOOL IsPtInPolygon(CPoint pt, const std::vector<POINT>& pnts)
+{
+    BOOL bInside = FALSE;
+    for (size_t i = size_t(0), j = pnts.size() - size_t(1); i < pnts.size(); j = i++)
     {
-        for (int y = 0; y < hitZone; y++)
+        const POINT& pi = pnts[i];
+        const POINT& pj = pnts[j];
+        if ((pi.y > pt.y) != (pj.y > pt.y) &&
+            pt.x < pi.x + double(pj.x - pi.x) * double(pt.y - pi.y) / double(pj.y - pi.y))
         {
-            if (dcmem.GetPixel(x, y) == RGB(0,0,0))
-            {
-                bHit = TRUE;
-                goto SCANDONE;
-            }
+            bInside = !bInside;
         }
     }
-SCANDONE:
-    dcmem.SelectObject(pPrvBMap);
-    return bHit;
+    return bInside;
 }
 
 void CDrawObj::Serialize(CArchive& ar)
@@ -265,6 +291,7 @@ void CDrawObj::CopyAttributes(const CDrawObj& source)
 {
     m_dwDObjFlags = source.m_dwDObjFlags;
     m_rctExtent   = source.m_rctExtent;
+    NoteChanged();
 }
 //DFM19991213
 
@@ -295,9 +322,19 @@ BOOL CRectObj::HitTest(CPoint pt)
     if (!rct.PtInRect(pt))
         return FALSE;
 
-    // Now check for actual image hit. (!!!For rects this could actually
-    // be qualified without using the bit block method!!!)
-    return BitBlockHitTest(pt);
+    // Now check for actual image hit. Outlines are hit even if
+    // drawn with no color so they can still be selected.
+    int nTol = GetHitTolerance(m_nLineWidth);
+    CRect rctOuter = m_rctExtent;
+    rctOuter.NormalizeRect();
+    CRect rctInner = rctOuter;
+    rctOuter.InflateRect(nTol, nTol);
+    if (!rctOuter.PtInRect(pt))
+        return FALSE;
+    if (m_crFill != noColor)
+        return TRUE;
+    rctInner.DeflateRect(nTol, nTol);
+    return rctInner.IsRectEmpty() || !rctInner.PtInRect(pt);
 }
 
 #ifndef     GPLAY
@@ -305,7 +342,7 @@ void CRectObj::ForceIntoZone(const CRect& pRctZone)
 {
     CPoint pntOffset;
     if (IsExtentOutOfZone(pRctZone, pntOffset))
-        m_rctExtent += pntOffset;
+        OffsetObject(pntOffset);
 }
 
 OwnerPtr<CSelection> CRectObj::CreateSelectProxy(CBrdEditView& pView)
@@ -368,6 +405,35 @@ void CEllipse::Draw(CDC& pDC, TileScale)
     CleanUpDraw(pDC);
 }
 
+BOOL CEllipse::HitTest(CPoint pt)
+{
+    // First check if anywhere near the object.
+    CRect rct = GetEnclosingRect();
+    if (!rct.PtInRect(pt))
+        return FALSE;
+
+    // Now check for actual image hit.
+    CRect rctEllipse = m_rctExtent;
+    rctEllipse.NormalizeRect();
+    double dTol = double(GetHitTolerance(m_nLineWidth));
+    double dx = pt.x - (rctEllipse.left + rctEllipse.right) / 2.0;
+    double dy = pt.y - (rctEllipse.top + rctEllipse.bottom) / 2.0;
+    double a = rctEllipse.Width() / 2.0;
+    double b = rctEllipse.Height() / 2.0;
+
+    double ao = a + dTol;
+    double bo = b + dTol;
+    if ((dx * dx) / (ao * ao) + (dy * dy) / (bo * bo) > 1.0)
+        return FALSE;
+    if (m_crFill != noColor)
+        return TRUE;
+    double ai = a - dTol;
+    double bi = b - dTol;
+    if (ai <= 0.0 || bi <= 0.0)
+        return TRUE;
+    return (dx * dx) / (ai * ai) + (dy * dy) / (bi * bi) >= 1.0;
+}
+
 #ifndef     GPLAY
 OwnerPtr<CSelection> CEllipse::CreateSelectProxy(CBrdEditView& pView)
 {
@@ -421,7 +487,10 @@ void CPolyObj::ComputeExtent()
 {
     m_rctExtent.SetRectEmpty();
     if (m_Pnts.empty())
+    {
+        NoteChanged();
         return;
+    }
     int xmin = INT_MAX, xmax = INT_MIN, ymin = INT_MAX, ymax = INT_MIN;
     for (size_t i = size_t(0) ; i < m_Pnts.size() ; ++i)
     {
@@ -431,6 +500,7 @@ void CPolyObj::ComputeExtent()
         ymax = CB::max(ymax, m_Pnts[i].y);
     }
     m_rctExtent.SetRect(xmin, ymin, xmax, ymax);
+    NoteChanged();
 }
 
 CRect CPolyObj::GetEnclosingRect() const
@@ -444,11 +514,21 @@ BOOL CPolyObj::HitTest(CPoint pt)
 {
     // First check if anywhere near the object.
     CRect rct = GetEnclosingRect();
-    if (!rct.PtInRect(pt))
+    if (!rct.PtInRect(pt) || m_Pnts.empty())
         return FALSE;
 
     // Now check for actual image hit.
-    return BitBlockHitTest(pt);
+    if (m_crFill != noColor && IsPtInPolygon(pt, m_Pnts))
+        return TRUE;
+    int nTol = GetHitTolerance(m_nLineWidth);
+    for (size_t i = size_t(1) ; i < m_Pnts.size() ; ++i)
+    {
+        if (IsNearSegment(pt, m_Pnts[i - size_t(1)], m_Pnts[i], nTol))
+            return TRUE;
+    }
+    // Polygons have an implied closing edge.
+    return m_crFill != noColor &&
+        IsNearSegment(pt, m_Pnts.back(), m_Pnts.front(), nTol);
 }
 
 #ifndef     GPLAY
@@ -537,10 +617,7 @@ void CPolyObj::Serialize(CArchive& ar)
 void CLine::Draw(CDC& pDC, TileScale)
 {
     CPen pen;
-    if (c_bHitTestDraw)
-        pen.CreateStockObject(BLACK_PEN);
-    else
-        pen.CreatePen(PS_SOLID, m_nLineWidth, m_crLine);
+    pen.CreatePen(PS_SOLID, m_nLineWidth, m_crLine);
     CPen* pPrvPen = pDC.SelectObject(&pen);
 
     pDC.MoveTo(m_ptBeg);
@@ -561,6 +638,7 @@ void CLine::SetLine(int xBeg, int yBeg, int xEnd, int yEnd)
     m_rctExtent.top = CB::min(yBeg, yEnd) - nWidth;
     m_rctExtent.right = CB::max(xBeg, xEnd) + nWidth;
     m_rctExtent.bottom = CB::max(yBeg, yEnd) +nWidth;
+    NoteChanged();
 }
 
 CRect CLine::GetEnclosingRect() const
@@ -578,7 +656,7 @@ BOOL CLine::HitTest(CPoint pt)
         return FALSE;
 
     // Now check for actual image hit.
-    return BitBlockHitTest(pt);
+    return IsNearSegment(pt, m_ptBeg, m_ptEnd, GetHitTolerance(m_nLineWidth));
 }
 
 #ifndef     GPLAY
@@ -643,6 +721,12 @@ BOOL CLine::Compare(const CDrawObj& pObj) const
         return FALSE;
     return TRUE;
 }
+
+uint64_t CLine::GetStateHash() const
+{
+    uint64_t nHash = CombineStateHash(GetType(), m_ptBeg);
+    return CombineStateHash(nHash, m_ptEnd);
+}
 #endif      // GPLAY
 
 //DFM19991214
@@ -745,6 +829,7 @@ void CBitmapImage::SetBitmap(int x, int y, HBITMAP hBMap,
     m_rctExtent.top = y;
     m_rctExtent.right += bmInfo.bmWidth;
     m_rctExtent.bottom += bmInfo.bmHeight;
+    NoteChanged();
 }
 
 BOOL CBitmapImage::HitTest(CPoint pt)
@@ -765,10 +850,13 @@ void CBitmapImage::SynchronizeExtentRect(CSize sizeWorld, CSize sizeView)
     m_bitmap.GetObject(sizeof(bmInfo), &bmInfo);
     // Might compensate the extend rect for objects with natural
     // sizes in scalings smaller that full scale.
+    CRect rctPrev = m_rctExtent;
     m_rctExtent.right = m_rctExtent.left;
     m_rctExtent.bottom = m_rctExtent.top;
     m_rctExtent.right += (sizeWorld.cx * bmInfo.bmWidth) / sizeView.cx;
     m_rctExtent.bottom += (sizeWorld.cy * bmInfo.bmHeight) / sizeView.cy;
+    if (m_rctExtent != rctPrev)         // Called on every draw
+        NoteChanged();
 }
 
 #ifndef     GPLAY
@@ -776,7 +864,7 @@ void CBitmapImage::ForceIntoZone(const CRect& pRctZone)
 {
     CPoint pntOffset;
     if (IsExtentOutOfZone(pRctZone, pntOffset))
-        m_rctExtent += pntOffset;
+        OffsetObject(pntOffset);
 }
 #endif
 
@@ -792,6 +880,7 @@ OwnerPtr<CSelection> CBitmapImage::CreateSelectProxy(CBrdEditView& pView)
 void CBitmapImage::OffsetObject(CPoint offset)
 {
     m_rctExtent += offset;
+    NoteChanged();
 }
 
 CDrawObj::OwnerPtr CBitmapImage::Clone() const
@@ -871,12 +960,20 @@ void CTileImage::SetTile(int x, int y, TileID tid)
     m_rctExtent.top = m_rctExtent.bottom = y;
     m_rctExtent.right += tile.GetWidth();
     m_rctExtent.bottom += tile.GetHeight();
+    NoteChanged();
 }
 
 BOOL CTileImage::HitTest(CPoint pt)
 {
     CRect rct = GetEnclosingRect();
-    return rct.PtInRect(pt);
+    if (!rct.PtInRect(pt))
+        return FALSE;
+
+    // Clicks on transparent pixels fall through to what's below.
+    ASSERT(m_pTMgr != NULL);
+    CTile tile;
+    m_pTMgr->GetTile(m_tid, &tile);
+    return tile.IsOpaquePixel(pt - m_rctExtent.TopLeft());
 }
 
 #ifndef     GPLAY
@@ -884,7 +981,7 @@ void CTileImage::ForceIntoZone(const CRect& pRctZone)
 {
     CPoint pntOffset;
     if (IsExtentOutOfZone(pRctZone, pntOffset))
-        m_rctExtent += pntOffset;
+        OffsetObject(pntOffset);
 }
 #endif
 
@@ -898,6 +995,7 @@ OwnerPtr<CSelection> CTileImage::CreateSelectProxy(CBrdEditView& pView)
 void CTileImage::OffsetObject(CPoint offset)
 {
     m_rctExtent += offset;
+    NoteChanged();
 }
 
 CDrawObj::OwnerPtr CTileImage::Clone() const
@@ -980,6 +1078,7 @@ BOOL CText::SetFont(FontID fid)
     m_rctExtent.right = m_rctExtent.left + sizeTxt.cx;
     m_rctExtent.bottom = m_rctExtent.top + sizeTxt.cy;
     g_gt.mDC1.SelectObject(pPrvFont);
+    NoteChanged();
 
     return TRUE;
 }
@@ -996,13 +1095,14 @@ void CText::ForceIntoZone(const CRect& pRctZone)
 {
     CPoint pntOffset;
     if (IsExtentOutOfZone(pRctZone, pntOffset))
-        m_rctExtent += pntOffset;
+        OffsetObject(pntOffset);
 }
 #endif
 
 void CText::OffsetObject(CPoint offset)
 {
     m_rctExtent += offset;
+    NoteChanged();
 }
 
 #ifndef GPLAY
@@ -1083,6 +1183,16 @@ static void DrawObjTile(CDC& pDC, CPoint pnt, CTileManager* pTMgr, TileID tid,
         pDC.RestoreDC(-1);
 }
 
+// Hit tests are done at full scale. Clicks on transparent pixels
+// fall through to what's below.
+static BOOL HitTestObjTile(CPoint pnt, CTileManager* pTMgr, TileID tid)
+{
+    ASSERT(pTMgr != NULL);
+    CTile tile;
+    pTMgr->GetTile(tid, &tile);
+    return tile.IsOpaquePixel(pnt);
+}
+
 //////////////////////////////////////////////////////////////////
 // Class CPieceObj
 
@@ -1091,6 +1201,15 @@ void CPieceObj::Draw(CDC& pDC, TileScale eScale)
     ASSERT(m_pDoc != NULL);
     CTileManager* pTMgr = m_pDoc->GetTileManager();
     ASSERT(pTMgr != NULL);
+
+    TileID tid = GetCurrentTileID();
+    CPoint pnt = m_rctExtent.TopLeft();
+    DrawObjTile(pDC, pnt, pTMgr, tid, eScale);
+}
+
+TileID CPieceObj::GetCurrentTileID() const
+{
+    ASSERT(m_pDoc != NULL);
     CPieceTable* pPTbl = m_pDoc->GetPieceTable();
     ASSERT(pPTbl != NULL);
 
@@ -1102,9 +1221,7 @@ void CPieceObj::Draw(CDC& pDC, TileScale eScale)
     else
         tid = pPTbl->GetActiveTileID(m_pid, TRUE);  // Show rotations
     ASSERT(tid != nullTid);
-
-    CPoint pnt = m_rctExtent.TopLeft();
-    DrawObjTile(pDC, pnt, pTMgr, tid, eScale);
+    return tid;
 }
 
 void CPieceObj::SetOwnerMask(DWORD dwMask)
@@ -1144,6 +1261,7 @@ void CPieceObj::SetPiece(CRect& rct, PieceID pid)
     m_pid = pid;
     m_rctExtent = rct;
     ResyncExtentRect();
+    NoteChanged();
 }
 
 void CPieceObj::ResyncExtentRect()
@@ -1168,13 +1286,21 @@ void CPieceObj::ResyncExtentRect()
     CPoint pnt = m_rctExtent.CenterPoint();
     pnt.x -= tile.GetWidth() / 2;
     pnt.y -= tile.GetHeight() / 2;
-    m_rctExtent = CRect(pnt, tile.GetSize());
+    CRect rct(pnt, tile.GetSize());
+    if (rct != m_rctExtent)
+    {
+        m_rctExtent = rct;
+        NoteChanged();
+    }
 }
 
 BOOL CPieceObj::HitTest(CPoint pt)
 {
     CRect rct = GetEnclosingRect();
-    return rct.PtInRect(pt);
+    if (!rct.PtInRect(pt))
+        return FALSE;
+    return HitTestObjTile(pt - m_rctExtent.TopLeft(),
+        m_pDoc->GetTileManager(), GetCurrentTileID());
 }
 
 OwnerPtr<CSelection> CPieceObj::CreateSelectProxy(CPlayBoardView& pView)
@@ -1206,6 +1332,12 @@ BOOL CPieceObj::Compare(const CDrawObj& pObj) const
     return TRUE;
 }
 
+uint64_t CPieceObj::GetStateHash() const
+{
+    uint64_t nHash = CombineStateHash(GetType(), value_preserving_cast<uint64_t>(m_pid));
+    return CombineStateHash(nHash, m_rctExtent);
+}
+
 void CPieceObj::Serialize(CArchive& ar)
 {
     CDrawObj::Serialize(ar);
@@ -1239,6 +1371,7 @@ void CMarkObj::SetMark(CRect& rct, MarkID mid)
 {
     m_mid = mid;
     m_rctExtent = rct;
+    NoteChanged();
 }
 
 TileID CMarkObj::GetCurrentTileID()
@@ -1279,13 +1412,21 @@ void CMarkObj::ResyncExtentRect()
     CPoint pnt = m_rctExtent.CenterPoint();
     pnt.x -= tile.GetWidth() / 2;
     pnt.y -= tile.GetHeight() / 2;
-    m_rctExtent = CRect(pnt, tile.GetSize());
+    CRect rct(pnt, tile.GetSize());
+    if (rct != m_rctExtent)
+    {
+        m_rctExtent = rct;
+        NoteChanged();
+    }
 }
 
 BOOL CMarkObj::HitTest(CPoint pt)
 {
     CRect rct = GetEnclosingRect();
-    return rct.PtInRect(pt);
+    if (!rct.PtInRect(pt))
+        return FALSE;
+    return HitTestObjTile(pt - m_rctExtent.TopLeft(),
+        m_pDoc->GetTileManager(), GetCurrentTileID());
 }
 
 OwnerPtr<CSelection> CMarkObj::CreateSelectProxy(CPlayBoardView& pView)
@@ -1323,6 +1464,14 @@ BOOL CMarkObj::Compare(const CDrawObj& pObj) const
     return TRUE;
 }
 
+uint64_t CMarkObj::GetStateHash() const
+{
+    uint64_t nHash = CombineStateHash(GetType(), value_preserving_cast<uint64_t>(m_mid));
+    nHash = CombineStateHash(nHash, reinterpret_cast<const uint32_t&>(m_dwObjectID));
+    nHash = CombineStateHash(nHash, value_preserving_cast<uint64_t>(m_nFacingDegCW));
+    return CombineStateHash(nHash, m_rctExtent);
+}
+
 void CMarkObj::Serialize(CArchive& ar)
 {
     CDrawObj::Serialize(ar);
@@ -1382,6 +1531,12 @@ BOOL CLineObj::Compare(const CDrawObj& pObj) const
     return TRUE;
 }
 
+uint64_t CLineObj::GetStateHash() const
+{
+    return CombineStateHash(CLine::GetStateHash(),
+        reinterpret_cast<const uint32_t&>(m_dwObjectID));
+}
+
 void CLineObj::Serialize(CArchive& ar)
 {
     CLine::Serialize(ar);
@@ -1413,14 +1568,17 @@ void CDrawList::Draw(CDC& pDC, const CRect& pDrawRct, TileScale eScale,
     BOOL bApplyVisibility /* = TRUE */, BOOL bDrawPass2Objects /* = FALSE */,
     BOOL bHideUnlocked /* = FALSE */, BOOL bDrawLockedFirst /* = FALSE */)
 {
+    std::vector<CDrawObj*> tblObjs;
+    GetObjectsNearRect(pDrawRct, tblObjs);
+
     // We might need to draw locked objects first so they
     // show up under other object which are unlocked. This is
     // only valid in a non-pass 2 call.
     if (!bDrawPass2Objects && bDrawLockedFirst)
     {
-        for (iterator pos = begin(); pos != end(); ++pos)
+        for (size_t i = 0; i < tblObjs.size(); ++i)
         {
-            CDrawObj& pDObj = **pos;
+            CDrawObj& pDObj = *tblObjs[i];
 
             // Check if the object should be drawn in this scaling
             if (bApplyVisibility && ((pDObj.GetDObjFlags() & eScale) == 0))
@@ -1437,9 +1595,9 @@ void CDrawList::Draw(CDC& pDC, const CRect& pDrawRct, TileScale eScale,
         }
     }
 
-    for (iterator pos = begin(); pos != end(); ++pos)
+    for (size_t i = 0; i < tblObjs.size(); ++i)
     {
-        CDrawObj& pDObj = **pos;
+        CDrawObj& pDObj = *tblObjs[i];
 
         // Check if the object should be drawn in this scaling
         if (bApplyVisibility && ((pDObj.GetDObjFlags() & eScale) == 0))
@@ -1465,9 +1623,12 @@ void CDrawList::Draw(CDC& pDC, const CRect& pDrawRct, TileScale eScale,
 CDrawObj* CDrawList::HitTest(CPoint pt, TileScale eScale,
     BOOL bApplyVisibility /* = TRUE */)
 {
-    for (reverse_iterator pos = rbegin(); pos != rend(); ++pos)
+    std::vector<CDrawObj*> tblObjs;
+    GetObjectsNearRect(CRect(pt, CSize(1, 1)), tblObjs);
+
+    for (size_t i = tblObjs.size(); i-- > 0; )
     {
-        CDrawObj& pDObj = **pos;
+        CDrawObj& pDObj = *tblObjs[i];
 
         if (bApplyVisibility && ((pDObj.GetDObjFlags() & eScale) == 0))
             continue;                   // Doesn't qualify
@@ -1481,9 +1642,12 @@ CDrawObj* CDrawList::HitTest(CPoint pt, TileScale eScale,
 void CDrawList::DrillDownHitTest(CPoint point, std::vector<CB::not_null<CDrawObj*>>& selLst,
     TileScale eScale, BOOL bApplyVisibility /* = TRUE */)
 {
-    for (reverse_iterator pos = rbegin(); pos != rend(); ++pos)
+    std::vector<CDrawObj*> tblObjs;
+    GetObjectsNearRect(CRect(point, CSize(1, 1)), tblObjs);
+
+    for (size_t i = tblObjs.size(); i-- > 0; )
     {
-        CDrawObj& pDObj = **pos;
+        CDrawObj& pDObj = *tblObjs[i];
 
         if (bApplyVisibility && ((pDObj.GetDObjFlags() & eScale) == 0))
             continue;                   // Doesn't qualify
@@ -1492,17 +1656,191 @@ void CDrawList::DrillDownHitTest(CPoint point, std::vector<CB::not_null<CDrawObj
     }
 }
 
+// Lists too small to benefit from the grid return every object.
+void CDrawList::GetObjectsNearRect(const CRect& rct, std::vector<CDrawObj*>& tblObjs) const
+{
+    tblObjs.clear();
+    if (size() >= size_t(gridMinObjects))
+    {
+        if (!m_bGridValid)
+            BuildGrid();
+        CRect rctCells = GetGridCells(rct);
+        if (rctCells.IsRectEmpty())
+            return;
+
+        std::vector<std::pair<uint64_t, CDrawObj*>> tblFound;
+        for (int nRow = rctCells.top; nRow < rctCells.bottom; nRow++)
+        {
+            for (int nCol = rctCells.left; nCol < rctCells.right; nCol++)
+            {
+                const std::vector<CDrawObj*>& cell =
+                    m_tblGridCells[value_preserving_cast<size_t>(nRow * m_nGridCols + nCol)];
+                for (size_t i = 0; i < cell.size(); i++)
+                    tblFound.emplace_back(m_mapGridEntry.at(cell[i]).m_nOrder, cell[i]);
+            }
+        }
+        // Objects spanning cells show up more than once.
+        std::sort(tblFound.begin(), tblFound.end());
+        tblFound.erase(std::unique(tblFound.begin(), tblFound.end()), tblFound.end());
+
+        tblObjs.reserve(tblFound.size());
+        for (size_t i = 0; i < tblFound.size(); i++)
+            tblObjs.push_back(tblFound[i].second);
+        return;
+    }
+    tblObjs.reserve(size());
+    for (const_iterator pos = begin(); pos != end(); ++pos)
+        tblObjs.push_back(const_cast<CDrawObj*>(&**pos));
+}
+
+void CDrawList::BuildGrid() const
+{
+    m_mapGridEntry.clear();
+    m_tblGridCells.clear();
+    m_rctGridBounds.SetRectEmpty();
+
+    for (const_iterator pos = begin(); pos != end(); ++pos)
+        m_rctGridBounds |= (*pos)->GetEnclosingRect();  // Empty rects are ignored
+    // Leave room for objects to spread out before they have to
+    // share the edge cells.
+    m_rctGridBounds.InflateRect(m_rctGridBounds.Width() / 2,
+        m_rctGridBounds.Height() / 2);
+
+    // Use larger cells if the board is too big for the cell limit.
+    m_nGridCellSize = gridCellSize;
+    for (;;)
+    {
+        m_nGridCols = CB::max((m_rctGridBounds.Width() + m_nGridCellSize - 1) / m_nGridCellSize, 1);
+        m_nGridRows = CB::max((m_rctGridBounds.Height() + m_nGridCellSize - 1) / m_nGridCellSize, 1);
+        if (m_nGridCols * m_nGridRows <= gridMaxCells)
+            break;
+        m_nGridCellSize *= 2;
+    }
+    m_tblGridCells.resize(value_preserving_cast<size_t>(m_nGridCols * m_nGridRows));
+
+    m_mapGridEntry.reserve(size());
+    uint64_t nOrder = 0;
+    for (const_iterator pos = begin(); pos != end(); ++pos)
+    {
+        CDrawObj& pDObj = const_cast<CDrawObj&>(**pos);
+        GridEntry& entry = m_mapGridEntry[&pDObj];
+        entry.m_nOrder = nOrder += gridOrderGap;
+        entry.m_rctCells = GetGridCells(pDObj.GetEnclosingRect());
+        AddToGridCells(pDObj, entry.m_rctCells);
+    }
+    m_bGridValid = TRUE;
+}
+
+void CDrawList::ResetGrid()
+{
+    m_mapGridEntry.clear();
+    m_tblGridCells.clear();
+    m_bGridValid = FALSE;
+}
+
+// Spreads the draw order keys out again when an insertion finds
+// no room between its neighbors.
+void CDrawList::RenumberGrid()
+{
+    uint64_t nOrder = 0;
+    for (iterator pos = begin(); pos != end(); ++pos)
+        m_mapGridEntry.at(&**pos).m_nOrder = nOrder += gridOrderGap;
+}
+
+// Returns the range of cells (right and bottom exclusive) that
+// the rect covers. Parts of the rect beyond the grid's bounds are
+// mapped to the edge cells. Empty rects cover no cells.
+CRect CDrawList::GetGridCells(const CRect& rct) const
+{
+    if (rct.IsRectEmpty())
+        return CRect(0, 0, 0, 0);
+    int nCol0 = CB::max(0, CB::min((rct.left - m_rctGridBounds.left) / m_nGridCellSize, m_nGridCols - 1));
+    int nCol1 = CB::max(0, CB::min((rct.right - 1 - m_rctGridBounds.left) / m_nGridCellSize, m_nGridCols - 1));
+    int nRow0 = CB::max(0, CB::min((rct.top - m_rctGridBounds.top) / m_nGridCellSize, m_nGridRows - 1));
+    int nRow1 = CB::max(0, CB::min((rct.bottom - 1 - m_rctGridBounds.top) / m_nGridCellSize, m_nGridRows - 1));
+    return CRect(nCol0, nRow0, nCol1 + 1, nRow1 + 1);
+}
+
+void CDrawList::AddToGridCells(CDrawObj& pDObj, const CRect& rctCells) const
+{
+    for (int nRow = rctCells.top; nRow < rctCells.bottom; nRow++)
+    {
+        for (int nCol = rctCells.left; nCol < rctCells.right; nCol++)
+            m_tblGridCells[value_preserving_cast<size_t>(nRow * m_nGridCols + nCol)].push_back(&pDObj);
+    }
+}
+
+void CDrawList::RemoveFromGridCells(const CDrawObj& pDObj, const CRect& rctCells)
+{
+    for (int nRow = rctCells.top; nRow < rctCells.bottom; nRow++)
+    {
+        for (int nCol = rctCells.left; nCol < rctCells.right; nCol++)
+        {
+            std::vector<CDrawObj*>& cell =
+                m_tblGridCells[value_preserving_cast<size_t>(nRow * m_nGridCols + nCol)];
+            // Cell order doesn't matter.
+            std::vector<CDrawObj*>::iterator it = std::find(cell.begin(), cell.end(), &pDObj);
+            ASSERT(it != cell.end());
+            *it = cell.back();
+            cell.pop_back();
+        }
+    }
+}
+
+// The object at pos has just been inserted into the list.
+void CDrawList::AddToGrid(iterator pos)
+{
+    CDrawObj& pDObj = **pos;
+    uint64_t nPrev = pos == begin() ? uint64_t(0) :
+        m_mapGridEntry.at(&**std::prev(pos)).m_nOrder;
+    iterator posNext = std::next(pos);
+    uint64_t nNext = posNext == end() ? std::numeric_limits<uint64_t>::max() :
+        m_mapGridEntry.at(&**posNext).m_nOrder;
+
+    GridEntry& entry = m_mapGridEntry[&pDObj];
+    entry.m_rctCells = GetGridCells(pDObj.GetEnclosingRect());
+    AddToGridCells(pDObj, entry.m_rctCells);
+    if (nNext - nPrev < uint64_t(2))
+        RenumberGrid();
+    else if (posNext == end() && nNext - nPrev > gridOrderGap)
+        entry.m_nOrder = nPrev + gridOrderGap;
+    else
+        entry.m_nOrder = nPrev + (nNext - nPrev) / uint64_t(2);
+}
+
+void CDrawList::RemoveFromGrid(const CDrawObj& pDObj)
+{
+    auto it = m_mapGridEntry.find(&pDObj);
+    ASSERT(it != m_mapGridEntry.end());
+    RemoveFromGridCells(pDObj, it->second.m_rctCells);
+    m_mapGridEntry.erase(it);
+}
+
+void CDrawList::UpdateGrid(const CDrawObj& pDObj)
+{
+    GridEntry& entry = m_mapGridEntry.at(&pDObj);
+    CRect rctCells = GetGridCells(pDObj.GetEnclosingRect());
+    if (rctCells != entry.m_rctCells)
+    {
+        RemoveFromGridCells(pDObj, entry.m_rctCells);
+        entry.m_rctCells = rctCells;
+        AddToGridCells(const_cast<CDrawObj&>(pDObj), rctCells);
+    }
+}
+
 void CDrawList::ArrangeObjectListInDrawOrder(std::vector<CB::not_null<CDrawObj*>>& pLst)
 {
     // Loop through the drawing list looking for objects that are
     // selected. Add them to a local list. When done, purge the caller's
     // list and transfer temp list to the callers list.
     std::vector<CB::not_null<CDrawObj*>> tmpLst;
+    tmpLst.reserve(pLst.size());
+    std::unordered_set<const CDrawObj*> setSel(pLst.begin(), pLst.end());
 
     for (iterator pos = begin() ; pos != end() ; ++pos)
     {
         CDrawObj& pDObj = **pos;
-        if (std::find(pLst.begin(), pLst.end(), &pDObj) != pLst.end())
+        if (setSel.find(&pDObj) != setSel.end())
             tmpLst.push_back(&pDObj);
     }
     pLst = std::move(tmpLst);
@@ -1514,11 +1852,13 @@ void CDrawList::ArrangeObjectListInVisualOrder(std::vector<CB::not_null<CDrawObj
     // selected. Add them to a local list. When done, purge the caller's
     // list and transfer temp list to the callers list.
     std::vector<CB::not_null<CDrawObj*>> tmpLst;
+    tmpLst.reserve(pLst.size());
+    std::unordered_set<const CDrawObj*> setSel(pLst.begin(), pLst.end());
 
     for (reverse_iterator pos = rbegin() ; pos != rend() ; ++pos)
     {
         CDrawObj& pDObj = **pos;
-        if (std::find(pLst.begin(), pLst.end(), &pDObj) != pLst.end())
+        if (setSel.find(&pDObj) != setSel.end())
             tmpLst.push_back(&pDObj);
     }
     pLst = std::move(tmpLst);
@@ -1533,20 +1873,16 @@ void CDrawList::ArrangePieceTableInDrawOrder(std::vector<PieceID>& pTbl) const
     // list and transfer temp list to the callers list.
     std::vector<PieceID> tmpTbl;
     tmpTbl.reserve(pTbl.size());
+    std::unordered_set<PieceID> setSel(pTbl.begin(), pTbl.end());
 
     for (const_iterator pos = begin(); pos != end(); ++pos)
     {
         const CDrawObj& pDObj = **pos;
         if (pDObj.GetType() == CDrawObj::drawPieceObj)
         {
-            for (size_t i = 0; i < pTbl.size(); i++)
-            {
-                if (pTbl.at(i)== static_cast<const CPieceObj&>(pDObj).m_pid)
-                {
-                    tmpTbl.push_back(static_cast<const CPieceObj&>(pDObj).m_pid);
-                    break;
-                }
-            }
+            PieceID pid = static_cast<const CPieceObj&>(pDObj).m_pid;
+            if (setSel.find(pid) != setSel.end())
+                tmpTbl.push_back(pid);
         }
     }
     ASSERT(tmpTbl.size() == pTbl.size());
@@ -1560,20 +1896,16 @@ void CDrawList::ArrangePieceTableInVisualOrder(std::vector<PieceID>& pTbl) const
     // list and transfer temp list to the callers list.
     std::vector<PieceID> tmpTbl;
     tmpTbl.reserve(pTbl.size());
+    std::unordered_set<PieceID> setSel(pTbl.begin(), pTbl.end());
 
     for (const_reverse_iterator pos = rbegin(); pos != rend(); ++pos)
     {
         const CDrawObj& pDObj = **pos;
         if (pDObj.GetType() == CDrawObj::drawPieceObj)
         {
-            for (size_t i = 0; i < pTbl.size(); i++)
-            {
-                if (pTbl.at(i)== static_cast<const CPieceObj&>(pDObj).m_pid)
-                {
-                    tmpTbl.push_back(static_cast<const CPieceObj&>(pDObj).m_pid);
-                    break;
-                }
-            }
+            PieceID pid = static_cast<const CPieceObj&>(pDObj).m_pid;
+            if (setSel.find(pid) != setSel.end())
+                tmpTbl.push_back(pid);
         }
     }
     ASSERT(tmpTbl.size() == pTbl.size());
@@ -1587,18 +1919,16 @@ void CDrawList::ArrangeObjectPtrTableInDrawOrder(std::vector<CB::not_null<CDrawO
     // list and transfer temp list to the callers list.
     std::vector<CB::not_null<CDrawObj*>> tmpTbl;
     tmpTbl.reserve(pTbl.size());
+    std::unordered_map<const CDrawObj*, size_t> mapSel;
+    for (size_t i = 0; i < pTbl.size(); i++)
+        mapSel.emplace(pTbl.at(i), i);
 
     for (const_iterator pos = begin(); pos != end(); ++pos)
     {
         const CDrawObj& pDObj = **pos;
-        for (size_t i = 0; i < pTbl.size(); i++)
-        {
-            if (pTbl.at(i) == &pDObj)
-            {
-                tmpTbl.push_back(pTbl.at(i));
-                break;
-            }
-        }
+        auto sel = mapSel.find(&pDObj);
+        if (sel != mapSel.end())
+            tmpTbl.push_back(pTbl.at(sel->second));
     }
     ASSERT(tmpTbl.size() == pTbl.size());
     pTbl.clear();
@@ -1612,18 +1942,16 @@ void CDrawList::ArrangeObjectPtrTableInVisualOrder(std::vector<CB::not_null<CDra
     // list and transfer temp list to the callers list.
     std::vector<CB::not_null<CDrawObj*>> tmpTbl;
     tmpTbl.reserve(pTbl.size());
+    std::unordered_map<const CDrawObj*, size_t> mapSel;
+    for (size_t i = 0; i < pTbl.size(); i++)
+        mapSel.emplace(pTbl.at(i), i);
 
     for (const_reverse_iterator pos = rbegin(); pos != rend(); ++pos)
     {
         const CDrawObj& pDObj = **pos;
-        for (size_t i = 0; i < pTbl.size(); i++)
-        {
-            if (pTbl.at(i) == &pDObj)
-            {
-                tmpTbl.push_back(pTbl.at(i));
-                break;
-            }
-        }
+        auto sel = mapSel.find(&pDObj);
+        if (sel != mapSel.end())
+            tmpTbl.push_back(pTbl.at(sel->second));
     }
     ASSERT(tmpTbl.size() == pTbl.size());
     pTbl.clear();
@@ -1634,12 +1962,125 @@ void CDrawList::ArrangeObjectPtrTableInVisualOrder(std::vector<CB::not_null<CDra
 
 CDrawList::const_iterator CDrawList::Find(const CDrawObj& drawObj) const
 {
-    return std::find_if(begin(), end(), [&drawObj](const CDrawObj::OwnerPtr& p) { return p == &drawObj; });
+    auto it = m_mapObjPos.find(&drawObj);
+    if (it == m_mapObjPos.end())
+        return end();
+    return it->second;
 }
 
 CDrawList::iterator CDrawList::Find(const CDrawObj& drawObj)
 {
-    return std::find_if(begin(), end(), [&drawObj](const CDrawObj::OwnerPtr& p) { return p == &drawObj; });
+    auto it = m_mapObjPos.find(&drawObj);
+    if (it == m_mapObjPos.end())
+        return end();
+    return it->second;
+}
+
+// All insertions into the list must call this with the position of
+// the new object.
+void CDrawList::IndexObject(iterator pos)
+{
+    CDrawObj& pDObj = **pos;
+    ASSERT(m_mapObjPos.find(&pDObj) == m_mapObjPos.end());
+    ASSERT(pDObj.m_pDrawList == NULL);
+    m_mapObjPos[&pDObj] = pos;
+    pDObj.m_pDrawList = this;
+    if (m_bGridValid)
+        AddToGrid(pos);
+#ifdef GPLAY
+    switch (pDObj.GetType())
+    {
+        case CDrawObj::drawPieceObj:
+            if (m_pLocDoc != NULL)
+                m_pLocDoc->NotePieceAdded(static_cast<CPieceObj&>(pDObj).m_pid, *this);
+            // Fall through
+        case CDrawObj::drawMarkObj:
+        case CDrawObj::drawLineObj:
+            // Other object types don't have an ObjectID
+            ASSERT(m_mapObjID.find(pDObj.GetObjectID()) == m_mapObjID.end());
+            m_mapObjID[pDObj.GetObjectID()] = pos;
+            break;
+        default:
+            break;
+    }
+#endif
+}
+
+void CDrawList::UnindexObject(CDrawObj& pDObj)
+{
+    m_mapObjPos.erase(&pDObj);
+    pDObj.m_pDrawList = NULL;
+    if (m_bGridValid)
+        RemoveFromGrid(pDObj);
+#ifdef GPLAY
+    auto it = m_mapObjID.find(pDObj.GetObjectID());
+    if (it != m_mapObjID.end() && *it->second == &pDObj)
+        m_mapObjID.erase(it);
+    if (m_pLocDoc != NULL && pDObj.GetType() == CDrawObj::drawPieceObj)
+        m_pLocDoc->NotePieceRemoved(static_cast<CPieceObj&>(pDObj).m_pid, *this);
+#endif
+}
+
+void CDrawList::OnObjectChanged(const CDrawObj& pDObj)
+{
+    ASSERT(Find(pDObj) != end());
+    InvalidateCachedState();
+    if (m_bGridValid)
+        UpdateGrid(pDObj);
+}
+
+// Removes the entry and destroys the object it holds.
+void CDrawList::EraseObject(iterator pos)
+{
+    UnindexObject(**pos);
+    erase(pos);
+    InvalidateCachedState();
+}
+
+CDrawList& CDrawList::operator=(CDrawList&& other)
+{
+    if (this != &other)
+    {
+#ifdef GPLAY
+        // Lists holding the document's pieces are never moved.
+        ASSERT(m_pLocDoc == NULL && other.m_pLocDoc == NULL);
+#endif
+        BASE::operator=(std::move(other));
+        m_mapObjPos = std::move(other.m_mapObjPos);
+#ifdef GPLAY
+        m_mapObjID = std::move(other.m_mapObjID);
+        m_pSharedClone = std::move(other.m_pSharedClone);
+        m_nStateHash = other.m_nStateHash;
+        m_nStateHashPow = other.m_nStateHashPow;
+        m_bStateHashValid = other.m_bStateHashValid;
+#endif
+        ResetGrid();
+        other.clear();
+        // The objects must report their changes to their new list.
+        for (iterator pos = begin(); pos != end(); ++pos)
+            (*pos)->m_pDrawList = this;
+    }
+    return *this;
+}
+
+void CDrawList::clear()
+{
+    InvalidateCachedState();
+    ResetGrid();
+    m_mapObjPos.clear();
+#ifdef GPLAY
+    m_mapObjID.clear();
+    if (m_pLocDoc != NULL)
+    {
+        for (iterator pos = begin(); pos != end(); ++pos)
+        {
+            const CDrawObj& pDObj = **pos;
+            if (pDObj.GetType() == CDrawObj::drawPieceObj)
+                m_pLocDoc->NotePieceRemoved(static_cast<const CPieceObj&>(pDObj).m_pid, *this);
+        }
+    }
+#endif
+    BASE::clear();
 }
 
 // NOTE:  RemoveObject* do not erase
@@ -1652,6 +2093,35 @@ void CDrawList::RemoveObjectsInList(const std::vector<CB::not_null<CDrawObj*>>&
     }
 }
 
+void CDrawList::AddToBack(CDrawObj::OwnerPtr pDrawObj)
+{
+#ifdef GPLAY
+    m_pSharedClone.reset();
+    if (m_bStateHashValid)
+    {
+        // New object becomes index 0, so shift the others up.
+        m_nStateHash = pDrawObj->GetStateHash() + m_nStateHash * stateHashMult;
+        m_nStateHashPow *= stateHashMult;
+    }
+#endif
+    push_front(std::move(pDrawObj));
+    IndexObject(begin());
+}
+
+void CDrawList::AddToFront(CDrawObj::OwnerPtr pDrawObj)
+{
+#ifdef GPLAY
+    m_pSharedClone.reset();
+    if (m_bStateHashValid)
+    {
+        m_nStateHash += pDrawObj->GetStateHash() * m_nStateHashPow;
+        m_nStateHashPow *= stateHashMult;
+    }
+#endif
+    push_back(std::move(pDrawObj));
+    IndexObject(std::prev(end()));
+}
+
 void CDrawList::RemoveObject(const CDrawObj& pDrawObj)
 {
     iterator pos = Find(pDrawObj);
@@ -1665,9 +2135,11 @@ void CDrawList::RemoveObject(const CDrawObj& pDrawObj)
         /* rref required.  Otherwise, compiler selects
             get_underlying(const propagate_const&), which
             prevents calling release() */
+        UnindexObject(**pos);
         CB::propagate_const<std::unique_ptr<CDrawObj>>&& rref = CB::get_underlying(std::move(*pos));
         CB::get_underlying(rref).release();
         erase(pos);
+        InvalidateCachedState();
     }
 }
 
@@ -1699,13 +2171,29 @@ CPieceObj* CDrawList::FindPieceID(PieceID pid)
 
 CDrawObj* CDrawList::FindObjectID(ObjectID oid)
 {
-    for (iterator pos = begin(); pos != end(); ++pos)
-    {
-        CDrawObj& pDObj = **pos;
-        if (pDObj.GetObjectID() == oid)
-             return &pDObj;
-    }
-    return NULL;
+    auto it = m_mapObjID.find(oid);
+    if (it == m_mapObjID.end())
+        return NULL;
+    CDrawObj& pDObj = **it->second;
+    ASSERT(pDObj.GetObjectID() == oid);
+    return &pDObj;
+}
+
+// Z order is the object's index in drawing order (back to front).
+size_t CDrawList::GetObjectZOrder(const CDrawObj& pObj) const
+{
+    const_iterator pos = Find(pObj);
+    if (pos == end())
+        return Invalid_v<size_t>;
+    return value_preserving_cast<size_t>(std::distance(begin(), pos));
+}
+
+void CDrawList::InsertAtZOrder(CDrawObj::OwnerPtr pDrawObj, size_t nZOrder)
+{
+    iterator pos = begin();
+    std::advance(pos, CB::min(nZOrder, size()));
+    IndexObject(insert(pos, std::move(pDrawObj)));
+    InvalidateCachedState();
 }
 
 void CDrawList::GetPieceObjectPtrList(std::vector<CB::not_null<CPieceObj*>>& pLst)
@@ -1783,7 +2271,7 @@ BOOL CDrawList::PurgeMissingTileIDs(CTileManager* pTMgr)
         {
             if (!pTMgr->IsTileIDValid(static_cast<CTileImage&>(pDObj).m_tid))
             {
-                erase(pos2);
+                EraseObject(pos2);
                 bPurged = TRUE;
             }
         }
@@ -1837,7 +2325,7 @@ CDrawList CDrawList::Clone(CGamDoc* pDoc) const
     for (const_iterator pos = begin(); pos != end(); ++pos)
     {
         const CDrawObj& pDObj = **pos;
-        pLst.push_back(pDObj.Clone(pDoc));
+        pLst.AddToFront(pDObj.Clone(pDoc));
     }
     return pLst;
 }
@@ -1848,7 +2336,7 @@ void CDrawList::Restore(CGamDoc* pDoc, const CDrawList& pLst)
     for (const_iterator pos = pLst.begin(); pos != pLst.end(); ++pos)
     {
         const CDrawObj& pDObj = **pos;
-        push_back(pDObj.Clone(pDoc));    // Clone it back
+        AddToFront(pDObj.Clone(pDoc));   // Clone it back
     }
 }
 
@@ -1880,17 +2368,68 @@ void CDrawList::AppendWithOffset(const CDrawList& pSourceLst, CPoint pntOffet)
         const CDrawObj& pDObj = **pos;
         CDrawObj::OwnerPtr pObjClone = pDObj.Clone();
         pObjClone->OffsetObject(pntOffet);
-        push_back(std::move(pObjClone));
+        AddToFront(std::move(pObjClone));
+    }
+}
+
+std::shared_ptr<CDrawList> CDrawList::GetSharedClone(CGamDoc* pDoc) const
+{
+    if (!m_pSharedClone)
+        m_pSharedClone = std::make_shared<CDrawList>(Clone(pDoc));
+    return m_pSharedClone;
+}
+
+void CDrawList::RestoreShared(CGamDoc* pDoc, const std::shared_ptr<CDrawList>& pLst)
+{
+    // If the list hasn't changed since the clone was taken
+    // there's nothing to do.
+    if (m_pSharedClone == pLst)
+        return;
+    Restore(pDoc, *pLst);
+    m_pSharedClone = pLst;              // Contents match the clone again
+    if (pLst->m_bStateHashValid)
+    {
+        m_nStateHash = pLst->m_nStateHash;
+        m_nStateHashPow = pLst->m_nStateHashPow;
+        m_bStateHashValid = TRUE;
+    }
+}
+
+void CDrawList::TrackPieceLocations(CGamDoc* pDoc)
+{
+    ASSERT(m_pLocDoc == NULL || m_pLocDoc == pDoc);
+    m_pLocDoc = pDoc;
+    for (iterator pos = begin(); pos != end(); ++pos)
+    {
+        const CDrawObj& pDObj = **pos;
+        if (pDObj.GetType() == CDrawObj::drawPieceObj)
+            m_pLocDoc->NotePieceAdded(static_cast<const CPieceObj&>(pDObj).m_pid, *this);
     }
 }
 
+uint64_t CDrawList::GetStateHash() const
+{
+    if (!m_bStateHashValid)
+    {
+        m_nStateHash = 0;
+        m_nStateHashPow = 1;
+        for (const_iterator pos = begin(); pos != end(); ++pos)
+        {
+            m_nStateHash += (*pos)->GetStateHash() * m_nStateHashPow;
+            m_nStateHashPow *= stateHashMult;
+        }
+        m_bStateHashValid = TRUE;
+    }
+    return m_nStateHash;
+}
+
 #endif // GPLAY
 
 void CDrawList::Serialize(CArchive& ar)
 {
     if (ar.IsStoring())
     {
-        ar << value_preserving_cast<WORD>(size());
+        ar << value_preserving_cast<DWORD>(size());
 #ifdef _DEBUG
         size_t nObjects = size();
 #endif
@@ -1909,9 +2448,18 @@ void CDrawList::Serialize(CArchive& ar)
     else
     {
         clear();
-        WORD wCount;
-        ar >> wCount;
-        for (WORD i = 0; i < wCount; ++i)
+        size_t nCount;
+        if (CGamDoc::GetLoadingVersion() >= NumVersion(4, 0))  // V4.00
+        {
+            DWORD dwCount;
+            ar >> dwCount; nCount = value_preserving_cast<size_t>(dwCount);
+        }
+        else
+        {
+            WORD wCount;
+            ar >> wCount; nCount = value_preserving_cast<size_t>(wCount);
+        }
+        for (size_t i = 0; i < nCount; ++i)
         {
             OwnerOrNullPtr<CDrawObj> pDObj;
             WORD wType;
@@ -1955,7 +2503,7 @@ void CDrawList::Serialize(CArchive& ar)
                     AfxThrowArchiveException(CArchiveException::badClass);
             }
             pDObj->Serialize(ar);
-            push_back(std::move(pDObj));
+            AddToFront(std::move(pDObj));
         }
     }
 }
@@ -26,6 +26,7 @@
 #define _DRAWOBJ_H
 
 #include <list>
+#include <unordered_map>
 
 #ifndef  _FONT_H
 #include "Font.h"
@@ -40,6 +41,7 @@
 #endif
 
 class CSelection;
+class CDrawList;
 
 #ifdef GPLAY
 class CPlayBoardView;
@@ -91,16 +93,16 @@ public:
         drawUnknown = 0xFF };
 
     void SetScaleVisibility(int fTileScale)
-        { m_dwDObjFlags = ChangeBits(m_dwDObjFlags, fTileScale, dobjFlgLayerMask); }
+        { m_dwDObjFlags = ChangeBits(m_dwDObjFlags, fTileScale, dobjFlgLayerMask); NoteChanged(); }
     int GetScaleVisibility() const { return (int)(GetDObjFlags() & dobjFlgLayerMask); }
     DWORD GetDObjFlags() const { return m_dwDObjFlags; }
-    void  SetDObjFlags(DWORD dwFlags) { m_dwDObjFlags |= dwFlags; }
-    void  ClearDObjFlags(DWORD dwFlags) { m_dwDObjFlags &= ~dwFlags; }
+    void  SetDObjFlags(DWORD dwFlags) { m_dwDObjFlags |= dwFlags; NoteChanged(); }
+    void  ClearDObjFlags(DWORD dwFlags) { m_dwDObjFlags &= ~dwFlags; NoteChanged(); }
     void  ModifyDObjFlags(DWORD dwFlags, BOOL bState)
         { if (bState) SetDObjFlags(dwFlags); else ClearDObjFlags(dwFlags); }
 
     virtual CRect& GetRect() /* override */ { return m_rctExtent; }
-    virtual void SetRect(const CRect& rct) /* override */ { m_rctExtent = rct; }
+    virtual void SetRect(const CRect& rct) /* override */ { m_rctExtent = rct; NoteChanged(); }
 
     virtual CRect GetEnclosingRect() const /* override */ { return m_rctExtent; }
     virtual BOOL HitTest(CPoint pt) /* override */ { return FALSE; }
@@ -138,6 +140,8 @@ public:
 #ifdef GPLAY
     virtual OwnerPtr Clone(CGamDoc* pDoc) const /* override */ { AfxThrowInvalidArgException(); }
     virtual BOOL Compare(const CDrawObj& pObj) const /* override */ { AfxThrowInvalidArgException(); }
+    // Hash of the state checked by Compare()
+    virtual uint64_t GetStateHash() const /* override */;
 #endif
     // ------- //
     virtual void Serialize(CArchive& ar) /* override */;
@@ -145,10 +149,12 @@ public:
 // Implementation - methods
 protected:
     BOOL IsExtentOutOfZone(const CRect& pRctZone, CPoint& pntOffset) const;
+    // Every change to an object's extent or state must call this
+    // so the list holding the object can update what it caches.
+    void NoteChanged();
     // ------- //
     virtual void SetUpDraw(CDC& pDC, CPen& pPen, CBrush& pBrush) const /* override */;
     virtual void CleanUpDraw(CDC& pDC) const /* override */;
-    virtual BOOL BitBlockHitTest(CPoint pt) /* override */;
     virtual UINT GetLineWidth() const /* override */ { return 0; }
     virtual COLORREF GetLineColor() const /* override */ { return noColor; }
     virtual COLORREF GetFillColor() const /* override */ { return noColor; }
@@ -159,12 +165,13 @@ protected:
 protected:
     DWORD   m_dwDObjFlags;      // OR'ed values from enum DrawObjFlags
     CRect   m_rctExtent;
+    CDrawList* m_pDrawList = NULL;  // List holding the object (NOSAVE)
+    friend class CDrawList;
 
     // Class variables (may be used to during draw of various offspring
     // class objects)
     static CPen*    c_pPrvPen;
     static CBrush*  c_pPrvBrush;
-    static BOOL     c_bHitTestDraw;// TRUE=Draw() is being called for hit test.
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -181,9 +188,10 @@ protected:
 
     Currently, the only CBPlay-created objects are markers.
     However, the subtype field permits 13 more additional types
-    (subtype 0xF is used up by GameElement's
-    GAMEELEM_MARKERID_FLAG, subtype 0x2 is markers, and
-    subtype 0x0 is used up as the invalid subtype code).
+    (subtype 0xF is used up by the GameElement marker tag of
+    files before version 4.00, subtype 0x2 is markers, and
+    subtype 0x0 is used up by pieces, whose 28 bit PieceID is
+    split across id and serial, and as the invalid subtype code).
     Possible future objects:  lines showing moves (subtype 0x3
     already reserved), textual notes, multimedia clips, ... */
 class alignas(uint32_t) ObjectID
@@ -222,6 +230,18 @@ inline CArchive& operator>>(CArchive& ar, ObjectID& oid)
 {
     return ar >> reinterpret_cast<uint32_t&>(oid);
 }
+
+namespace std
+{
+    template<>
+    struct hash<ObjectID>
+    {
+        size_t operator()(const ObjectID& oid) const
+        {
+            return hash<uint32_t>()(reinterpret_cast<const uint32_t&>(oid));
+        }
+    };
+}
 #endif
 
 ///////////////////////////////////////////////////////////////////////
@@ -242,12 +262,12 @@ public:
     virtual CRect GetEnclosingRect() const override;
     virtual enum CDrawObjType GetType() const override { return drawRect; }
 
-    void SetRect(RECT* rect) { m_rctExtent = rect; }
+    void SetRect(RECT* rect) { m_rctExtent = rect; NoteChanged(); }
 
-    virtual BOOL SetForeColor(COLORREF cr) override { m_crLine = cr; return TRUE; }
-    virtual BOOL SetBackColor(COLORREF cr) override { m_crFill = cr; return TRUE; }
+    virtual BOOL SetForeColor(COLORREF cr) override { m_crLine = cr; NoteChanged(); return TRUE; }
+    virtual BOOL SetBackColor(COLORREF cr) override { m_crFill = cr; NoteChanged(); return TRUE; }
     virtual BOOL SetLineWidth(UINT nLineWidth) override
-        { m_nLineWidth = nLineWidth; return TRUE; }
+        { m_nLineWidth = nLineWidth; NoteChanged(); return TRUE; }
 
 // Operations
 public:
@@ -288,6 +308,7 @@ public:
 // Operations
 public:
     virtual void Draw(CDC& pDC, TileScale eScale) override;
+    virtual BOOL HitTest(CPoint pt) override;
 #ifndef GPLAY
     virtual ::OwnerPtr<CSelection> CreateSelectProxy(CBrdEditView& pView) override;
 #endif
@@ -321,9 +342,9 @@ public:
     virtual CRect GetEnclosingRect() const override;
     virtual enum CDrawObjType GetType() const override { return drawLine; }
 
-    virtual BOOL SetForeColor(COLORREF cr) override { m_crLine = cr; return TRUE; }
+    virtual BOOL SetForeColor(COLORREF cr) override { m_crLine = cr; NoteChanged(); return TRUE; }
     virtual BOOL SetLineWidth(UINT nLineWidth) override
-        { m_nLineWidth = nLineWidth; return TRUE; }
+        { m_nLineWidth = nLineWidth; NoteChanged(); return TRUE; }
 
 // Operations
 public:
@@ -345,6 +366,7 @@ public:
 #ifdef GPLAY
     virtual OwnerPtr Clone(CGamDoc* pDoc) const override;
     virtual BOOL Compare(const CDrawObj& pObj) const override;
+    virtual uint64_t GetStateHash() const override;
 #endif
     virtual void Serialize(CArchive& ar) override;
 
@@ -372,10 +394,10 @@ public:
     virtual CRect GetEnclosingRect() const override;
     virtual enum CDrawObjType GetType() const override { return drawPolygon; }
 
-    virtual BOOL SetForeColor(COLORREF cr) override { m_crLine = cr; return TRUE; }
-    virtual BOOL SetBackColor(COLORREF cr) override { m_crFill = cr; return TRUE; }
+    virtual BOOL SetForeColor(COLORREF cr) override { m_crLine = cr; NoteChanged(); return TRUE; }
+    virtual BOOL SetBackColor(COLORREF cr) override { m_crFill = cr; NoteChanged(); return TRUE; }
     virtual BOOL SetLineWidth(UINT nLineWidth) override
-        { m_nLineWidth = nLineWidth; return TRUE; }
+        { m_nLineWidth = nLineWidth; NoteChanged(); return TRUE; }
 
 // Operations
 public:
@@ -431,7 +453,7 @@ public:
         COLORREF crText = RGB(255,255,255));
     virtual enum CDrawObjType GetType() const override { return drawText; }
 
-    virtual BOOL SetForeColor(COLORREF cr) override { m_crText = cr; return TRUE; }
+    virtual BOOL SetForeColor(COLORREF cr) override { m_crText = cr; NoteChanged(); return TRUE; }
     virtual BOOL SetFont(FontID fid) override;
 
 // Operations
@@ -565,6 +587,7 @@ public:
 // Operations
 public:
     void ResyncExtentRect();
+    TileID GetCurrentTileID() const;
 
     virtual void Draw(CDC& pDC, TileScale eScale) override;
     // Support required by selection processing.
@@ -573,6 +596,7 @@ public:
     // ------- //
     virtual OwnerPtr Clone(CGamDoc* pDoc) const override;
     virtual BOOL Compare(const CDrawObj& pObj) const override;
+    virtual uint64_t GetStateHash() const override;
     virtual void Serialize(CArchive& ar) override;
 };
 
@@ -594,6 +618,7 @@ public:
     // ------ //
     virtual OwnerPtr Clone(CGamDoc* pDoc) const override;
     virtual BOOL Compare(const CDrawObj& pObj) const override;
+    virtual uint64_t GetStateHash() const override;
     virtual void Serialize(CArchive& ar) override;
 };
 
@@ -614,8 +639,8 @@ public:
 
     void SetMark(CRect& rct, MarkID mid);
 
-    void SetFacing(int nFacingDegCW) { m_nFacingDegCW = nFacingDegCW; }
-    int  GetFacing() { return m_nFacingDegCW; }
+    void SetFacing(int nFacingDegCW) { m_nFacingDegCW = nFacingDegCW; NoteChanged(); }
+    int  GetFacing() const { return m_nFacingDegCW; }
 
     void    SetObjectID(ObjectID dwID) { m_dwObjectID = dwID; }
     virtual ObjectID GetObjectID() const override { return m_dwObjectID; }
@@ -638,6 +663,7 @@ public:
     // ------- //
     virtual OwnerPtr Clone(CGamDoc* pDoc) const override;
     virtual BOOL Compare(const CDrawObj& pObj) const override;
+    virtual uint64_t GetStateHash() const override;
     virtual void Serialize(CArchive& ar) override;
 };
 
@@ -657,6 +683,7 @@ class CDrawList : private std::list<CDrawObj::OwnerPtr>
 {
     using BASE = std::list<CDrawObj::OwnerPtr>;
     friend class CGamDoc;
+    friend class CDrawObj;
 public:
     /* N.B.:  as in CB 3.1, begin/end are in terms of underlying
                 list, but Front/Back are in terms of display,
@@ -664,23 +691,23 @@ public:
                 begin/end/front/back */
     using BASE::iterator;
     using BASE::begin;
-    using BASE::clear;
     using BASE::end;
 
     CDrawList() = default;
     CDrawList(const CDrawList&) = delete;
     CDrawList& operator=(const CDrawList&) = delete;
-    CDrawList(CDrawList&&) = default;
-    CDrawList& operator=(CDrawList&&) = default;
-    ~CDrawList() = default;
+    CDrawList(CDrawList&& other) { *this = std::move(other); }
+    CDrawList& operator=(CDrawList&& other);
+    ~CDrawList() { clear(); }
 public:
     const_iterator Find(const CDrawObj& drawObj) const;
     iterator Find(const CDrawObj& drawObj);
     // NOTE:  See WARNING: above
     void RemoveObject(const CDrawObj& pDrawObj);
     void RemoveObjectsInList(const std::vector<CB::not_null<CDrawObj*>>& pLst);
-    void AddToBack(CDrawObj::OwnerPtr pDrawObj) { push_front(std::move(pDrawObj)); }
-    void AddToFront(CDrawObj::OwnerPtr pDrawObj) { push_back(std::move(pDrawObj)); }
+    void AddToBack(CDrawObj::OwnerPtr pDrawObj);
+    void AddToFront(CDrawObj::OwnerPtr pDrawObj);
+    void clear();
     CDrawObj& Front() { return *back(); }
     CDrawObj& Back() { return *front(); }
     void Draw(CDC& pDC, const CRect& pDrawRct, TileScale eScale,
@@ -704,6 +731,8 @@ public:
     CPieceObj* FindPieceID(PieceID pid);
     CDrawObj* FindObjectID(ObjectID oid);
     BOOL HasObject(const CDrawObj& pObj) const { return Find(pObj) != end(); }
+    size_t GetObjectZOrder(const CDrawObj& pObj) const;
+    void InsertAtZOrder(CDrawObj::OwnerPtr pDrawObj, size_t nZOrder);
     BOOL HasMarker() const;
     void GetPieceObjectPtrList(std::vector<CB::not_null<CPieceObj*>>& pLst);
     void GetPieceIDTable(std::vector<PieceID>& pTbl) const;
@@ -715,6 +744,18 @@ public:
     void Restore(CGamDoc* pDoc, const CDrawList& pLst);
     BOOL Compare(const CDrawList& pLst) const;
     void AppendWithOffset(const CDrawList& pSourceLst, CPoint pntOffet);
+    // ------- //
+    // Saved game states share one clone of the list until the list
+    // changes. The state hash and object grid are also cached. Objects
+    // in the list report their own changes (see CDrawObj::NoteChanged)
+    // so callers needn't do anything.
+    std::shared_ptr<CDrawList> GetSharedClone(CGamDoc* pDoc) const;
+    void RestoreShared(CGamDoc* pDoc, const std::shared_ptr<CDrawList>& pLst);
+    uint64_t GetStateHash() const;
+    // The piece lists of the document's own boards report the pieces
+    // they gain and lose to the document's piece location index.
+    // Saved game state lists don't.
+    void TrackPieceLocations(CGamDoc* pDoc);
 #else
     BOOL PurgeMissingTileIDs(CTileManager* pTMgr);
     BOOL IsTileInUse(TileID tid) const;
@@ -723,6 +764,68 @@ public:
 #endif
     // -------- //
     void Serialize(CArchive& ar);
+
+protected:
+    // Every object's list position is hashed by its address so
+    // Find() and RemoveObject() don't walk the list. Pieces, markers
+    // and line objects are also hashed by ObjectID. (NOSAVE)
+    std::unordered_map<const CDrawObj*, iterator> m_mapObjPos;
+#ifdef GPLAY
+    std::unordered_map<ObjectID, iterator> m_mapObjID;
+#endif
+    void IndexObject(iterator pos);
+    void UnindexObject(CDrawObj& pDObj);
+    void EraseObject(iterator pos);
+    // Called by objects in the list when they change.
+    void OnObjectChanged(const CDrawObj& pDObj);
+    // Returns the objects that may intersect the rect in draw order.
+    void GetObjectsNearRect(const CRect& rct, std::vector<CDrawObj*>& tblObjs) const;
+
+#ifdef GPLAY
+    CGamDoc* m_pLocDoc = NULL;          // Doc whose piece index is kept (NOSAVE)
+    mutable std::shared_ptr<CDrawList> m_pSharedClone; // Clone held by saved states (NOSAVE)
+    // Order dependent hash of the objects in begin() to end() order:
+    // the sum of object hash * (stateHashMult ^ index). (NOSAVE)
+    mutable uint64_t m_nStateHash = 0;
+    mutable uint64_t m_nStateHashPow = 1;  // stateHashMult ^ size()
+    mutable BOOL m_bStateHashValid = FALSE;
+
+    void InvalidateCachedState()
+        { m_pSharedClone.reset(); m_bStateHashValid = FALSE; }
+#else
+    void InvalidateCachedState() {}    // Lists aren't shared by the designer
+#endif
+
+    // Uniform grid over the object extents. Each cell holds the
+    // objects that overlap it. Larger lists use it to limit draws
+    // and hit tests to the objects near the area of interest. It's
+    // built on first use after the list is loaded or cleared and is
+    // then updated in place as objects are added, removed and
+    // changed. Objects beyond the grid's bounds are held by the
+    // edge cells. (NOSAVE)
+    enum { gridCellSize = 256, gridMaxCells = 64 * 1024, gridMinObjects = 64 };
+    struct GridEntry
+    {
+        uint64_t m_nOrder;              // Increases in draw order
+        CRect    m_rctCells;            // Cells the object is in (may be empty)
+    };
+    mutable std::unordered_map<const CDrawObj*, GridEntry> m_mapGridEntry;
+    mutable std::vector<std::vector<CDrawObj*>> m_tblGridCells;
+    mutable CRect m_rctGridBounds;
+    mutable int m_nGridCellSize = gridCellSize;
+    mutable int m_nGridCols = 0;
+    mutable int m_nGridRows = 0;
+    mutable BOOL m_bGridValid = FALSE;
+
+    void BuildGrid() const;
+    void ResetGrid();
+    void RenumberGrid();
+    CRect GetGridCells(const CRect& rct) const;
+    void AddToGridCells(CDrawObj& pDObj, const CRect& rctCells) const;
+    void RemoveFromGridCells(const CDrawObj& pDObj, const CRect& rctCells);
+    void AddToGrid(iterator pos);
+    void RemoveFromGrid(const CDrawObj& pDObj);
+    void UpdateGrid(const CDrawObj& pDObj);
 };
 
 #endif
@@ -64,6 +64,24 @@ int NumInWordArray(CWordArray& array, int val);
 WORD GetTimeBasedRandomNumber(BOOL bZeroAllowed = TRUE);
 WORD GetStringBasedRandomNumber(LPCSTR str);
 DWORD GetStringHash(LPCSTR str);
+// Mixes a value into a 64 bit hash. Used to build the game state hashes.
+inline uint64_t CombineStateHash(uint64_t nHash, uint64_t nVal)
+{
+    uint64_t z = nHash ^ (nVal + 0x9E3779B97F4A7C15 + (nHash << 6) + (nHash >> 2));
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;      // splitmix64 finalizer
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+inline uint64_t CombineStateHash(uint64_t nHash, CPoint pnt)
+{
+    nHash = CombineStateHash(nHash, static_cast<uint32_t>(pnt.x));
+    return CombineStateHash(nHash, static_cast<uint32_t>(pnt.y));
+}
+inline uint64_t CombineStateHash(uint64_t nHash, const CRect& rct)
+{
+    nHash = CombineStateHash(nHash, rct.TopLeft());
+    return CombineStateHash(nHash, rct.BottomRight());
+}
 CWnd* GetWindowFromPoint(CPoint point);
 void PushRectOntoScreen(RECT& rct);
 int Sin10K(int angle);
@@ -32,6 +32,7 @@
 #include    "ResTbl.h"
 #include    "CDib.h"
 #include    "GdiTools.h"
+#include    "TransBlt.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -144,6 +145,71 @@ void Draw25PctPatBorder(CWnd* pWnd, CDC* pDC, CRect rct, int nThick)
     pDC->SelectObject(pPrvBrush);
 }
 
+/////////////////////////////////////////////////////////////////
+// Loads tblRects with the rectangles (in pDC's logical coordinates)
+// of the area a paint DC needs drawn. Separate invalidations, such as
+// the old and new spots of a moved piece, each get their own
+// rectangle so the space between them isn't redrawn. The clip box is
+// returned by itself if the area is a single rectangle, is made of
+// so many pieces or covers so much of the box that drawing the box
+// is cheaper, or pDC isn't painting a window. The table is empty if
+// there's nothing to draw.
+
+void GetPaintRects(CDC* pDC, std::vector<CRect>& tblRects)
+{
+    const size_t maxPaintRects = 16;
+
+    tblRects.clear();
+    CRect rctClip;
+    if (pDC->GetClipBox(&rctClip) == NULLREGION || rctClip.IsRectEmpty())
+        return;
+    tblRects.push_back(rctClip);
+    if (pDC->IsPrinting())
+        return;
+
+    // The system region is the part of the window being painted. It's
+    // in screen coordinates.
+    CRgn rgn;
+    rgn.CreateRectRgn(0, 0, 0, 0);
+    if (::GetRandomRgn(pDC->m_hDC, (HRGN)rgn.m_hObject, SYSRGN) != 1)
+        return;
+    CPoint pntOrg;
+    if (!::GetDCOrgEx(pDC->m_hDC, &pntOrg))
+        return;
+    rgn.OffsetRgn(-pntOrg);
+
+    int nBytes = rgn.GetRegionData(NULL, 0);
+    if (nBytes <= 0)
+        return;
+    std::vector<BYTE> tblData(value_preserving_cast<size_t>(nBytes));
+    RGNDATA* pData = reinterpret_cast<RGNDATA*>(tblData.data());
+    if (rgn.GetRegionData(pData, nBytes) == 0)
+        return;
+    size_t nRects = pData->rdh.nCount;
+    if (nRects <= size_t(1) || nRects > maxPaintRects)
+        return;
+
+    const RECT* pRects = reinterpret_cast<const RECT*>(pData->Buffer);
+    std::vector<CRect> tblParts;
+    tblParts.reserve(nRects);
+    int64_t nArea = 0;
+    for (size_t i = size_t(0); i < nRects; ++i)
+    {
+        CRect rct(pRects[i]);
+        pDC->DPtoLP(&rct);
+        rct.NormalizeRect();
+        rct &= rctClip;
+        if (rct.IsRectEmpty())
+            continue;
+        nArea += int64_t(rct.Width()) * rct.Height();
+        tblParts.push_back(rct);
+    }
+    if (tblParts.empty() ||
+            nArea * 4 >= int64_t(rctClip.Width()) * rctClip.Height() * 3)
+        return;
+    tblRects.swap(tblParts);
+}
+
 /////////////////////////////////////////////////////////////////
 // Creates a 16 bit DIB section that is 16 bits per pixel
 // in 5-6-5 format.
@@ -756,42 +822,10 @@ void TransBlt(CDC *pDC, CPoint pntDst, CBitmap* pBMap, COLORREF crTrans)
     pBMap->GetObject(sizeof(BITMAP), &bmapSrc);
     ::GetObject(hBMapDest, sizeof(BITMAP), &bmapDest);
     ASSERT(bmapSrc.bmBits != NULL && bmapDest.bmBits != NULL);
-    CSize size(bmapSrc.bmWidth, bmapSrc.bmHeight);
-
-    LPBYTE pSrc = (LPBYTE)bmapSrc.bmBits;
-    LPBYTE pDest = (LPBYTE)bmapDest.bmBits;
-
-    WORD cr16Trans = RGB565(crTrans);
 
     CPoint pntOrg = pDC->GetViewportOrg();
-    int xDst = pntOrg.x + pntDst.x;
-    int yDst = pntOrg.y + pntDst.y;
-    int xDstBase = xDst;
-    int ySrc = 0;
-
-    int nBytesPerScanLineSrc = WIDTHBYTES(bmapSrc.bmWidth * 16);
-    int nBytesPerScanLineDest = WIDTHBYTES(bmapDest.bmWidth * 16);
-    for (int nScanLine = 0; nScanLine < size.cy; nScanLine++)
-    {
-        xDst = xDstBase;
-        WORD* pPxlSrc = (WORD*)(pSrc + (bmapSrc.bmHeight - ySrc - 1) * nBytesPerScanLineSrc);
-        WORD* pPxlDest =(WORD*)(pDest + (bmapDest.bmHeight - yDst - 1) *
-            nBytesPerScanLineDest + 2 * xDst);       // (two bytes per pixel)
-        for (int nPxl = 0; nPxl < size.cx; nPxl++)
-        {
-            if (*pPxlSrc != cr16Trans &&
-                xDst >= 0 && xDst < bmapDest.bmWidth &&
-                yDst >= 0 && yDst < bmapDest.bmHeight)
-            {
-                *pPxlDest = *pPxlSrc;
-            }
-            pPxlDest++;
-            pPxlSrc++;
-            xDst++;
-        }
-        yDst++;
-        ySrc++;
-    }
+    TransBlt16(bmapDest, pntOrg.x + pntDst.x, pntOrg.y + pntDst.y,
+        bmapSrc, 0, 0, bmapSrc.bmWidth, bmapSrc.bmHeight, RGB565(crTrans));
 }
 
 /////////////////////////////////////////////////////////////////
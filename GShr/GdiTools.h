@@ -25,6 +25,8 @@
 #ifndef _GDITOOLS_H
 #define _GDITOOLS_H
 
+#include    <vector>
+
 #ifndef     _FONT_H
 #include    "font.h"
 #endif
@@ -190,6 +192,7 @@ void MergeBitmap(CBitmap *pbmDst, CBitmap *pbmSrc, CPoint pntDst,
 void BitmapBlt(CDC *pDC, CPoint pntDst, CBitmap* pBMap);
 void TransBlt(CDC *pDC, CPoint pntDst, CBitmap* pBMap, COLORREF crTrans);
 void Draw25PctPatBorder(CWnd* pWnd, CDC* pDC, CRect rct, int nThick);
+void GetPaintRects(CDC* pDC, std::vector<CRect>& tblRects);
 void CreateColorBitmap(CBitmap *pBMap, CSize size, COLORREF cr);
 
 CPalette* GetAppPalette();
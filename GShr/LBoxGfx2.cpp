@@ -253,7 +253,7 @@ void CGrafixListBox2::DoToolTipHitProcessing(CPoint point)
     }
 
     CRect rctTool;
-    int nItemCode = OnGetHitItemCodeAtPoint(point, rctTool);
+    int64_t nItemCode = OnGetHitItemCodeAtPoint(point, rctTool);
 
     if (nItemCode != m_nCurItemCode)
     {
@@ -98,8 +98,8 @@ public:
 
     // For tool tip processing
     virtual BOOL OnIsToolTipsEnabled() /* override */ { return FALSE; }
-    virtual int  OnGetHitItemCodeAtPoint(CPoint point, CRect& rct) /* override */ { return -1; }
-    virtual void OnGetTipTextForItemCode(int nItemCode, CString& strTip, CString& strTitle) /* override */ { }
+    virtual int64_t OnGetHitItemCodeAtPoint(CPoint point, CRect& rct) /* override */ { return -1; }
+    virtual void OnGetTipTextForItemCode(int64_t nItemCode, CString& strTip, CString& strTitle) /* override */ { }
 
 // Implementation
 protected:
@@ -110,7 +110,7 @@ protected:
 
     // Tool tip support
     CToolTipCtrl m_toolTip;
-    int     m_nCurItemCode;
+    int64_t m_nCurItemCode;
 
     // Drag and scroll support vars
     BOOL    m_bAllowDrag;
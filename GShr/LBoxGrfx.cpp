@@ -205,7 +205,7 @@ void CGrafixListBox::DoToolTipHitProcessing(CPoint point)
     }
 
     CRect rctTool;
-    int nItemCode = OnGetHitItemCodeAtPoint(point, rctTool);
+    int64_t nItemCode = OnGetHitItemCodeAtPoint(point, rctTool);
 
     if (nItemCode != m_nCurItemCode) // && nItemCode >= 0)
     {
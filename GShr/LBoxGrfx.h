@@ -145,8 +145,8 @@ public:
 
     // For tool tip processing
     virtual BOOL OnIsToolTipsEnabled() /* override */ { return FALSE; }
-    virtual int  OnGetHitItemCodeAtPoint(CPoint point, CRect& rct) /* override */ { return -1; }
-    virtual void OnGetTipTextForItemCode(int nItemCode, CString& strTip, CString& strTitle) /* override */ { }
+    virtual int64_t OnGetHitItemCodeAtPoint(CPoint point, CRect& rct) /* override */ { return -1; }
+    virtual void OnGetTipTextForItemCode(int64_t nItemCode, CString& strTip, CString& strTitle) /* override */ { }
 
     /* N.B.:  Conceptually, this declaration belongs to
         CTileBaseListBox, but it doesn't hurt much to declare it
@@ -159,7 +159,7 @@ protected:
     // Tool tip support
     CToolTipCtrl m_toolMsgTip;      // Tooltip for notifications
     CToolTipCtrl m_toolTip;         // Tooltip of tile text popups
-    int     m_nCurItemCode;         // current active tip item code
+    int64_t m_nCurItemCode;         // current active tip item code
 
     // Drag and scroll support vars
     static DragInfo di;
@@ -386,7 +386,7 @@ protected:
 
     /* N.B.:  Only CTileBaseListBox requires providing this, but
         it doesn't hurt much to provide it in general.  */
-    virtual int OnGetItemDebugIDCode(size_t nItem) override { return value_preserving_cast<int>(static_cast<WORD>(MapIndexToItem(nItem))); }
+    virtual int OnGetItemDebugIDCode(size_t nItem) override { return value_preserving_cast<int>(MapIndexToItem(nItem)); }
 
 private:
     const std::vector<T>* m_pItemMap;         // Maps index to item
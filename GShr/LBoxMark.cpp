@@ -77,7 +77,7 @@ BOOL CMarkListBox::OnIsToolTipsEnabled()
 #endif
 }
 
-int  CMarkListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
+int64_t CMarkListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
 {
     BOOL bOutsideClient;
     UINT nIndex = ItemFromPoint(point, bOutsideClient);
@@ -92,13 +92,13 @@ int  CMarkListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
 
     GetTileRectsForItem(value_preserving_cast<int>(nIndex), tid, nullTid, rct, rct);
 
-    return rct.PtInRect(point) ? value_preserving_cast<int>(static_cast<WORD>(mid)) : -1;
+    return rct.PtInRect(point) ? static_cast<int64_t>(static_cast<uint32_t>(mid)) : -1;
 }
 
-void CMarkListBox::OnGetTipTextForItemCode(int nItemCode,
+void CMarkListBox::OnGetTipTextForItemCode(int64_t nItemCode,
     CString& strTip, CString& strTitle)
 {
-    MarkID mid = static_cast<MarkID>(nItemCode);
+    MarkID mid = static_cast<MarkID>(static_cast<uint32_t>(nItemCode));
     strTip = m_pDoc->GetGameElementString(MakeMarkerElement(mid));
 }
 
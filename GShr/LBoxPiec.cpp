@@ -84,7 +84,7 @@ BOOL CPieceListBox::OnIsToolTipsEnabled()
 #endif
 }
 
-int  CPieceListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
+int64_t CPieceListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
 {
     BOOL bOutsideClient;
     UINT nIndex = ItemFromPoint(point, bOutsideClient);
@@ -94,7 +94,7 @@ int  CPieceListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
     ASSERT(m_pDoc != NULL);
 
     PieceID nPid = MapIndexToItem(value_preserving_cast<size_t>(nIndex));
-    uint32_t flags = 0;
+    int64_t flags = 0;
 
     TileID tidLeft = m_pPMgr->GetPiece(nPid).GetFrontTID();
     ASSERT(tidLeft != nullTid);            // Should exist
@@ -109,22 +109,21 @@ int  CPieceListBox::OnGetHitItemCodeAtPoint(CPoint point, CRect& rct)
     else if (!rctRight.IsRectEmpty() && rctRight.PtInRect(point))
     {
         rct = rctRight;
-        static_assert(sizeof(nPid) <= 2, "flags and PieceID bits overlap");
-        flags |= 0x10000;             // Set flag bit indicating right side rect
+        flags |= int64_t(1) << 32;     // Set flag bit indicating right side rect
     }
     else
         return -1;
 
-    return value_preserving_cast<int>(static_cast<WORD>(nPid) | flags);
+    return static_cast<int64_t>(static_cast<uint32_t>(nPid)) | flags;
 }
 
-void CPieceListBox::OnGetTipTextForItemCode(int nItemCode,
+void CPieceListBox::OnGetTipTextForItemCode(int64_t nItemCode,
     CString& strTip, CString& strTitle)
 {
     if (nItemCode < 0)
         return;
-    PieceID pid = static_cast<PieceID>(nItemCode & 0xFFFF);
-    BOOL bRightRect = (nItemCode & 0x10000) != 0;
+    PieceID pid = static_cast<PieceID>(static_cast<uint32_t>(nItemCode));
+    BOOL bRightRect = ((nItemCode >> 32) & 1) != 0;
     GameElement elem = MakePieceElement(pid, bRightRect ? 1 : 0);
     strTip = m_pDoc->GetGameElementString(elem);
 }
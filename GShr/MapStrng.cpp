@@ -76,7 +76,7 @@ void CGameElementStringMap::Serialize(CArchive& ar)
             GameElement elem;
             CString str;
             GetNextAssoc(pos, elem, str);
-            ar << (DWORD)elem;
+            SerializeGameElement(ar, elem);
             ar << str;
         }
     }
@@ -87,12 +87,40 @@ void CGameElementStringMap::Serialize(CArchive& ar)
         ar >> dwCount;
         while (dwCount--)
         {
-            DWORD dwElem;
-            ar >> dwElem;
+            GameElement elem;
+            SerializeGameElement(ar, elem);
             CString str;
             ar >> str;
-            SetAt((GameElement)dwElem, str);
+            SetAt(elem, str);
         }
     }
 }
 
+///////////////////////////////////////////////////////////////////////
+
+void SerializeGameElement(CArchive& ar, GameElement& elem)
+{
+    if (ar.IsStoring())
+        ar << (ULONGLONG)elem;
+    else if (IsLoadingWideIDs())
+    {
+        ULONGLONG qwTmp;
+        ar >> qwTmp; elem = (GameElement)qwTmp;
+    }
+    else
+    {
+        // Old layout: a marker has its top 4 bits set, an
+        // ObjectID has some other top 15 bits set, otherwise
+        // it's a 16 bit piece ID with the side in bit 16.
+        DWORD dwTmp;
+        ar >> dwTmp;
+        DWORD dwType = dwTmp & 0xFFFE0000L;
+        if (dwType == 0)
+            elem = MakePieceElement(PieceID::FromWORD(LOWORD(dwTmp)), (dwTmp >> 16) & 1);
+        else if (dwType == 0xF0000000L)
+            elem = MakeMarkerElement(MarkID::FromWORD(LOWORD(dwTmp)));
+        else
+            elem = (GameElement)dwTmp | GAMEELEM_OBJECTID_FLAG;
+    }
+}
+
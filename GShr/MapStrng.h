@@ -38,43 +38,49 @@
 
 //////////////////////////////////////////////////////////////////////
 
-typedef DWORD GameElement;
+// GameElement's Bit Layout (version 4.00):
+//   The low 32 bits hold a piece ID, marker ID or ObjectID.
+//   The top 4 bits say which (0=piece, 0xF=marker, 0x1=ObjectID).
+//   Bit 32 is the side of a piece. 0=top/1=bottom.
 
-const DWORD GAMEELEM_MARKERID_FLAG = 0xF0000000L; // Top 4 bits set if a marker, else a piece
-const DWORD GAMEELEM_OBJECTID_MASK = 0xFFFE0000L; // else...top 15 bits nonzero if objectID
-                                                  // otherwise it's a piece ID with side code
+typedef uint64_t GameElement;
+
+const GameElement GAMEELEM_TYPE_MASK     = 0xF000000000000000;
+const GameElement GAMEELEM_MARKERID_FLAG = 0xF000000000000000; // Top 4 bits set if a marker
+const GameElement GAMEELEM_OBJECTID_FLAG = 0x1000000000000000; // else...0x1 if objectID
+                                                               // otherwise it's a piece ID with side code
 
 inline GameElement MakePieceElement(PieceID pid, int nSide = 0)
-    { return (GameElement)(static_cast<WORD>(pid) | (DWORD)nSide << 16); }
+    { return (GameElement)static_cast<uint32_t>(pid) | (GameElement)nSide << 32; }
 
 inline GameElement MakeMarkerElement(MarkID mid)
-    { return (GameElement)((DWORD)static_cast<WORD>(mid) | GAMEELEM_MARKERID_FLAG); }
+    { return (GameElement)static_cast<uint32_t>(mid) | GAMEELEM_MARKERID_FLAG; }
 
 #if defined(GPLAY)
 inline GameElement MakeObjectIDElement(ObjectID dwObjectID)
-    { return (GameElement)reinterpret_cast<uint32_t&>(dwObjectID); }
+    { return (GameElement)reinterpret_cast<uint32_t&>(dwObjectID) | GAMEELEM_OBJECTID_FLAG; }
 #endif
 
 inline BOOL IsGameElementAPiece(GameElement elem)
-    { return !(BOOL)(elem & GAMEELEM_MARKERID_FLAG); }
+    { return (BOOL)((elem & GAMEELEM_TYPE_MASK) == 0); }
 
 inline BOOL IsGameElementAMarker(GameElement elem)
-    { return (BOOL)((elem & GAMEELEM_OBJECTID_MASK) == GAMEELEM_MARKERID_FLAG); }
+    { return (BOOL)((elem & GAMEELEM_TYPE_MASK) == GAMEELEM_MARKERID_FLAG); }
 
 inline BOOL IsGameElementAnObjectID(GameElement elem)
-    {
-        DWORD dwVal = elem & GAMEELEM_OBJECTID_MASK;
-        return (BOOL)(dwVal != 0 && dwVal != GAMEELEM_MARKERID_FLAG);
-    }
+    { return (BOOL)((elem & GAMEELEM_TYPE_MASK) == GAMEELEM_OBJECTID_FLAG); }
 
 inline PieceID GetPieceIDFromElement(GameElement elem)
-    { return static_cast<PieceID>(elem & 0xFFFF); }
+    { return static_cast<PieceID>(static_cast<uint32_t>(elem)); }
 
 #if defined(GPLAY)
 inline ObjectID GetObjectIDFromElement(GameElement elem)
-    { return static_cast<ObjectID>(elem); }
+    { return static_cast<ObjectID>(static_cast<DWORD>(elem)); }
 #endif
 
+// Files before version 4.00 store a GameElement as a DWORD with
+// 16 bit IDs.  This reads either form and writes the current one.
+void SerializeGameElement(CArchive& ar, GameElement& elem);
 
 //////////////////////////////////////////////////////////////////////
 // This class is used to map rotated tiles related to playing pieces
@@ -130,12 +130,11 @@ void CMarkManager::DeleteMark(MarkID mid, CGameElementStringMap* pMapString /* =
     ASSERT(m_pMarkTbl != NULL);
     ASSERT(m_pMarkTbl.Valid(mid));
     ASSERT(!m_pMarkTbl[mid].IsEmpty());
-    MarkDef* pDef = &m_pMarkTbl[mid];
 
     if (bFromSetAlso)
         RemoveMarkIDFromMarkSets(mid);
 
-    pDef->SetEmpty();
+    m_pMarkTbl.DeleteIDEntry(mid);
 
     if (pMapString != NULL && !pMapString->IsEmpty())
         pMapString->RemoveKey(MakeMarkerElement(mid));
@@ -373,6 +372,7 @@ void MarkDef::Serialize(CArchive& ar)
             ar >> m_flags;
         else
             m_flags = 0;
+        m_wReserved = 0;
     }
 }
 
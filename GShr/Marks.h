@@ -31,10 +31,10 @@
 
 //////////////////////////////////////////////////////////////////////
 
-const size_t maxMarks = 32000;
+const size_t maxMarks = 0x0FFFFFF0;    // Same limit as pieces
 typedef XxxxID<'M'> MarkID;
 
-const       MarkID nullMid = MarkID(0xFFFF);
+const       MarkID nullMid = MarkID(0xFFFFFFFF);
 
 //////////////////////////////////////////////////////////////////////
 
@@ -47,16 +47,20 @@ struct MarkDef
 {
     TileID  m_tid;
     WORD    m_flags;
+    WORD    m_wReserved;    // Keeps the table free of padding
 
     enum { flagPromptText = 0x8000 };
 
     // -------- //
-    void SetEmpty() { m_tid = nullTid; }
+    void SetEmpty() { m_tid = nullTid; m_wReserved = 0; }
     BOOL IsEmpty() { return m_tid == nullTid; }
     // ---------- //
     void Serialize(CArchive& ar);
 };
 
+// The marker table is only bulk serialized if there's no padding.
+static_assert(std::has_unique_object_representations_v<MarkDef>, "MarkDef has padding");
+
 //////////////////////////////////////////////////////////////////////
 
 enum MarkerTrayViz          // Marker Tray content visiblity options
@@ -121,12 +121,11 @@ void CPieceManager::DeletePiece(PieceID pid, CGameElementStringMap* pMapStrings
     ASSERT(m_pPieceTbl != NULL);
     ASSERT(m_pPieceTbl.Valid(pid));
     ASSERT(!m_pPieceTbl[pid].IsEmpty());
-    PieceDef* pDef = &m_pPieceTbl[pid];
 
     if (bFromSetAlso)
         RemovePieceIDFromPieceSets(pid);
 
-    pDef->SetEmpty();
+    m_pPieceTbl.DeleteIDEntry(pid);
 
     // Also delete any associated piece strings
     if (pMapStrings != NULL && !pMapStrings->IsEmpty())
@@ -299,6 +298,7 @@ void PieceDef::Serialize(CArchive& ar)
             ar >> m_flags;
         else
             m_flags = 0;
+        m_wReserved = 0;
     }
 }
 
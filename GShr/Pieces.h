@@ -31,10 +31,10 @@
 
 //////////////////////////////////////////////////////////////////////
 
-const size_t maxPieces = 32000;
+const size_t maxPieces = 0x0FFFFFF0;   // Piece ObjectIDs hold 28 bit IDs
 typedef XxxxID<'P'> PieceID;
 
-const       PieceID nullPid = PieceID(0xFFFF);
+const       PieceID nullPid = PieceID(0xFFFFFFFF);
 
 //////////////////////////////////////////////////////////////////////
 
@@ -48,6 +48,7 @@ struct PieceDef
     TileID  m_tidFront;
     TileID  m_tidBack;
     WORD    m_flags;
+    WORD    m_wReserved;    // Keeps the table free of padding
 
     enum
     {
@@ -56,7 +57,7 @@ struct PieceDef
     };
 
     // -------- //
-    void SetEmpty() { m_tidFront = m_tidBack = nullTid; }
+    void SetEmpty() { m_tidFront = m_tidBack = nullTid; m_wReserved = 0; }
     BOOL IsEmpty() const { return m_tidFront == nullTid && m_tidBack == nullTid; }
     // ---------- //
     void Serialize(CArchive& ar);
@@ -65,6 +66,9 @@ struct PieceDef
     BOOL Is2Sided() const { return m_tidBack != nullTid; }
 };
 
+// The piece table is only bulk serialized if there's no padding.
+static_assert(std::has_unique_object_representations_v<PieceDef>, "PieceDef has padding");
+
 //////////////////////////////////////////////////////////////////////
 
 class CPieceSet
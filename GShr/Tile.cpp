@@ -40,24 +40,24 @@ static char THIS_FILE[] = __FILE__;
 int CTile::GetWidth() const
 {
     ASSERT(m_pTS != NULL);
-    return m_pTS->GetWidth();
+    return m_size.cx;
 }
 
 int CTile::GetHeight() const
 {
     ASSERT(m_pTS != NULL);
-    return m_pTS->GetHeight();
+    return m_size.cy;
 }
 
 CSize CTile::GetSize() const
 {
-    return m_pTS != NULL ? m_pTS->GetSize() : m_size;
+    return m_size;
 }
 
 void CTile::BitBlt(CDC& pDC, int x, int y, DWORD dwRop)
 {
     if (m_pTS != NULL)
-        m_pTS->TileBlt(&pDC, x, y, m_yLoc, dwRop);
+        m_pTS->TileBlt(&pDC, x, y, GetSheetRect(), dwRop);
     else if (m_crTrans != m_crSmall)
     {
         // Only draw color patch if not the transparent color.
@@ -72,7 +72,7 @@ void CTile::BitBlt(CDC& pDC, int x, int y, DWORD dwRop)
 void CTile::StretchBlt(CDC& pDC, int x, int y, int cx, int cy, DWORD dwRop)
 {
     if (m_pTS != NULL)
-        m_pTS->StretchBlt(&pDC, x, y, cx, cy, m_yLoc, dwRop);
+        m_pTS->StretchBlt(&pDC, x, y, cx, cy, GetSheetRect(), dwRop);
     else if (m_crTrans != m_crSmall)
     {
         CBrush oBrsh;
@@ -92,14 +92,14 @@ void CTile::TransBlt(CDC& pDC, int x, int y, BITMAP* pMaskBMapInfo /* = NULL */)
         {
             if (pMaskBMapInfo != NULL)
             {
-                m_pTS->TransBltThruDIBSectMonoMask(&pDC, x, y, m_yLoc,
+                m_pTS->TransBltThruDIBSectMonoMask(&pDC, x, y, GetSheetRect(),
                     m_crTrans, pMaskBMapInfo);
             }
             else
-                m_pTS->TransBlt(&pDC, x, y, m_yLoc, m_crTrans);
+                m_pTS->TransBlt(&pDC, x, y, GetSheetRect(), m_crTrans);
         }
         else
-            m_pTS->TileBlt(&pDC, x, y, m_yLoc, SRCCOPY);
+            m_pTS->TileBlt(&pDC, x, y, GetSheetRect(), SRCCOPY);
     }
     else if (RGB565(m_crTrans) != RGB565(m_crSmall))
     {
@@ -112,16 +112,28 @@ void CTile::TransBlt(CDC& pDC, int x, int y, BITMAP* pMaskBMapInfo /* = NULL */)
     }
 }
 
+BOOL CTile::IsOpaquePixel(CPoint pnt) const
+{
+    CSize size = GetSize();
+    if (pnt.x < 0 || pnt.y < 0 || pnt.x >= size.cx || pnt.y >= size.cy)
+        return FALSE;
+    if (m_pTS == NULL)
+        return RGB565(m_crTrans) != RGB565(m_crSmall);
+    if (m_crTrans == noColor)
+        return TRUE;
+    return !m_pTS->IsTransparentPixel(m_xLoc + pnt.x, m_yLoc + pnt.y, m_crTrans);
+}
+
 // Updates the tile image in-place
 void CTile::Update(CBitmap *pBMap)
 {
     ASSERT(m_pTS != NULL);
-    m_pTS->UpdateTile(pBMap, m_yLoc);
+    m_pTS->UpdateTile(pBMap, GetSheetRect());
 }
 
 void CTile::CreateBitmapOfTile(CBitmap *pBMap)
 {
     ASSERT(m_pTS != NULL);
-    m_pTS->CreateBitmapOfTile(pBMap, m_yLoc);
+    m_pTS->CreateBitmapOfTile(pBMap, GetSheetRect());
 }
 
@@ -29,18 +29,27 @@
 #include    "GdiTools.h"
 #endif
 
+#ifndef     _CDIB_H
+#include    "CDib.h"
+#endif
+
+#ifndef     _TRANSBLT_H
+#include    "TransBlt.h"
+#endif
+
 ////////////////////////////////////////////////////////////////////
 
 class   CTile;
 
 ////////////////////////////////////////////////////////////////////
 
-const size_t maxTiles = 32000;
+const size_t maxTiles = 0x0FFFFFF0;    // Same limit as pieces
 typedef XxxxID<'T'> TileID;
 
-const       TileID nullTid = TileID(0xFFFF);
+const       TileID nullTid = TileID(0xFFFFFFFF);
 
 const       UINT maxSheetHeight = 8192;     // Max y pixels allowed in a tile sheet
+const       int atlasPageWidth = 1024;      // Width of sheets holding mixed tile sizes
 
 
 // Note that the values from this enum are used as qualifying
@@ -63,12 +72,19 @@ struct TileLoc
     /* TODO:  m_nSheet should be size_t, but that breaks file
         format compatibility, so change this on next new format */
     WORD    m_nSheet;               // (2.91 BYTE->WORD)
-    int     m_nOffset;
+    int     m_nOffset;              // Y location in sheet
+    // Atlas sheets hold tiles of mixed sizes side by side. Tiles on
+    // other sheets have a zero m_nX and an empty m_size since they
+    // are the sheet's tile size.
+    int     m_nX;                   // (3.91)
+    CSize   m_size;                 // (3.91)
     // ------ //
     enum { noSheet = 0xFFFF };
 
     BOOL IsEmpty() const { return m_nSheet == noSheet; }
-    void SetEmpty() { m_nSheet = noSheet; m_nOffset = 0;  } // (clear offset too)
+    void SetEmpty()                 // (clear location too)
+        { m_nSheet = noSheet; m_nOffset = 0; m_nX = 0; m_size = CSize(0, 0); }
+    CRect GetAtlasRect() const { return CRect(CPoint(m_nX, m_nOffset), m_size); }
 
     void Serialize(CArchive& archive);
 };
@@ -108,32 +124,102 @@ public:
 
     BOOL IsSameDimensions(CSize size) const { return size == m_size; }
     int GetSheetHeight() const { return m_sheetHt; }
+    // TRUE if the sheet holds no tiles and has no space reserved.
+    BOOL IsEmpty() const { return m_sheetHt == 0 && m_pBMap == NULL; }
+    BOOL HasFreeSlots() const
+        { return !m_tblFreeSlots.empty() || !m_tblFreeRects.empty(); }
+    BOOL IsAtlas() const { return m_bAtlas; }
+    void SetAtlas();
 
 // Operations
 public:
-    void CreateTile();
+    // Loaded sheets stay compressed until a tile on them is used.
+    void Inflate()
+    {
+        m_dwLastUsed = GetTickCount();
+        if (m_pBMap == NULL && !m_packedDib.IsEmpty())
+            InflatePacked();
+    }
+    BOOL ReleaseIfIdle(DWORD dwIdleMsecs);
+    // Storing packs the sheet in two steps so CTileManager can
+    // compress sheets on worker threads. GetDibToPack() runs on the
+    // UI thread and Pack() can run anywhere. The packed copy is kept
+    // until the sheet is changed.
+    BOOL GetDibToPack(CDib& dib);
+    void Pack(const CDib& dib, int nCompressLevel)
+        { m_packedDib.Pack(dib, nCompressLevel); }
+    // ---------- //
+    int CreateTile();
+    void Reserve(size_t nTiles);
+    void ShrinkToFit();
     void DeleteTile(int yOffset);
-    void UpdateTile(CBitmap *pBMap, int yLoc);
-    void CreateBitmapOfTile(CBitmap *pBMap, int yLoc);
+    void Compact(std::vector<int>& tblFreed);
+    void RebuildFreeSlots(std::vector<int>& tblUsed);
+    // Atlas sheets...
+    BOOL CreateAtlasTile(CSize size, CPoint& pnt);
+    void DeleteAtlasTile(const CRect& rct);
+    BOOL Repack(std::vector<CRect>& tblRects);
+    void RebuildAtlas(const std::vector<CRect>& tblRects);
+    // ---------- //
+    void UpdateTile(CBitmap *pBMap, const CRect& rctTile);
+    void CreateBitmapOfTile(CBitmap *pBMap, const CRect& rctTile);
     // ---------- //
     void Serialize(CArchive& archive);
 
 // Friendly Access...
 protected:
-    void TileBlt(CDC *pDC, int xDst, int yDst, int ySrc, DWORD dwRop);
+    void TileBlt(CDC *pDC, int xDst, int yDst, const CRect& rctSrc, DWORD dwRop);
     void StretchBlt(CDC *pDC, int xDst, int yDst, int xWid, int yWid,
-        int ySrc, DWORD dwRop);
-    void TransBlt(CDC *pDC, int xDst, int yDst, int ySrc, COLORREF crTrans);
-    void TransBltThruDIBSectMonoMask(CDC *pDC, int xDst, int yDst, int ySrc,
+        const CRect& rctSrc, DWORD dwRop);
+    void TransBlt(CDC *pDC, int xDst, int yDst, const CRect& rctSrc, COLORREF crTrans);
+    void TransBltThruDIBSectMonoMask(CDC *pDC, int xDst, int yDst, const CRect& rctSrc,
         COLORREF crTrans, BITMAP* pMaskBMapInfo);
+    BOOL IsTransparentPixel(int x, int y, COLORREF crTrans) const;
 
 // Implementation - vars...
 protected:
+    // The bitmap may be taller than m_sheetHt. The spare rows let
+    // tiles be added without copying the sheet each time.
     OwnerOrNullPtr<CBitmap> m_pBMap;        // Pointer to DDB
     LPBYTE      m_pMem;         // Ptr to DIB Memory (DIBSection)
 
-    CSize       m_size;         // Tile sizes for this sheet
-    int         m_sheetHt;      // Total height of sheet
+    CSize       m_size;         // Tile sizes for this sheet (atlas: page width, 0)
+    int         m_sheetHt;      // Total height of tiles in sheet
+    // Offsets of deleted tiles. They're reused by CreateTile()
+    // and removed by Compact().
+    std::vector<int> m_tblFreeSlots;
+
+    // Atlas sheets pack tiles with a skyline. Each node is a
+    // horizontal run of the sheet's top edge. Nodes aren't stored
+    // in files. They are rebuilt from the tile locations.
+    struct AtlasNode
+    {
+        int     m_x;
+        int     m_y;
+        int     m_cx;
+    };
+    BOOL        m_bAtlas;       // (3.91)
+    size_t      m_nAtlasTiles;
+    std::vector<AtlasNode> m_tblSkyline;
+    std::vector<CRect> m_tblFreeRects;  // Deleted atlas tiles
+
+    // The sheet as loaded or last stored. It's kept after inflating
+    // so an unchanged sheet can be released again when idle. It's
+    // discarded once the bitmap is changed.
+    CPackedDib  m_packedDib;
+    COLORREF    m_crFixupTrans; // For pre-16 bit sheets
+    DWORD       m_dwLastUsed;   // Tick count of last Inflate()
+
+    // Opaque runs of the tiles drawn by TransBlt() sorted by tile
+    // origin (y then x). Each is built the first time its tile is
+    // drawn and dropped when the tile's pixels change. They outlive
+    // ReleaseIfIdle() since the pixels don't change then.
+    struct TileSpans
+    {
+        CPoint      m_pntOrg;
+        CTransSpans m_spans;
+    };
+    std::vector<TileSpans> m_tblSpans;
 
 // Implementation - methods...
 protected:
@@ -147,6 +233,20 @@ protected:
     };
 
     void ClearSheet();
+    int GetCapacity() const;
+    int GetMaxSheetHeight() const;
+    void Reallocate(int nNewHt);
+    void GrowForHeight(int nNewHt);
+    void InflatePacked();
+    void PrepareForEdit();
+    const CTransSpans& GetTransSpans(const BITMAP& bmapTile,
+        const CRect& rctTile, WORD wTrans);
+    void InvalidateSpans(const CRect& rct);
+
+    static BOOL FindAtlasPos(const std::vector<AtlasNode>& tblSkyline,
+        CSize size, size_t& nNode, int& y);
+    static void AddAtlasLevel(std::vector<AtlasNode>& tblSkyline,
+        size_t nNode, const CRect& rct);
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -199,6 +299,12 @@ public:
     // Tile Mangager attributes
     void SetTransparentColor(COLORREF crTrans) { m_crTrans = crTrans; }
     COLORREF GetTransparentColor() const { return m_crTrans; }
+    // In atlas mode new tiles of mixed sizes are packed into shared
+    // sheets instead of one sheet strip per tile size. Existing
+    // tiles aren't moved.
+    BOOL IsAtlasMode() const { return (m_wFlags & flagAtlasMode) != 0; }
+    void SetAtlasMode(BOOL bAtlas)
+        { m_wFlags = bAtlas ? (m_wFlags | flagAtlasMode) : (m_wFlags & ~flagAtlasMode); }
 
     // Tile Set attributes
     size_t GetNumTileSets() const { return m_TSetTbl.size(); }
@@ -231,6 +337,9 @@ public:
     void GetTile(TileID tid, CTile* pTile, TileScale eScale = fullScale);
     TileID CreateTile(size_t nTSet, CSize sFull, CSize sHalf,
         COLORREF crSmall, size_t nPos = Invalid_v<size_t>);
+    void CreateTiles(size_t nTSet, const std::vector<CSize>& tblFull,
+        const std::vector<CSize>& tblHalf, const std::vector<COLORREF>& tblSmall,
+        std::vector<TileID>& tblTids, size_t nPos = Invalid_v<size_t>);
     void DeleteTile(TileID tid, BOOL bFromSetAlso = TRUE);
     void SetSmallTileColor(TileID tid, COLORREF cr);
     BOOL IsTileIDValid(TileID tid);
@@ -246,6 +355,16 @@ public:
     size_t FindNamedTileSet(const char* pszName) const;
     void DeleteTileSet(size_t nTSet);
 
+    // Maintenance pass that closes the gaps left by deleted tiles.
+    void CompactTileSheets();
+
+    // Loaded tile sheets are inflated when first used. Unchanged
+    // sheets not used for the idle time are released again by
+    // ReleaseIdleTileSheets(). An idle time of zero disables this.
+    static void SetIdleReleasePolicy(DWORD dwIdleMsecs);
+    void ReleaseIdleTileSheets();
+    void PackTileSheets(int nCompressLevel);
+
     // ---------- //
     void CopyTileImagesToArchive(CArchive& ar, const std::vector<TileID>& tidsList);
     void CreateTilesFromTileImageArchive(CArchive& ar, size_t nTSet,
@@ -266,7 +385,8 @@ protected:
                 maxTiles, tileTblBaseSize, tileTblIncrSize,
                 false> m_pTileTbl;
     COLORREF    m_crTrans;          // Transparency color for all tiles
-    WORD        m_wReserved1;       // For future need (set to 0)
+    enum { flagAtlasMode = 0x0001 };
+    WORD        m_wFlags;           // Tile manager flags (was m_wReserved1)
     WORD        m_wReserved2;       // For future need (set to 0)
     WORD        m_wReserved3;       // For future need (set to 0)
     WORD        m_wReserved4;       // For future need (set to 0)
@@ -280,13 +400,26 @@ protected:
     // ------- //
     std::vector<CTileSet> m_TSetTbl;
     std::vector<CTileSheet> m_TShtTbl;
+    // Tile set of each tile indexed by TileID. Tiles that aren't in
+    // a set are Invalid_v<size_t>.
+    std::vector<size_t> m_tblTSetOfTile;
+    static DWORD c_dwSheetIdleMsecs;
     // ------- //
     void Clear();
     void CreateTileOnSheet(CSize size, TileLoc& pLoc);
+    BOOL CreateTileOnAtlas(CSize size, TileLoc& pLoc);
     void DeleteTileFromSheet(TileLoc& pLoc);
-    void AdjustTileLoc(TileLoc& pLoc, size_t nSht, int yLoc, int cy);
+    void AdjustTileLoc(TileLoc& pLoc, size_t nSht, const std::vector<int>& tblFreed, int cy);
     size_t GetSheetForTile(CSize size);
+    size_t GetEmptySheet();
+    BOOL IsAtlasTileSize(CSize size) const;
+    CSize GetTileLocSize(const TileLoc& pLoc);
+    void GetLiveTileLocs(size_t nSht, std::vector<TileLoc*>& tblLocs);
+    void RebuildFreeSlots();
+    void ReserveTileSpace(const std::vector<CSize>& tblSizes);
     void RemoveTileIDFromTileSets(TileID tid);
+    void SetTileSetOfTile(TileID tid, size_t nTSet);
+    void RebuildTileSetIndex();
     CTileSheet& GetTileSheet(size_t nSheet)
         { return m_TShtTbl.at(nSheet); }
 };
@@ -305,6 +438,8 @@ public:
     void SetNoTransparent() { m_crTrans = noColor; }
     COLORREF GetTransparent() const { return m_crTrans; }
     COLORREF GetSmallColor() const { return m_crSmall; }
+    // TRUE if the tile relative point lands on a drawn pixel.
+    BOOL IsOpaquePixel(CPoint pnt) const;
 
 // Operations
 public:
@@ -317,10 +452,13 @@ public:
 // Implementation
 protected:
     CTileSheet* m_pTS;      // For Reference Only (DON'T DELETE!!!)
+    int         m_xLoc;     // X location in sheet
     int         m_yLoc;     // Y location in sheet
     CSize       m_size;     // size of bitmap of color patch
     COLORREF    m_crTrans;  // Transparency color in bitmaps
     COLORREF    m_crSmall;  // For smallScale (m_pTS == NULL)
+
+    CRect GetSheetRect() const { return CRect(CPoint(m_xLoc, m_yLoc), m_size); }
 };
 
 #endif
@@ -0,0 +1,272 @@
+// TileCache.cpp
+//
+// Copyright (c) 1994-2020 By Dale L. Larson, All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include    "stdafx.h"
+#include    <algorithm>
+#include    <shlobj.h>
+#include    "GMisc.h"
+#include    "GdiTools.h"
+#include    "CDib.h"
+#include    "TileCache.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+#ifdef  _DEBUG
+#define new DEBUG_NEW
+#endif
+
+///////////////////////////////////////////////////////////////////////
+
+// Each cache file starts with this header. The pixels follow in
+// bottom-up DIB order. The header is a multiple of a DWORD in size
+// as CreateDIBSection() requires of the pixel offset.
+struct TileCacheHeader
+{
+    DWORD   m_dwSignature;
+    DWORD   m_dwVersion;
+    LONG    m_nWidth;
+    LONG    m_nHeight;
+};
+
+static const DWORD tileCacheSignature = 0x43544243;    // "CBTC"
+static const DWORD tileCacheVersion = 1;
+
+CString CTileCache::c_strCacheDir;
+ULONGLONG CTileCache::c_nSizeLimit = ULONGLONG(512) * 1024 * 1024;
+ULONGLONG CTileCache::c_nBytesUsed = 0;
+
+///////////////////////////////////////////////////////////////////////
+
+void CTileCache::SetCacheDirectory(LPCTSTR pszDir)
+{
+    c_strCacheDir = pszDir;
+    if (c_strCacheDir.IsEmpty())
+        return;
+    int nErr = SHCreateDirectoryEx(NULL, c_strCacheDir, NULL);
+    if (nErr != ERROR_SUCCESS && nErr != ERROR_ALREADY_EXISTS && nErr != ERROR_FILE_EXISTS)
+    {
+        TRACE1("CTileCache::SetCacheDirectory - Can't create %s. Cache disabled.\n",
+            (LPCTSTR)c_strCacheDir);
+        c_strCacheDir.Empty();
+        return;
+    }
+    PruneCache();
+}
+
+CString CTileCache::GetDefaultDirectory()
+{
+    char szPath[MAX_PATH];
+    if (FAILED(SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA, NULL,
+            SHGFP_TYPE_CURRENT, szPath)))
+        return CString();
+    CString strDir = szPath;
+    strDir += "\\CyberBoard\\TileCache";
+    return strDir;
+}
+
+// The transparent color is part of the key since it changes the
+// pixels of sheets upgraded from 256 colors.
+CTileCache::Key CTileCache::ComputeKey(const CPackedDib& pdib, COLORREF crFixupTrans)
+{
+    MD5_CTX mdContext;
+    MD5Init(&mdContext);
+    DWORD dwTmp = tileCacheVersion;
+    MD5Update(&mdContext, (LPBYTE)&dwTmp, sizeof(dwTmp));
+    dwTmp = (DWORD)crFixupTrans;
+    MD5Update(&mdContext, (LPBYTE)&dwTmp, sizeof(dwTmp));
+    MD5Update(&mdContext, const_cast<LPBYTE>(pdib.GetPackedData()),
+        value_preserving_cast<unsigned int>(pdib.GetPackedSize()));
+    MD5Final(&mdContext);
+
+    Key key;
+    memcpy(key.m_abyteHash, mdContext.digest, sizeof(key.m_abyteHash));
+    return key;
+}
+
+CString CTileCache::GetSheetFileName(const Key& key)
+{
+    CString strName = c_strCacheDir + "\\";
+    for (size_t i = 0; i < sizeof(key.m_abyteHash); i++)
+    {
+        char szHex[3];
+        wsprintf(szHex, "%02X", key.m_abyteHash[i]);
+        strName += szHex;
+    }
+    strName += ".cbt";
+    return strName;
+}
+
+HBITMAP CTileCache::LoadSheet(const Key& key, int nWidth, int nHeight,
+    BOOL& bCached)
+{
+    bCached = FALSE;
+    if (!IsEnabled())
+        return NULL;
+
+    // The file's contents are only read. Attribute access is needed
+    // to mark the file as recently used for pruning since the file
+    // system may not update access times itself.
+    CString strName = GetSheetFileName(key);
+    HANDLE hFile = CreateFile(strName, GENERIC_READ | FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        // Another instance may have the file open for writing.
+        DWORD dwErr = GetLastError();
+        bCached = dwErr != ERROR_FILE_NOT_FOUND && dwErr != ERROR_PATH_NOT_FOUND;
+        return NULL;
+    }
+
+    // A file that isn't what's expected is deleted so the sheet is
+    // cached again.
+    TileCacheHeader hdr;
+    DWORD dwRead;
+    DWORD dwBitsSize = WIDTHBYTES(nWidth * 16) * value_preserving_cast<DWORD>(nHeight);
+    LARGE_INTEGER nFileSize;
+    if (!ReadFile(hFile, &hdr, sizeof(hdr), &dwRead, NULL) || dwRead != sizeof(hdr) ||
+        hdr.m_dwSignature != tileCacheSignature || hdr.m_dwVersion != tileCacheVersion ||
+        hdr.m_nWidth != nWidth || hdr.m_nHeight != nHeight ||
+        !GetFileSizeEx(hFile, &nFileSize) ||
+        nFileSize.QuadPart != LONGLONG(sizeof(hdr)) + dwBitsSize)
+    {
+        CloseHandle(hFile);
+        DeleteFile(strName);
+        return NULL;
+    }
+    bCached = TRUE;
+
+    FILETIME ftNow;
+    GetSystemTimeAsFileTime(&ftNow);
+    SetFileTime(hFile, NULL, &ftNow, NULL);
+
+    HBITMAP hBMap = Create16BitDIBSection(NULL, nWidth, nHeight);
+    DIBSECTION ds;
+    if (hBMap == NULL || GetObject(hBMap, sizeof(ds), &ds) != sizeof(ds) ||
+        !ReadFile(hFile, ds.dsBm.bmBits, dwBitsSize, &dwRead, NULL) ||
+        dwRead != dwBitsSize)
+    {
+        if (hBMap != NULL)
+            DeleteObject(hBMap);
+        hBMap = NULL;
+    }
+    CloseHandle(hFile);
+    return hBMap;
+}
+
+// Written to a temporary file first so other instances never map a
+// partly written sheet.
+void CTileCache::StoreSheet(const Key& key, CBitmap& bmap)
+{
+    if (!IsEnabled())
+        return;
+
+    DIBSECTION ds;
+    if (bmap.GetObject(sizeof(ds), &ds) != sizeof(ds) || ds.dsBm.bmBits == NULL ||
+            ds.dsBm.bmBitsPixel != 16)
+        return;
+
+    TileCacheHeader hdr;
+    hdr.m_dwSignature = tileCacheSignature;
+    hdr.m_dwVersion = tileCacheVersion;
+    hdr.m_nWidth = ds.dsBm.bmWidth;
+    hdr.m_nHeight = ds.dsBm.bmHeight;
+    DWORD dwBitsSize = WIDTHBYTES(hdr.m_nWidth * 16) * value_preserving_cast<DWORD>(hdr.m_nHeight);
+
+    CString strName = GetSheetFileName(key);
+    CString strTemp;
+    VERIFY(GetTempFileName(c_strCacheDir, "cbt", 0, strTemp.GetBuffer(MAX_PATH)) != 0);
+    strTemp.ReleaseBuffer();
+
+    HANDLE hFile = CreateFile(strTemp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    GdiFlush();
+    DWORD dwWritten1 = 0;
+    DWORD dwWritten2 = 0;
+    BOOL bOK = WriteFile(hFile, &hdr, sizeof(hdr), &dwWritten1, NULL) &&
+        WriteFile(hFile, ds.dsBm.bmBits, dwBitsSize, &dwWritten2, NULL) &&
+        dwWritten1 == sizeof(hdr) && dwWritten2 == dwBitsSize;
+    CloseHandle(hFile);
+
+    if (!bOK || !MoveFileEx(strTemp, strName, MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFile(strTemp);
+        return;
+    }
+    c_nBytesUsed += sizeof(hdr) + dwBitsSize;
+    if (c_nBytesUsed > c_nSizeLimit)
+        PruneCache();
+}
+
+// Deletes the least recently used sheets until the cache fits its
+// size limit. Sheets mapped by running instances stay readable
+// until they're unmapped.
+void CTileCache::PruneCache()
+{
+    struct CacheFile
+    {
+        FILETIME    m_ftLastAccess;
+        ULONGLONG   m_nSize;
+        CString     m_strName;
+    };
+    std::vector<CacheFile> tblFiles;
+    ULONGLONG nTotal = 0;
+
+    WIN32_FIND_DATA fd;
+    HANDLE hFind = FindFirstFile(c_strCacheDir + "\\*.cbt", &fd);
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                continue;
+            CacheFile file;
+            file.m_ftLastAccess = fd.ftLastAccessTime;
+            file.m_nSize = (ULONGLONG(fd.nFileSizeHigh) << 32) | fd.nFileSizeLow;
+            file.m_strName = c_strCacheDir + "\\" + fd.cFileName;
+            nTotal += file.m_nSize;
+            tblFiles.push_back(std::move(file));
+        } while (FindNextFile(hFind, &fd));
+        FindClose(hFind);
+    }
+
+    if (nTotal > c_nSizeLimit)
+    {
+        std::sort(tblFiles.begin(), tblFiles.end(),
+            [](const CacheFile& a, const CacheFile& b)
+            { return CompareFileTime(&a.m_ftLastAccess, &b.m_ftLastAccess) < 0; });
+        for (size_t i = 0; i < tblFiles.size() && nTotal > c_nSizeLimit; i++)
+        {
+            if (DeleteFile(tblFiles[i].m_strName))
+                nTotal -= tblFiles[i].m_nSize;
+        }
+    }
+    c_nBytesUsed = nTotal;
+}
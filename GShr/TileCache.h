@@ -0,0 +1,71 @@
+// TileCache.h
+//
+// Copyright (c) 1994-2020 By Dale L. Larson, All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _TILECACHE_H
+#define _TILECACHE_H
+
+class CPackedDib;
+
+////////////////////////////////////////////////////////////////////
+// On-disk cache of inflated tile sheets. Each sheet image is stored
+// as raw 16 bit pixels in its own file named by a hash of the packed
+// sheet. Cached sheets are read straight into DIB sections so
+// reopening a game box doesn't inflate them again. The cache files
+// are never changed once written. When the files grow past the size
+// limit the least recently used ones are deleted.
+
+class CTileCache
+{
+public:
+    struct Key
+    {
+        BYTE    m_abyteHash[16];
+    };
+
+    // An empty directory disables the cache (the default). The
+    // directory is pruned to the size limit when it's set.
+    static void SetCacheDirectory(LPCTSTR pszDir);
+    static void SetSizeLimit(ULONGLONG nBytes) { c_nSizeLimit = nBytes; }
+    static BOOL IsEnabled() { return !c_strCacheDir.IsEmpty(); }
+    static CString GetDefaultDirectory();
+
+    static Key ComputeKey(const CPackedDib& pdib, COLORREF crFixupTrans);
+    // Returns NULL if the sheet can't be read from the cache.
+    // bCached is set if the sheet's file exists anyway so the
+    // caller doesn't store it again.
+    static HBITMAP LoadSheet(const Key& key, int nWidth, int nHeight,
+        BOOL& bCached);
+    static void StoreSheet(const Key& key, CBitmap& bmap);
+
+protected:
+    static CString  c_strCacheDir;
+    static ULONGLONG c_nSizeLimit;      // Bytes of cache files allowed
+    static ULONGLONG c_nBytesUsed;      // Bytes of cache files at last count
+
+    static CString GetSheetFileName(const Key& key);
+    static void PruneCache();
+};
+
+#endif
+
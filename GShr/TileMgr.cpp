@@ -23,6 +23,11 @@
 //
 
 #include    <stdafx.h>
+#include    <algorithm>
+#include    <atomic>
+#include    <exception>
+#include    <mutex>
+#include    <thread>
 #include    "WinExt.h"
 #include    "CDib.h"
 #include    "GdiTools.h"
@@ -49,6 +54,57 @@ static char THIS_FILE[] = __FILE__;
 
 ///////////////////////////////////////////////////////////////////////
 
+// Calls func(i) for i in [0, nCount) spread over the processor
+// cores. The calls must be independent of each other. The first
+// exception thrown is rethrown once all the workers have stopped.
+template<typename F>
+static void RunOnWorkers(size_t nCount, F func)
+{
+    size_t nThreads = CB::min(value_preserving_cast<size_t>(
+        CB::max(std::thread::hardware_concurrency(), 1u)), nCount);
+    if (nThreads <= size_t(1))
+    {
+        for (size_t i = 0; i < nCount; i++)
+            func(i);
+        return;
+    }
+
+    std::atomic<size_t> nNext(size_t(0));
+    std::exception_ptr pException;
+    std::mutex mtxException;
+    auto worker = [&]()
+    {
+        for (size_t i = nNext++; i < nCount; i = nNext++)
+        {
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mtxException);
+                if (!pException)
+                    pException = std::current_exception();
+                nNext = nCount;         // Stop the other workers
+            }
+        }
+    };
+
+    std::vector<std::thread> tblThreads;
+    tblThreads.reserve(nThreads - size_t(1));
+    for (size_t i = 1; i < nThreads; i++)
+        tblThreads.emplace_back(worker);
+    worker();
+    for (size_t i = 0; i < tblThreads.size(); i++)
+        tblThreads[i].join();
+    if (pException)
+        std::rethrow_exception(pException);
+}
+
+///////////////////////////////////////////////////////////////////////
+
+DWORD CTileManager::c_dwSheetIdleMsecs = 0;     // Never release
+
 CTileManager::CTileManager()
 {
     m_crTrans = RGB(0, 255, 255);
@@ -58,7 +114,7 @@ CTileManager::CTileManager()
     m_fontID = CGamDoc::GetFontManager()->AddFont(TenthPointsToScreenPixels(80),
         0, FF_SWISS, "Arial");
     // --------- //
-    m_wReserved1 = 0;
+    m_wFlags = 0;                       // (was m_wReserved1)
     m_wReserved2 = 0;
     m_wReserved3 = 0;
     m_wReserved4 = 0;
@@ -69,6 +125,7 @@ void CTileManager::Clear()
     m_pTileTbl.Clear();
     m_TSetTbl.clear();
     m_TShtTbl.clear();
+    m_tblTSetOfTile.clear();
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -85,20 +142,26 @@ void CTileManager::GetTile(TileID tid, CTile* pTile,
     {
         TileLoc *pLoc = &m_pTileTbl[tid].m_tileFull;
         pTile->m_pTS  = &GetTileSheet(value_preserving_cast<size_t>(pLoc->m_nSheet));
+        pTile->m_pTS->Inflate();
+        pTile->m_xLoc = pLoc->m_nX;
         pTile->m_yLoc = pLoc->m_nOffset;
+        pTile->m_size = GetTileLocSize(*pLoc);
     }
     else if (eScale == halfScale)
     {
         TileLoc *pLoc = &m_pTileTbl[tid].m_tileHalf;
         pTile->m_pTS  = &GetTileSheet(value_preserving_cast<size_t>(pLoc->m_nSheet));
+        pTile->m_pTS->Inflate();
+        pTile->m_xLoc = pLoc->m_nX;
         pTile->m_yLoc = pLoc->m_nOffset;
+        pTile->m_size = GetTileLocSize(*pLoc);
     }
     else
     {
         pTile->m_pTS = NULL;
         pTile->m_crSmall = pDef->m_tileSmall;
         TileLoc *pLoc = &m_pTileTbl[tid].m_tileFull;
-        pTile->m_size = GetTileSheet(value_preserving_cast<size_t>(pLoc->m_nSheet)).GetSize();
+        pTile->m_size = GetTileLocSize(*pLoc);
     }
     pTile->m_crTrans = m_crTrans;
 }
@@ -118,9 +181,33 @@ TileID CTileManager::CreateTile(size_t nTSet, CSize sFull, CSize sHalf,
     CreateTileOnSheet(sHalf, pDef->m_tileHalf);
 
     GetTileSet(nTSet).AddTileID(tid, nPos);
+    SetTileSetOfTile(tid, nTSet);
     return tid;
 }
 
+// Bulk form of CreateTile(). Sheet space for all the tiles is
+// reserved before any are added.
+void CTileManager::CreateTiles(size_t nTSet, const std::vector<CSize>& tblFull,
+    const std::vector<CSize>& tblHalf, const std::vector<COLORREF>& tblSmall,
+    std::vector<TileID>& tblTids, size_t nPos /* = Invalid_v<size_t> */)
+{
+    ASSERT(tblFull.size() == tblHalf.size() && tblFull.size() == tblSmall.size());
+    std::vector<CSize> tblSizes;
+    tblSizes.reserve(tblFull.size() + tblHalf.size());
+    tblSizes.insert(tblSizes.end(), tblFull.begin(), tblFull.end());
+    tblSizes.insert(tblSizes.end(), tblHalf.begin(), tblHalf.end());
+    ReserveTileSpace(tblSizes);
+
+    tblTids.clear();
+    tblTids.reserve(tblFull.size());
+    for (size_t i = 0; i < tblFull.size(); i++)
+    {
+        tblTids.push_back(CreateTile(nTSet, tblFull[i], tblHalf[i], tblSmall[i], nPos));
+        if (nPos != Invalid_v<size_t>)
+            nPos++;             // Position to next insertion point
+    }
+}
+
 void CTileManager::DeleteTile(TileID tid, BOOL bFromSetAlso /* = TRUE */)
 {
     ASSERT(m_pTileTbl != NULL);
@@ -133,7 +220,7 @@ void CTileManager::DeleteTile(TileID tid, BOOL bFromSetAlso /* = TRUE */)
     if (bFromSetAlso)
         RemoveTileIDFromTileSets(tid);
 
-    pDef.SetEmpty();
+    m_pTileTbl.DeleteIDEntry(tid);
 }
 
 void CTileManager::UpdateTile(TileID tid, CBitmap* pbmFull, CBitmap* pbmHalf,
@@ -179,24 +266,35 @@ void CTileManager::UpdateTile(TileID tid, CBitmap* pbmFull, CBitmap* pbmHalf,
 
 BOOL CTileManager::IsTileIDValid(TileID tid)
 {
-    for (size_t i = 0; i < GetNumTileSets(); i++)
-    {
-        const CTileSet& pTSet = GetTileSet(i);
-        if (pTSet.HasTileID(tid))
-            return TRUE;
-    }
-    return FALSE;
+    return FindTileSetFromTileID(tid) != Invalid_v<size_t>;
 }
 
 size_t CTileManager::FindTileSetFromTileID(TileID tid) const
 {
+    size_t nTid = value_preserving_cast<size_t>(tid);
+    if (nTid >= m_tblTSetOfTile.size())
+        return Invalid_v<size_t>;
+    return m_tblTSetOfTile[nTid];
+}
+
+void CTileManager::SetTileSetOfTile(TileID tid, size_t nTSet)
+{
+    size_t nTid = value_preserving_cast<size_t>(tid);
+    if (nTid >= m_tblTSetOfTile.size())
+        m_tblTSetOfTile.resize(nTid + 1, Invalid_v<size_t>);
+    m_tblTSetOfTile[nTid] = nTSet;
+}
+
+// The index is rebuilt whenever tile set numbers change.
+void CTileManager::RebuildTileSetIndex()
+{
+    m_tblTSetOfTile.clear();
     for (size_t i = 0; i < GetNumTileSets(); i++)
     {
-        const CTileSet& pTSet = GetTileSet(i);
-        if (pTSet.HasTileID(tid))
-            return i;
+        const std::vector<TileID>& pTids = GetTileSet(i).GetTileIDTable();
+        for (size_t j = 0; j < pTids.size(); j++)
+            SetTileSetOfTile(pTids[j], i);
     }
-    return Invalid_v<size_t>;
 }
 
 size_t CTileManager::CreateTileSet(const char* pszName)
@@ -225,6 +323,7 @@ void CTileManager::DeleteTileSet(size_t nTSet)
     for (size_t i = 0; i < pTids.size(); i++)
         DeleteTile(pTids.at(i), FALSE);
     m_TSetTbl.erase(m_TSetTbl.begin() + value_preserving_cast<ptrdiff_t>(nTSet));
+    RebuildTileSetIndex();
 }
 
 void CTileManager::SetSmallTileColor(TileID tid, COLORREF cr)
@@ -238,43 +337,79 @@ void CTileManager::SetSmallTileColor(TileID tid, COLORREF cr)
 
 ///////////////////////////////////////////////////////////////////////
 
+// Atlas sheets hold their tile sizes in the tile locations.
+CSize CTileManager::GetTileLocSize(const TileLoc& pLoc)
+{
+    const CTileSheet& pSht = GetTileSheet(value_preserving_cast<size_t>(pLoc.m_nSheet));
+    return pSht.IsAtlas() ? pLoc.m_size : pSht.GetSize();
+}
+
 size_t CTileManager::GetSheetForTile(CSize size)
 {
     for (size_t i = 0; i < m_TShtTbl.size(); i++)
     {
         CTileSheet& pSht = m_TShtTbl.at(i);
-        if (pSht.IsSameDimensions(size) &&
-            (pSht.GetSheetHeight() + size.cy < int(maxSheetHeight)))
+        if (!pSht.IsAtlas() && pSht.IsSameDimensions(size) &&
+            (pSht.HasFreeSlots() ||
+                pSht.GetSheetHeight() + size.cy < int(maxSheetHeight)))
             return i;
     }
-    // If an empty one exists, reuse a tile sheet having a zero height...
+    TRACE2("Using new tile sheet for cx=%d by cy=%d tile\n", size.cx, size.cy);
+    size_t nSht = GetEmptySheet();
+    m_TShtTbl.at(nSht).SetSize(size);
+    return nSht;
+}
+
+// Reuses a tile sheet having a zero height if one exists.
+size_t CTileManager::GetEmptySheet()
+{
     for (size_t i = 0; i < m_TShtTbl.size(); i++)
     {
-        CTileSheet& pSht = m_TShtTbl.at(i);
-        if (pSht.GetSheetHeight() == 0)
-        {
-            pSht.SetSize(size);
+        if (m_TShtTbl.at(i).IsEmpty())
             return i;
-        }
     }
-    TRACE2("Creating new tile sheet for cx=%d by cy=%d tile\n", size.cx, size.cy);
     m_TShtTbl.resize(m_TShtTbl.size() + 1);
-    m_TShtTbl.back().SetSize(size);
     return m_TShtTbl.size() - 1;
 }
 
-void CTileManager::RemoveTileIDFromTileSets(TileID tid)
+BOOL CTileManager::IsAtlasTileSize(CSize size) const
 {
-    for (size_t i = 0; i < GetNumTileSets(); i++)
+    return IsAtlasMode() && size.cx > 0 && size.cy > 0 &&
+        size.cx <= atlasPageWidth && size.cy < int(maxSheetHeight);
+}
+
+void CTileManager::ReserveTileSpace(const std::vector<CSize>& tblSizes)
+{
+    // Count the tiles of each size. There are usually only a few
+    // distinct sizes.
+    std::vector<std::pair<CSize, size_t>> tblCounts;
+    for (size_t i = 0; i < tblSizes.size(); i++)
     {
-        CTileSet& pTSet = GetTileSet(i);
-        if (pTSet.HasTileID(tid))
-        {
-            pTSet.RemoveTileID(tid);
-            return;
-        }
+        size_t j = 0;
+        while (j < tblCounts.size() && tblCounts[j].first != tblSizes[i])
+            j++;
+        if (j < tblCounts.size())
+            tblCounts[j].second++;
+        else
+            tblCounts.push_back(std::make_pair(tblSizes[i], size_t(1)));
+    }
+    for (size_t j = 0; j < tblCounts.size(); j++)
+    {
+        if (IsAtlasTileSize(tblCounts[j].first))
+            continue;           // Atlas sheets grow as tiles are packed
+        size_t nSht = GetSheetForTile(tblCounts[j].first);
+        m_TShtTbl.at(nSht).Reserve(tblCounts[j].second);
     }
-    ASSERT(FALSE);
+}
+
+void CTileManager::RemoveTileIDFromTileSets(TileID tid)
+{
+    size_t nTSet = FindTileSetFromTileID(tid);
+    ASSERT(nTSet != Invalid_v<size_t>);
+    if (nTSet == Invalid_v<size_t>)
+        return;
+    GetTileSet(nTSet).RemoveTileID(tid);
+    SetTileSetOfTile(tid, Invalid_v<size_t>);
 }
 
 void CTileManager::MoveTileIDsToTileSet(size_t nTSet, const std::vector<TileID>& tidList,
@@ -293,6 +428,7 @@ void CTileManager::MoveTileIDsToTileSet(size_t nTSet, const std::vector<TileID>&
         }
         GetTileSet(nCurSet).RemoveTileID(tid);
         GetTileSet(nTSet).AddTileID(tid, nPos);
+        SetTileSetOfTile(tid, nTSet);
         if (nPos != Invalid_v<size_t>)
             nPos++;
     }
@@ -300,31 +436,192 @@ void CTileManager::MoveTileIDsToTileSet(size_t nTSet, const std::vector<TileID>&
 
 void CTileManager::CreateTileOnSheet(CSize size, TileLoc& pLoc)
 {
+    if (IsAtlasTileSize(size) && CreateTileOnAtlas(size, pLoc))
+        return;
     size_t nSht = GetSheetForTile(size);
     CTileSheet& pSht = m_TShtTbl.at(nSht);
     pLoc.m_nSheet = value_preserving_cast<uint16_t>(nSht);
-    pLoc.m_nOffset = pSht.GetSheetHeight();
+    pLoc.m_nOffset = pSht.CreateTile();     // Always creates tile filled white
+    pLoc.m_nX = 0;
+    pLoc.m_size = CSize(0, 0);
     ASSERT(pLoc.m_nOffset < (int)65535U);
-    pSht.CreateTile();         // Always creates tile at end filled white
 }
 
+// Packs the tile into the first atlas sheet with room for it.
+BOOL CTileManager::CreateTileOnAtlas(CSize size, TileLoc& pLoc)
+{
+    CPoint pnt;
+    size_t nSht;
+    for (nSht = 0; nSht < m_TShtTbl.size(); nSht++)
+    {
+        CTileSheet& pSht = m_TShtTbl.at(nSht);
+        if (pSht.IsAtlas() && pSht.CreateAtlasTile(size, pnt))
+            break;
+    }
+    if (nSht == m_TShtTbl.size())
+    {
+        TRACE2("Using new atlas sheet for cx=%d by cy=%d tile\n", size.cx, size.cy);
+        nSht = GetEmptySheet();
+        CTileSheet& pSht = m_TShtTbl.at(nSht);
+        pSht.SetAtlas();
+        if (!pSht.CreateAtlasTile(size, pnt))
+            return FALSE;
+    }
+    pLoc.m_nSheet = value_preserving_cast<uint16_t>(nSht);
+    pLoc.m_nX = pnt.x;
+    pLoc.m_nOffset = pnt.y;
+    pLoc.m_size = size;
+    ASSERT(pLoc.m_nOffset < (int)65535U);
+    return TRUE;
+}
+
+// The slot is left for reuse. Other tiles aren't moved until
+// CompactTileSheets() is run.
 void CTileManager::DeleteTileFromSheet(TileLoc& pLoc)
 {
     CTileSheet& pSht = m_TShtTbl.at(pLoc.m_nSheet);
-    pSht.DeleteTile(pLoc.m_nOffset);
+    if (pSht.IsAtlas())
+        pSht.DeleteAtlasTile(pLoc.GetAtlasRect());
+    else
+        pSht.DeleteTile(pLoc.m_nOffset);
+}
+
+void CTileManager::CompactTileSheets()
+{
+    std::vector<int> tblFreed;
+    for (size_t nSht = 0; nSht < m_TShtTbl.size(); nSht++)
+    {
+        CTileSheet& pSht = m_TShtTbl.at(nSht);
+        if (!pSht.HasFreeSlots())
+            continue;
+        if (pSht.IsAtlas())
+        {
+            std::vector<TileLoc*> tblLocs;
+            GetLiveTileLocs(nSht, tblLocs);
+            std::vector<CRect> tblRects(tblLocs.size());
+            for (size_t i = 0; i < tblLocs.size(); i++)
+                tblRects[i] = tblLocs[i]->GetAtlasRect();
+            if (!pSht.Repack(tblRects))
+                continue;       // Leave the sheet as is
+            for (size_t i = 0; i < tblLocs.size(); i++)
+            {
+                tblLocs[i]->m_nX = tblRects[i].left;
+                tblLocs[i]->m_nOffset = tblRects[i].top;
+            }
+            continue;
+        }
+        pSht.Compact(tblFreed);
+        for (size_t i = 0; i < m_pTileTbl.GetSize(); i++)
+        {
+            TileDef& pDef = m_pTileTbl[static_cast<TileID>(i)];
+            if (pDef.IsEmpty())
+                continue;
+            AdjustTileLoc(pDef.m_tileFull, nSht, tblFreed, pSht.GetHeight());
+            AdjustTileLoc(pDef.m_tileHalf, nSht, tblFreed, pSht.GetHeight());
+        }
+    }
+}
+
+// Collects the locations of the tiles on a sheet. The tile sets
+// are walked since they only hold live tiles.
+void CTileManager::GetLiveTileLocs(size_t nSht, std::vector<TileLoc*>& tblLocs)
+{
+    tblLocs.clear();
+    for (size_t i = 0; i < GetNumTileSets(); i++)
+    {
+        const std::vector<TileID>& pTids = GetTileSet(i).GetTileIDTable();
+        for (size_t j = 0; j < pTids.size(); j++)
+        {
+            TileDef& pDef = m_pTileTbl[pTids[j]];
+            if (value_preserving_cast<size_t>(pDef.m_tileFull.m_nSheet) == nSht)
+                tblLocs.push_back(&pDef.m_tileFull);
+            if (value_preserving_cast<size_t>(pDef.m_tileHalf.m_nSheet) == nSht)
+                tblLocs.push_back(&pDef.m_tileHalf);
+        }
+    }
+}
+
+// Recovers the packing state of the sheets after loading. Slots
+// of deleted tiles are stored as blank tiles if the sheets weren't
+// compacted before saving. They're found again by looking for the
+// offsets no tile uses.
+void CTileManager::RebuildFreeSlots()
+{
+    std::vector<std::vector<int>> tblUsed(m_TShtTbl.size());
     for (size_t i = 0; i < m_pTileTbl.GetSize(); i++)
     {
-        AdjustTileLoc(m_pTileTbl[static_cast<TileID>(i)].m_tileFull, value_preserving_cast<size_t>(pLoc.m_nSheet),
-            pLoc.m_nOffset, pSht.GetHeight());
-        AdjustTileLoc(m_pTileTbl[static_cast<TileID>(i)].m_tileHalf, value_preserving_cast<size_t>(pLoc.m_nSheet),
-            pLoc.m_nOffset, pSht.GetHeight());
+        const TileDef& pDef = m_pTileTbl[static_cast<TileID>(i)];
+        if (pDef.IsEmpty())
+            continue;
+        for (const TileLoc* pLoc : { &pDef.m_tileFull, &pDef.m_tileHalf })
+        {
+            size_t nSht = value_preserving_cast<size_t>(pLoc->m_nSheet);
+            if (nSht < m_TShtTbl.size() && !m_TShtTbl.at(nSht).IsAtlas())
+                tblUsed[nSht].push_back(pLoc->m_nOffset);
+        }
+    }
+    for (size_t nSht = 0; nSht < m_TShtTbl.size(); nSht++)
+    {
+        CTileSheet& pSht = m_TShtTbl.at(nSht);
+        if (pSht.IsAtlas())
+        {
+            std::vector<TileLoc*> tblLocs;
+            GetLiveTileLocs(nSht, tblLocs);
+            std::vector<CRect> tblRects(tblLocs.size());
+            for (size_t i = 0; i < tblLocs.size(); i++)
+                tblRects[i] = tblLocs[i]->GetAtlasRect();
+            pSht.RebuildAtlas(tblRects);
+        }
+        else
+            pSht.RebuildFreeSlots(tblUsed[nSht]);
     }
 }
 
-void CTileManager::AdjustTileLoc(TileLoc& pLoc, size_t nSht, int yLoc, int cy)
+// Compresses the changed sheets on worker threads so storing them
+// only has to write the results. Bitmaps are copied out on this
+// thread a batch at a time to bound the memory used.
+void CTileManager::PackTileSheets(int nCompressLevel)
 {
-    if (value_preserving_cast<size_t>(pLoc.m_nSheet) == nSht && pLoc.m_nOffset > yLoc)
-        pLoc.m_nOffset -= cy;
+    size_t nBatch = size_t(2) * value_preserving_cast<size_t>(
+        CB::max(std::thread::hardware_concurrency(), 1u));
+    for (size_t nSht = 0; nSht < m_TShtTbl.size(); )
+    {
+        std::vector<size_t> tblShts;
+        std::vector<CDib> tblDibs(nBatch);
+        for ( ; nSht < m_TShtTbl.size() && tblShts.size() < nBatch; nSht++)
+        {
+            if (m_TShtTbl.at(nSht).GetDibToPack(tblDibs[tblShts.size()]))
+                tblShts.push_back(nSht);
+        }
+        RunOnWorkers(tblShts.size(), [&](size_t i)
+            {
+                m_TShtTbl[tblShts[i]].Pack(tblDibs[i], nCompressLevel);
+            });
+    }
+}
+
+void CTileManager::SetIdleReleasePolicy(DWORD dwIdleMsecs)
+{
+    c_dwSheetIdleMsecs = dwIdleMsecs;
+}
+
+void CTileManager::ReleaseIdleTileSheets()
+{
+    if (c_dwSheetIdleMsecs == 0)
+        return;
+    for (size_t nSht = 0; nSht < m_TShtTbl.size(); nSht++)
+        m_TShtTbl.at(nSht).ReleaseIfIdle(c_dwSheetIdleMsecs);
+}
+
+// Moves the tile up by one tile height for each freed slot above it.
+void CTileManager::AdjustTileLoc(TileLoc& pLoc, size_t nSht,
+    const std::vector<int>& tblFreed, int cy)
+{
+    if (value_preserving_cast<size_t>(pLoc.m_nSheet) != nSht)
+        return;
+    ptrdiff_t nFreedAbove = std::lower_bound(tblFreed.begin(), tblFreed.end(),
+        pLoc.m_nOffset) - tblFreed.begin();
+    pLoc.m_nOffset -= value_preserving_cast<int>(nFreedAbove) * cy;
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -374,39 +671,46 @@ void CTileManager::CreateTilesFromTileImageArchive(CArchive& ar,
 
     DWORD nTileCount;
     ar >> nTileCount;
-    if (pTidTbl)
-    {
-        pTidTbl->reserve(value_preserving_cast<size_t>(nTileCount));
-    }
+
+    // Read all the images first so the tiles can be added in bulk.
+    std::vector<OwnerPtr<CBitmap>> tblBMapFull;
+    std::vector<OwnerPtr<CBitmap>> tblBMapHalf;
+    std::vector<CSize> tblSizeFull;
+    std::vector<CSize> tblSizeHalf;
+    std::vector<COLORREF> tblSmall;
+    tblBMapFull.reserve(value_preserving_cast<size_t>(nTileCount));
+    tblBMapHalf.reserve(value_preserving_cast<size_t>(nTileCount));
+    tblSizeFull.reserve(value_preserving_cast<size_t>(nTileCount));
+    tblSizeHalf.reserve(value_preserving_cast<size_t>(nTileCount));
+    tblSmall.reserve(value_preserving_cast<size_t>(nTileCount));
     for (DWORD i = 0; i < nTileCount; i++)
     {
-        COLORREF    crSmall;
         BITMAP      bmInfoFull;
         BITMAP      bmInfoHalf;
         CDib        dib;
         DWORD       dwTmp;
 
-        ar >> dwTmp; crSmall = (COLORREF)dwTmp;
+        ar >> dwTmp; tblSmall.push_back((COLORREF)dwTmp);
 
         ar >> dib;
-        OwnerPtr<CBitmap> pBMapFull = std::move(dib.DIBToBitmap(GetAppPalette()));
+        tblBMapFull.push_back(dib.DIBToBitmap(GetAppPalette()));
 
         ar >> dib;
-        OwnerPtr<CBitmap> pBMapHalf = std::move(dib.DIBToBitmap(GetAppPalette()));
+        tblBMapHalf.push_back(dib.DIBToBitmap(GetAppPalette()));
 
-        VERIFY(pBMapFull->GetObject(sizeof(BITMAP), &bmInfoFull) > 0);
-        VERIFY(pBMapHalf->GetObject(sizeof(BITMAP), &bmInfoHalf) > 0);
+        VERIFY(tblBMapFull.back()->GetObject(sizeof(BITMAP), &bmInfoFull) > 0);
+        VERIFY(tblBMapHalf.back()->GetObject(sizeof(BITMAP), &bmInfoHalf) > 0);
 
-        TileID tid = CreateTile(nTSet,
-            CSize(bmInfoFull.bmWidth, bmInfoFull.bmHeight),
-            CSize(bmInfoHalf.bmWidth, bmInfoHalf.bmHeight),
-            crSmall, nPos);
-        if (nPos != Invalid_v<size_t>)
-            nPos++;             // Position to next insertion point
-        UpdateTile(tid, pBMapFull.get(), pBMapHalf.get(), crSmall);
-        if (pTidTbl)
-            pTidTbl->push_back(tid);
+        tblSizeFull.push_back(CSize(bmInfoFull.bmWidth, bmInfoFull.bmHeight));
+        tblSizeHalf.push_back(CSize(bmInfoHalf.bmWidth, bmInfoHalf.bmHeight));
     }
+
+    std::vector<TileID> tblTids;
+    CreateTiles(nTSet, tblSizeFull, tblSizeHalf, tblSmall, tblTids, nPos);
+    for (size_t i = 0; i < tblTids.size(); i++)
+        UpdateTile(tblTids[i], tblBMapFull[i].get(), tblBMapHalf[i].get(), tblSmall[i]);
+    if (pTidTbl)
+        *pTidTbl = std::move(tblTids);
 #endif
 }
 
@@ -425,7 +729,7 @@ void CTileManager::Serialize(CArchive& ar)
         CFontTbl* pFontMgr = CGamDoc::GetFontManager();
         pFontMgr->Archive(ar, m_fontID);
 
-        ar << m_wReserved1;
+        ar << m_wFlags;                 // (was m_wReserved1)
         ar << m_wReserved2;
         ar << m_wReserved3;
         ar << m_wReserved4;
@@ -450,7 +754,7 @@ void CTileManager::Serialize(CArchive& ar)
         CFontTbl* pFontMgr = CGamDoc::GetFontManager();
         pFontMgr->Archive(ar, m_fontID);
 
-        ar >> m_wReserved1;
+        ar >> m_wFlags;                 // (was m_wReserved1)
         ar >> m_wReserved2;
         ar >> m_wReserved3;
         ar >> m_wReserved4;
@@ -459,6 +763,11 @@ void CTileManager::Serialize(CArchive& ar)
     }
     SerializeTileSets(ar);
     SerializeTileSheets(ar);
+    if (!ar.IsStoring())
+    {
+        RebuildTileSetIndex();
+        RebuildFreeSlots();
+    }
 }
 
 void CTileManager::SerializeTileSets(CArchive& ar)
@@ -485,6 +794,9 @@ void CTileManager::SerializeTileSheets(CArchive& ar)
 {
     if (ar.IsStoring())
     {
+#ifndef GPLAY
+        PackTileSheets(((CGamDoc*)ar.m_pDocument)->GetCompressLevel());
+#endif
         ar << value_preserving_cast<WORD>(m_TShtTbl.size());
         for (size_t i = 0; i < m_TShtTbl.size(); i++)
             m_TShtTbl.at(i).Serialize(ar);
@@ -532,9 +844,10 @@ BOOL CTileManager::PruneTilesOnSheet255()
                 wsprintf(szBfr, "Removed TileID %zu from tile group:\n\n\"%s\".",
                     tid, GetTileSet(nSet).GetName());
                 AfxMessageBox(szBfr);
-                tp.m_tileFull.SetEmpty();
                 tp.m_tileHalf.SetEmpty();
                 tp.m_tileSmall = 0;
+                if (!tp.IsEmpty())
+                    m_pTileTbl.DeleteIDEntry(static_cast<TileID>(tid));
                 bTileFound = TRUE;
             }
         }
@@ -613,7 +926,7 @@ void CTileManager::DumpTileDatabaseInfoToFile(LPCTSTR pszFileName, BOOL bNewFile
         WriteFileString(hFile, szBfr);
         for (size_t i = 0; i < pTSet.GetTileIDTable().size(); i++)
         {
-            wsprintf(szBfr, " %u", static_cast<WORD>(pTSet.GetTileIDTable().at(i)));
+            wsprintf(szBfr, " %u", static_cast<uint32_t>(pTSet.GetTileIDTable().at(i)));
             WriteFileString(hFile, szBfr);
         }
         WriteFileString(hFile, "\r\n");
@@ -763,6 +1076,9 @@ void TileLoc::Serialize(CArchive& ar)
         ar << m_nSheet;
         ASSERT(m_nOffset < (int)65535U);
         ar << (WORD)m_nOffset;
+        ar << (WORD)m_nX;
+        ar << (short)m_size.cx;
+        ar << (short)m_size.cy;
     }
     else
     {
@@ -776,6 +1092,18 @@ void TileLoc::Serialize(CArchive& ar)
             ar >> m_nSheet;
         WORD wTmp;
         ar >> wTmp; m_nOffset = (int)wTmp;
+        if (CGamDoc::GetLoadingVersion() >= NumVersion(3, 91))
+        {
+            short sTmp;
+            ar >> wTmp; m_nX = (int)wTmp;
+            ar >> sTmp; m_size.cx = sTmp;
+            ar >> sTmp; m_size.cy = sTmp;
+        }
+        else
+        {
+            m_nX = 0;
+            m_size = CSize(0, 0);
+        }
     }
 }
 
@@ -23,6 +23,7 @@
 //
 
 #include    "stdafx.h"
+#include    <algorithm>
 #ifdef      GPLAY
     #include    "Gp.h"
     #include    "GameBox.h"
@@ -32,7 +33,10 @@
     #include    "GmDoc.h"
 #endif
 #include    "CDib.h"
+#include    "zlib.h"
 #include    "Tile.h"
+#include    "TileCache.h"
+#include    "TransBlt.h"
 
 #ifdef _DEBUG
 #undef THIS_FILE
@@ -49,6 +53,10 @@ CTileSheet::CTileSheet()
 {
     m_size = CSize(0, 0);
     m_sheetHt = 0;
+    m_bAtlas = FALSE;
+    m_nAtlasTiles = size_t(0);
+    m_crFixupTrans = noColor;
+    m_dwLastUsed = 0;
 }
 
 CTileSheet::CTileSheet(CSize size)
@@ -56,6 +64,10 @@ CTileSheet::CTileSheet(CSize size)
     m_size = size;
     m_sheetHt = 0;
     m_pMem = NULL;
+    m_bAtlas = FALSE;
+    m_nAtlasTiles = size_t(0);
+    m_crFixupTrans = noColor;
+    m_dwLastUsed = 0;
 }
 
 //////////////////////////////////////////////////////////////////
@@ -66,23 +78,25 @@ void CTileSheet::Serialize(CArchive& ar)
     {
         ar << (short)m_size.cx;
         ar << (short)m_size.cy;
-
-        if (m_pBMap)
+        ar << (WORD)m_bAtlas;
+
+        // Free slots are stored as blank tiles. CTileManager finds
+        // them again when the file is loaded.
+        // CTileManager usually packs the sheets beforehand too. A
+        // sheet that was never inflated is written back as loaded.
+        CDib dib;
+        if (GetDibToPack(dib))
         {
-            CDib dib;
-            dib.BitmapToDIB(m_pBMap.get(), GetAppPalette());
-            ASSERT(dib.m_lpDib != NULL);
-            if (dib.m_lpDib != NULL)
-            {
-                ar << (WORD)1;      // Store "HasBitmap" flag
 #ifndef GPLAY
-                dib.SetCompressLevel(((CGamDoc*)ar.m_pDocument)->
-                    GetCompressLevel());
+            Pack(dib, ((CGamDoc*)ar.m_pDocument)->GetCompressLevel());
+#else
+            Pack(dib, Z_NO_COMPRESSION);
 #endif
-                ar << dib;
-            }
-            else
-                ar << (WORD)0;      // Store "HasBitmap" flag
+        }
+        if (!m_packedDib.IsEmpty())
+        {
+            ar << (WORD)1;          // Store "HasBitmap" flag
+            ar << m_packedDib;
         }
         else
             ar << (WORD)0;          // Store "HasBitmap" flag
@@ -94,36 +108,36 @@ void CTileSheet::Serialize(CArchive& ar)
         ar >> sTmp; m_size.cx = sTmp;
         ar >> sTmp; m_size.cy = sTmp;
 
-        WORD wHasBitmap = 1;            // Force for old versions of file
 #ifdef GPLAY
-        if (CGameBox::GetLoadingVersion() > NumVersion(0, 52))
+        int nLoadingVersion = CGameBox::GetLoadingVersion();
 #else
-        if (CGamDoc::GetLoadingVersion() > NumVersion(0, 52))
+        int nLoadingVersion = CGamDoc::GetLoadingVersion();
 #endif
+        if (nLoadingVersion >= NumVersion(3, 91))
+        {
+            WORD wTmp;
+            ar >> wTmp; m_bAtlas = (BOOL)wTmp;
+        }
+
+        WORD wHasBitmap = 1;            // Force for old versions of file
+        if (nLoadingVersion > NumVersion(0, 52))
             ar >> wHasBitmap;
 
         if (wHasBitmap)
         {
-            CDib dib;
-            ar >> dib;
-            if (dib.m_lpDib != NULL)
+            // The bitmap isn't created until a tile on the sheet
+            // is used. See Inflate().
+            ar >> m_packedDib;
+            if (!m_packedDib.IsEmpty())
             {
-                m_pBMap = dib.DIBToBitmap(GetAppPalette());
-                BITMAP bmInfo;
-                m_pBMap->GetObject(sizeof(bmInfo), &bmInfo);
                 TRACE3("-- Loaded Tile Sheet for cx=%d, cy=%d tiles. Tile sheet height = %d\n",
-                    m_size.cx, m_size.cy, bmInfo.bmHeight);
-                //  ASSERT(bmInfo.bmHeight < maxSheetHeight);
-                m_sheetHt = bmInfo.bmHeight;
-                // If the DIB was in 256 color format and we are running
-                // on Win9x/ME we need to remap all transparent colors
-                // to the WinNT/2000/XP 16 bit equivalent.
-                if (dib.NumColors() == 8)       // (should be changed to NumColorBits!)
+                    m_size.cx, m_size.cy, m_packedDib.Height());
+                //  ASSERT(m_packedDib.Height() < maxSheetHeight);
+                m_sheetHt = m_packedDib.Height();
+                if (m_packedDib.NumColors() == 8)   // (should be changed to NumColorBits!)
                 {
-                    COLORREF crTrans = ((CGamDoc*)ar.m_pDocument)->
+                    m_crFixupTrans = ((CGamDoc*)ar.m_pDocument)->
                         GetTileManager()->GetTransparentColor();
-                    FixupTransparentColorsAfter256ColorDibUpgrade(
-                        (HBITMAP)m_pBMap->m_hObject, crTrans);
                 }
             }
             else
@@ -144,123 +158,530 @@ void CTileSheet::SetSize(CSize size)
 {
     ASSERT(m_sheetHt == 0 && m_pBMap == NULL);  // ONLY LEGAL IF NO DATA IN SHEET!!!!!!
     m_size = size;
+    m_bAtlas = FALSE;
+}
+
+void CTileSheet::SetAtlas()
+{
+    ASSERT(m_sheetHt == 0 && m_pBMap == NULL);  // ONLY LEGAL IF NO DATA IN SHEET!!!!!!
+    m_size = CSize(atlasPageWidth, 0);
+    m_bAtlas = TRUE;
+    m_nAtlasTiles = size_t(0);
+    m_tblFreeRects.clear();
+    m_tblSkyline.assign(size_t(1), AtlasNode{ 0, 0, atlasPageWidth });
+}
+
+//////////////////////////////////////////////////////////////////
+
+void CTileSheet::InflatePacked()
+{
+    ASSERT(m_pBMap == NULL && !m_packedDib.IsEmpty());
+    TRACE3("-- Inflating Tile Sheet for cx=%d, cy=%d tiles (%zu bytes packed)\n",
+        m_size.cx, m_size.cy, m_packedDib.GetPackedSize());
+    CTileCache::Key key = CTileCache::Key();
+    BOOL bCached = FALSE;
+    if (CTileCache::IsEnabled())
+    {
+        key = CTileCache::ComputeKey(m_packedDib, m_crFixupTrans);
+        HBITMAP hBMap = CTileCache::LoadSheet(key, m_packedDib.Width(),
+            m_packedDib.Height(), bCached);
+        if (hBMap != NULL)
+        {
+            m_pBMap = MakeOwner<CBitmap>();
+            m_pBMap->Attach(hBMap);
+            return;
+        }
+    }
+
+    CDib dib;
+    m_packedDib.Unpack(dib);
+    m_pBMap = dib.DIBToBitmap(GetAppPalette());
+    // If the DIB was in 256 color format and we are running
+    // on Win9x/ME we need to remap all transparent colors
+    // to the WinNT/2000/XP 16 bit equivalent.
+    if (m_packedDib.NumColors() == 8)
+    {
+        FixupTransparentColorsAfter256ColorDibUpgrade(
+            (HBITMAP)m_pBMap->m_hObject, m_crFixupTrans);
+    }
+    // A sheet that's cached but couldn't be read isn't written again.
+    if (CTileCache::IsEnabled() && !bCached)
+        CTileCache::StoreSheet(key, *m_pBMap);
+}
+
+// Drops the bitmap of a sheet that hasn't been used for dwIdleMsecs.
+// Only unchanged sheets can be released since the packed copy is
+// what gets inflated again.
+BOOL CTileSheet::ReleaseIfIdle(DWORD dwIdleMsecs)
+{
+    if (m_pBMap == NULL || m_packedDib.IsEmpty() ||
+            GetTickCount() - m_dwLastUsed < dwIdleMsecs)
+        return FALSE;
+    TRACE2("-- Releasing idle Tile Sheet for cx=%d, cy=%d tiles\n",
+        m_size.cx, m_size.cy);
+    m_pBMap = nullptr;
+    return TRUE;
+}
+
+// Fills dib with the sheet's bitmap if the sheet has to be packed
+// before storing. Must be called on the UI thread.
+BOOL CTileSheet::GetDibToPack(CDib& dib)
+{
+    ShrinkToFit();                      // Spare rows aren't stored
+    if (m_pBMap == NULL || !m_packedDib.IsEmpty())
+        return FALSE;
+    dib.BitmapToDIB(m_pBMap.get(), GetAppPalette());
+    ASSERT(dib.m_lpDib != NULL);
+    return dib.m_lpDib != NULL;
+}
+
+// Called before the bitmap is changed. The packed copy no longer
+// matches after that.
+void CTileSheet::PrepareForEdit()
+{
+    Inflate();
+    m_packedDib.Clear();
 }
 
 //////////////////////////////////////////////////////////////////
 
-void CTileSheet::CreateTile()
+// Adds a white tile and returns its offset. Slots freed by
+// DeleteTile() are reused first. Otherwise the tile goes at the end
+// and the bitmap grows geometrically so a run of insertions copies
+// the sheet only O(log N) times.
+int CTileSheet::CreateTile()
 {
-    if (m_pBMap != NULL)
+    ASSERT(m_size != CSize(0,0) && !m_bAtlas);
+    PrepareForEdit();
+    if (!m_tblFreeSlots.empty())
     {
-        BITMAP bmInfo;
-        VERIFY(m_pBMap->GetObject(sizeof(bmInfo), &bmInfo) > 0);
-        bmInfo.bmBits = NULL;
-        bmInfo.bmHeight += m_size.cy;       // Increase size.
+        int yLoc = m_tblFreeSlots.back();
+        m_tblFreeSlots.pop_back();
 
+        g_gt.mDC1.SelectObject(m_pBMap.get());
         SetupPalette(&g_gt.mDC1);
-        SetupPalette(&g_gt.mDC2);
+        g_gt.mDC1.PatBlt(0, yLoc, m_size.cx, m_size.cy, WHITENESS);
+        g_gt.SelectSafeObjectsForDC1();
+        InvalidateSpans(CRect(CPoint(0, yLoc), m_size));
+        return yLoc;
+    }
 
-        OwnerPtr<CBitmap> pBMap = MakeOwner<CBitmap>();
-        pBMap->Attach(Create16BitDIBSection(g_gt.mDC1.m_hDC,
-            bmInfo.bmWidth, bmInfo.bmHeight));
-        ASSERT(pBMap->m_hObject != NULL);
+    GrowForHeight(m_sheetHt + m_size.cy);
+
+    g_gt.mDC1.SelectObject(m_pBMap.get());
+    SetupPalette(&g_gt.mDC1);
+    g_gt.mDC1.PatBlt(0, m_sheetHt, m_size.cx, m_size.cy, WHITENESS);
+    g_gt.SelectSafeObjectsForDC1();
+
+    int yLoc = m_sheetHt;
+    m_sheetHt += m_size.cy;
+    InvalidateSpans(CRect(CPoint(0, yLoc), m_size));
+    return yLoc;
+}
+
+// Makes room for the tiles without adding them. Capped at the
+// maximum sheet height.
+void CTileSheet::Reserve(size_t nTiles)
+{
+    ASSERT(m_size != CSize(0,0) && !m_bAtlas);
+    PrepareForEdit();
+    int nMaxHt = GetMaxSheetHeight();
+    nTiles = CB::min(nTiles, value_preserving_cast<size_t>(nMaxHt / m_size.cy));
+    int nNewHt = CB::min(m_sheetHt + value_preserving_cast<int>(nTiles) * m_size.cy, nMaxHt);
+    if (nNewHt > GetCapacity())
+        Reallocate(nNewHt);
+}
+
+// Drops any spare rows so only the tiles are stored.
+void CTileSheet::ShrinkToFit()
+{
+    if (m_sheetHt == 0)
+        m_pBMap = nullptr;
+    else if (GetCapacity() > m_sheetHt)
+        Reallocate(m_sheetHt);
+}
+
+int CTileSheet::GetCapacity() const
+{
+    if (m_pBMap == NULL)
+        return 0;
+    BITMAP bmInfo;
+    VERIFY(m_pBMap->GetObject(sizeof(bmInfo), &bmInfo) > 0);
+    return bmInfo.bmHeight;
+}
+
+// Tallest sheet CTileManager will put tiles of this size on.
+int CTileSheet::GetMaxSheetHeight() const
+{
+    if (m_bAtlas)
+        return int(maxSheetHeight) - 1;
+    return (int(maxSheetHeight) - 1) / m_size.cy * m_size.cy;
+}
+
+// Makes sure the bitmap has at least nNewHt rows, doubling it
+// when it has to grow.
+void CTileSheet::GrowForHeight(int nNewHt)
+{
+    if (GetCapacity() < nNewHt)
+        Reallocate(CB::max(nNewHt, CB::min(2 * m_sheetHt, GetMaxSheetHeight())));
+}
+
+void CTileSheet::Reallocate(int nNewHt)
+{
+    ASSERT(nNewHt >= m_sheetHt && nNewHt > 0);
+    if (m_pBMap == NULL)
+        TRACE("CTileSheet::Reallocate - Creating new TileSheet bitmap\n");
+
+    SetupPalette(&g_gt.mDC1);
+    OwnerPtr<CBitmap> pBMap = MakeOwner<CBitmap>();
+    pBMap->Attach(Create16BitDIBSection(g_gt.mDC1.m_hDC, m_size.cx, nNewHt));
+    ASSERT(pBMap->m_hObject != NULL);
+
+    if (m_sheetHt > 0)
+    {
         g_gt.mDC1.SelectObject(pBMap.get());          // Dest bitmap
         g_gt.mDC2.SelectObject(m_pBMap.get());        // Source bitmap
+        SetupPalette(&g_gt.mDC2);
 
         g_gt.mDC1.BitBlt(0, 0, m_size.cx, m_sheetHt, &g_gt.mDC2, 0, 0, SRCCOPY);
-        g_gt.mDC1.PatBlt(0, m_sheetHt, m_size.cx, m_size.cy, WHITENESS);
 
         g_gt.SelectSafeObjectsForDC1();
         g_gt.SelectSafeObjectsForDC2();
-
-        m_sheetHt = bmInfo.bmHeight;
-
-        m_pBMap = std::move(pBMap);
     }
-    else
-    {
-        ASSERT(m_size != CSize(0,0));
-        TRACE("CTileSheet::CreateTile - Creating new TileSheet bitmap\n");
-        m_pBMap = MakeOwner<CBitmap>();
-        SetupPalette(&g_gt.mDC1);
-        m_pBMap->Attach(Create16BitDIBSection(g_gt.mDC1.m_hDC,
-            m_size.cx, m_size.cy));
-        g_gt.mDC1.SelectObject(m_pBMap.get());
-        g_gt.mDC1.PatBlt(0, 0, m_size.cx, m_size.cy, WHITENESS);
-        g_gt.SelectSafeObjectsForDC1();
 
-        m_sheetHt = m_size.cy;
-    }
+    m_pBMap = std::move(pBMap);
 }
 
+// The slot is only marked free. The bitmap is released once every
+// slot is free.
 void CTileSheet::DeleteTile(int yLoc)
 {
-    ASSERT(m_pBMap != NULL);
-    ASSERT(yLoc < m_sheetHt - 1);
-    if (m_size.cy == m_sheetHt)
+    ASSERT(m_sheetHt > 0 && !m_bAtlas);
+    ASSERT(yLoc < m_sheetHt - 1 && yLoc % m_size.cy == 0);
+    ASSERT(std::find(m_tblFreeSlots.begin(), m_tblFreeSlots.end(), yLoc) ==
+        m_tblFreeSlots.end());
+    m_tblFreeSlots.push_back(yLoc);
+    if (value_preserving_cast<int>(m_tblFreeSlots.size()) * m_size.cy == m_sheetHt)
     {
         TRACE("CTileSheet::DeleteTile - Deleting TileSheet bitmap\n");
-        // Single tile is all that's left...
-        ASSERT(yLoc == 0);
         m_pBMap = nullptr;
+        m_packedDib.Clear();
         m_sheetHt = 0;
+        m_tblFreeSlots.clear();
+        m_tblSpans.clear();
     }
-    else
+}
+
+// The free slots are the offsets of the sheet that no tile uses.
+void CTileSheet::RebuildFreeSlots(std::vector<int>& tblUsed)
+{
+    ASSERT(!m_bAtlas);
+    m_tblFreeSlots.clear();
+    if (m_sheetHt == 0)
+        return;
+    std::sort(tblUsed.begin(), tblUsed.end());
+    for (int yLoc = 0; yLoc < m_sheetHt; yLoc += m_size.cy)
     {
-        BITMAP bmInfo;
-        m_pBMap->GetObject(sizeof(bmInfo), &bmInfo);
-        bmInfo.bmBits = NULL;
-        bmInfo.bmHeight -= m_size.cy;           // Decrease size.
+        if (!std::binary_search(tblUsed.begin(), tblUsed.end(), yLoc))
+            m_tblFreeSlots.push_back(yLoc);
+    }
+    // CreateTile() reuses from the back so the lowest slots go first.
+    std::reverse(m_tblFreeSlots.begin(), m_tblFreeSlots.end());
+}
 
-        OwnerPtr<CBitmap> pBMap = MakeOwner<CBitmap>();
-        g_gt.mDC2.SelectObject(m_pBMap.get());        // Source bitmap
-        SetupPalette(&g_gt.mDC2);
+// Removes the free slots from the sheet. tblFreed receives their
+// sorted offsets so the caller can renumber the remaining tiles.
+void CTileSheet::Compact(std::vector<int>& tblFreed)
+{
+    tblFreed = std::move(m_tblFreeSlots);
+    m_tblFreeSlots.clear();
+    if (tblFreed.empty())
+        return;
+    std::sort(tblFreed.begin(), tblFreed.end());
+    PrepareForEdit();
+    m_tblSpans.clear();                 // Tiles move
+    ASSERT(m_pBMap != NULL);
 
-        pBMap->Attach(Create16BitDIBSection(g_gt.mDC2.m_hDC,
-            bmInfo.bmWidth, bmInfo.bmHeight));
+    int nNewHt = m_sheetHt - value_preserving_cast<int>(tblFreed.size()) * m_size.cy;
+    ASSERT(nNewHt > 0);
 
-        g_gt.mDC1.SelectObject(pBMap.get());          // Dest bitmap
-        SetupPalette(&g_gt.mDC1);
+    OwnerPtr<CBitmap> pBMap = MakeOwner<CBitmap>();
+    g_gt.mDC2.SelectObject(m_pBMap.get());        // Source bitmap
+    SetupPalette(&g_gt.mDC2);
+
+    pBMap->Attach(Create16BitDIBSection(g_gt.mDC2.m_hDC, m_size.cx, nNewHt));
+
+    g_gt.mDC1.SelectObject(pBMap.get());          // Dest bitmap
+    SetupPalette(&g_gt.mDC1);
+
+    // Copy each run of tiles between the free slots.
+    int ySrc = 0;
+    int yDst = 0;
+    for (size_t i = 0; i <= tblFreed.size(); i++)
+    {
+        int yEnd = i < tblFreed.size() ? tblFreed[i] : m_sheetHt;
+        if (yEnd > ySrc)
+        {
+            g_gt.mDC1.BitBlt(0, yDst, m_size.cx, yEnd - ySrc, &g_gt.mDC2, 0, ySrc, SRCCOPY);
+            yDst += yEnd - ySrc;
+        }
+        ySrc = yEnd + m_size.cy;
+    }
+    ASSERT(yDst == nNewHt);
+    g_gt.SelectSafeObjectsForDC1();
+    g_gt.SelectSafeObjectsForDC2();
+
+    m_sheetHt = nNewHt;
+    m_pBMap = std::move(pBMap);
+}
+
+//////////////////////////////////////////////////////////////////
+// Atlas sheets
 
-        if (yLoc > 0)
+// Finds the lowest spot the tile fits on the skyline (ties go
+// to the left). nNode is the node the tile's left edge sits on.
+BOOL CTileSheet::FindAtlasPos(const std::vector<AtlasNode>& tblSkyline,
+    CSize size, size_t& nNode, int& y)
+{
+    BOOL bFound = FALSE;
+    for (size_t i = 0; i < tblSkyline.size(); i++)
+    {
+        if (tblSkyline[i].m_x + size.cx > atlasPageWidth)
+            break;
+        // The tile rests on the highest node it spans.
+        int yTop = tblSkyline[i].m_y;
+        int nWidthLeft = size.cx - tblSkyline[i].m_cx;
+        for (size_t j = i + 1; nWidthLeft > 0; j++)
         {
-            // There is a piece above the deleted piece.
-            g_gt.mDC1.BitBlt(0, 0, m_size.cx, yLoc, &g_gt.mDC2, 0, 0, SRCCOPY);
+            ASSERT(j < tblSkyline.size());
+            yTop = CB::max(yTop, tblSkyline[j].m_y);
+            nWidthLeft -= tblSkyline[j].m_cx;
         }
-        if (yLoc + m_size.cy < m_sheetHt)           // See if not last tile
+        if (yTop + size.cy > int(maxSheetHeight) - 1)
+            continue;
+        if (!bFound || yTop < y)
         {
-            // There is a piece after the deleted piece.
-            g_gt.mDC1.BitBlt(0, yLoc, m_size.cx, m_sheetHt - (yLoc + m_size.cy),
-                &g_gt.mDC2, 0, yLoc + m_size.cy, SRCCOPY);
+            nNode = i;
+            y = yTop;
+            bFound = TRUE;
         }
-        g_gt.SelectSafeObjectsForDC1();
-        g_gt.SelectSafeObjectsForDC2();
+    }
+    return bFound;
+}
+
+// Raises the skyline over the new tile.
+void CTileSheet::AddAtlasLevel(std::vector<AtlasNode>& tblSkyline,
+    size_t nNode, const CRect& rct)
+{
+    tblSkyline.insert(tblSkyline.begin() + value_preserving_cast<ptrdiff_t>(nNode),
+        AtlasNode{ rct.left, rct.bottom, rct.Width() });
+
+    // Trim the nodes now under the tile.
+    size_t i = nNode + 1;
+    while (i < tblSkyline.size())
+    {
+        const AtlasNode& prev = tblSkyline[i - 1];
+        AtlasNode& node = tblSkyline[i];
+        int nOverlap = prev.m_x + prev.m_cx - node.m_x;
+        if (nOverlap <= 0)
+            break;
+        node.m_x += nOverlap;
+        node.m_cx -= nOverlap;
+        if (node.m_cx > 0)
+            break;
+        tblSkyline.erase(tblSkyline.begin() + value_preserving_cast<ptrdiff_t>(i));
+    }
+
+    // Merge neighbours at the same height.
+    for (i = 0; i + 1 < tblSkyline.size(); )
+    {
+        if (tblSkyline[i].m_y == tblSkyline[i + 1].m_y)
+        {
+            tblSkyline[i].m_cx += tblSkyline[i + 1].m_cx;
+            tblSkyline.erase(tblSkyline.begin() + value_preserving_cast<ptrdiff_t>(i + 1));
+        }
+        else
+            i++;
+    }
+}
+
+// Adds a white tile to the atlas. Returns FALSE if the sheet is
+// full. The slot of a deleted tile of the same size is reused
+// first.
+BOOL CTileSheet::CreateAtlasTile(CSize size, CPoint& pnt)
+{
+    ASSERT(m_bAtlas);
+    PrepareForEdit();
+    CRect rct;
+    std::vector<CRect>::iterator pos = std::find_if(m_tblFreeRects.begin(),
+        m_tblFreeRects.end(), [size](const CRect& r) { return r.Size() == size; });
+    if (pos != m_tblFreeRects.end())
+    {
+        rct = *pos;
+        m_tblFreeRects.erase(pos);
+    }
+    else
+    {
+        size_t nNode;
+        int y;
+        if (!FindAtlasPos(m_tblSkyline, size, nNode, y))
+            return FALSE;
+        rct = CRect(CPoint(m_tblSkyline[nNode].m_x, y), size);
+        AddAtlasLevel(m_tblSkyline, nNode, rct);
+
+        GrowForHeight(CB::max(m_sheetHt, rct.bottom));
+        m_sheetHt = CB::max(m_sheetHt, rct.bottom);
+    }
+
+    g_gt.mDC1.SelectObject(m_pBMap.get());
+    SetupPalette(&g_gt.mDC1);
+    g_gt.mDC1.PatBlt(rct.left, rct.top, rct.Width(), rct.Height(), WHITENESS);
+    g_gt.SelectSafeObjectsForDC1();
+    InvalidateSpans(rct);
+
+    m_nAtlasTiles++;
+    pnt = rct.TopLeft();
+    return TRUE;
+}
+
+// The space is only reused by tiles of the same size until the
+// sheet is repacked. The bitmap is released once the last tile
+// is gone.
+void CTileSheet::DeleteAtlasTile(const CRect& rct)
+{
+    ASSERT(m_bAtlas && m_nAtlasTiles > size_t(0));
+    m_tblFreeRects.push_back(rct);
+    if (--m_nAtlasTiles == size_t(0))
+    {
+        TRACE("CTileSheet::DeleteAtlasTile - Deleting TileSheet bitmap\n");
+        m_pBMap = nullptr;
+        m_packedDib.Clear();
+        m_sheetHt = 0;
+        m_tblSpans.clear();
+        SetAtlas();
+    }
+}
+
+// Packs the tiles again tallest first and closes the gaps left by
+// deleted tiles. tblRects holds the current tile rects and gets
+// their new locations. Returns FALSE, changing nothing, if the
+// tiles don't fit in the maximum sheet height.
+BOOL CTileSheet::Repack(std::vector<CRect>& tblRects)
+{
+    ASSERT(m_bAtlas && tblRects.size() == m_nAtlasTiles);
+    if (tblRects.empty())
+        return TRUE;
+    PrepareForEdit();
+
+    std::vector<size_t> tblOrder(tblRects.size());
+    for (size_t i = 0; i < tblOrder.size(); i++)
+        tblOrder[i] = i;
+    std::stable_sort(tblOrder.begin(), tblOrder.end(),
+        [&tblRects](size_t a, size_t b)
+        {
+            return tblRects[a].Height() > tblRects[b].Height() ||
+                (tblRects[a].Height() == tblRects[b].Height() &&
+                    tblRects[a].Width() > tblRects[b].Width());
+        });
+
+    std::vector<AtlasNode> tblSkyline(size_t(1), AtlasNode{ 0, 0, atlasPageWidth });
+    std::vector<CRect> tblNewRects(tblRects.size());
+    int nNewHt = 0;
+    for (size_t i = 0; i < tblOrder.size(); i++)
+    {
+        CSize size = tblRects[tblOrder[i]].Size();
+        size_t nNode;
+        int y;
+        if (!FindAtlasPos(tblSkyline, size, nNode, y))
+            return FALSE;
+        CRect rct(CPoint(tblSkyline[nNode].m_x, y), size);
+        AddAtlasLevel(tblSkyline, nNode, rct);
+        tblNewRects[tblOrder[i]] = rct;
+        nNewHt = CB::max(nNewHt, rct.bottom);
+    }
+
+    OwnerPtr<CBitmap> pBMap = MakeOwner<CBitmap>();
+    g_gt.mDC2.SelectObject(m_pBMap.get());        // Source bitmap
+    SetupPalette(&g_gt.mDC2);
+
+    pBMap->Attach(Create16BitDIBSection(g_gt.mDC2.m_hDC, m_size.cx, nNewHt));
 
-        m_sheetHt = bmInfo.bmHeight;
+    g_gt.mDC1.SelectObject(pBMap.get());          // Dest bitmap
+    SetupPalette(&g_gt.mDC1);
 
-        m_pBMap = std::move(pBMap);
+    for (size_t i = 0; i < tblRects.size(); i++)
+    {
+        const CRect& rctSrc = tblRects[i];
+        const CRect& rctDst = tblNewRects[i];
+        g_gt.mDC1.BitBlt(rctDst.left, rctDst.top, rctDst.Width(), rctDst.Height(),
+            &g_gt.mDC2, rctSrc.left, rctSrc.top, SRCCOPY);
     }
+    g_gt.SelectSafeObjectsForDC1();
+    g_gt.SelectSafeObjectsForDC2();
+
+    m_pBMap = std::move(pBMap);
+    m_sheetHt = nNewHt;
+    m_tblSkyline = std::move(tblSkyline);
+    m_tblSpans.clear();                 // Tiles move
+    m_tblFreeRects.clear();
+    tblRects = std::move(tblNewRects);
+    return TRUE;
 }
 
-void CTileSheet::UpdateTile(CBitmap *pBMap, int yLoc)
+// Atlas packing state isn't stored in files. It's recovered from
+// the rects of the tiles on the sheet.
+void CTileSheet::RebuildAtlas(const std::vector<CRect>& tblRects)
 {
+    ASSERT(m_bAtlas);
+    m_nAtlasTiles = tblRects.size();
+    m_tblFreeRects.clear();
+
+    std::vector<int> tblColumnHt(size_t(atlasPageWidth), 0);
+    for (size_t i = 0; i < tblRects.size(); i++)
+    {
+        const CRect& rct = tblRects[i];
+        for (int x = rct.left; x < rct.right; x++)
+        {
+            int& nHt = tblColumnHt[value_preserving_cast<size_t>(x)];
+            nHt = CB::max(nHt, rct.bottom);
+        }
+    }
+    m_tblSkyline.clear();
+    for (int x = 0; x < atlasPageWidth; x++)
+    {
+        int nHt = tblColumnHt[value_preserving_cast<size_t>(x)];
+        if (!m_tblSkyline.empty() && m_tblSkyline.back().m_y == nHt)
+            m_tblSkyline.back().m_cx++;
+        else
+            m_tblSkyline.push_back(AtlasNode{ x, nHt, 1 });
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+
+void CTileSheet::UpdateTile(CBitmap *pBMap, const CRect& rctTile)
+{
+    PrepareForEdit();
     ASSERT(m_pBMap != NULL);
-    ASSERT(yLoc < m_sheetHt - 1);
+    ASSERT(rctTile.top < m_sheetHt - 1);
     g_gt.mDC1.SelectObject(m_pBMap.get());        // Dest bitmap
     SetupPalette(&g_gt.mDC1);
     g_gt.mDC2.SelectObject(pBMap);          // Source bitmap
     SetupPalette(&g_gt.mDC2);
 
-    g_gt.mDC1.BitBlt(0, yLoc, m_size.cx, m_size.cy, &g_gt.mDC2, 0, 0, SRCCOPY);
+    g_gt.mDC1.BitBlt(rctTile.left, rctTile.top, rctTile.Width(), rctTile.Height(),
+        &g_gt.mDC2, 0, 0, SRCCOPY);
 
     g_gt.SelectSafeObjectsForDC1();
     g_gt.SelectSafeObjectsForDC2();
+    InvalidateSpans(rctTile);
 }
 
-void CTileSheet::CreateBitmapOfTile(CBitmap *pBMap, int yLoc)
+void CTileSheet::CreateBitmapOfTile(CBitmap *pBMap, const CRect& rctTile)
 {
+    Inflate();
     ASSERT(m_pBMap != NULL);
-    ASSERT(yLoc < m_sheetHt - 1);
+    ASSERT(rctTile.top < m_sheetHt - 1);
     g_gt.mDC1.SelectObject(m_pBMap.get());        // Source bitmap
     SetupPalette(&g_gt.mDC1);
 
@@ -273,17 +694,18 @@ void CTileSheet::CreateBitmapOfTile(CBitmap *pBMap, int yLoc)
     if (bmap.bmBits != NULL)                // DIB Section check
     {
         pBMap->Attach(Create16BitDIBSection(g_gt.mDC1.m_hDC,
-            m_size.cx, m_size.cy));
+            rctTile.Width(), rctTile.Height()));
     }
     else
     {
-        pBMap->CreateCompatibleBitmap(&g_gt.mDC1, m_size.cx, m_size.cy);
+        pBMap->CreateCompatibleBitmap(&g_gt.mDC1, rctTile.Width(), rctTile.Height());
     }
 
     g_gt.mDC2.SelectObject(pBMap);          // Activate dest bitmap
     SetupPalette(&g_gt.mDC2);
 
-    g_gt.mDC2.BitBlt(0, 0, m_size.cx, m_size.cy, &g_gt.mDC1, 0, yLoc, SRCCOPY);
+    g_gt.mDC2.BitBlt(0, 0, rctTile.Width(), rctTile.Height(), &g_gt.mDC1,
+        rctTile.left, rctTile.top, SRCCOPY);
 
     g_gt.SelectSafeObjectsForDC1();
     g_gt.SelectSafeObjectsForDC2();
@@ -291,21 +713,22 @@ void CTileSheet::CreateBitmapOfTile(CBitmap *pBMap, int yLoc)
 
 ////////////////////////////////////////////////////////////////////////
 
-void CTileSheet::TileBlt(CDC *pDC, int xDst, int yDst, int ySrc, DWORD dwRop)
+void CTileSheet::TileBlt(CDC *pDC, int xDst, int yDst, const CRect& rctSrc, DWORD dwRop)
 {
     SheetDC sheetDC(*this);
-    pDC->BitBlt(xDst, yDst, m_size.cx, m_size.cy, sheetDC, 0, ySrc, dwRop);
+    pDC->BitBlt(xDst, yDst, rctSrc.Width(), rctSrc.Height(), sheetDC,
+        rctSrc.left, rctSrc.top, dwRop);
 }
 
 void CTileSheet::StretchBlt(CDC *pDC, int xDst, int yDst,
-    int xWid, int yWid, int ySrc, DWORD dwRop)
+    int xWid, int yWid, const CRect& rctSrc, DWORD dwRop)
 {
     SheetDC sheetDC(*this);
-    pDC->StretchBlt(xDst, yDst, xWid, yWid, sheetDC, 0, ySrc,
-        m_size.cx, m_size.cy, dwRop);
+    pDC->StretchBlt(xDst, yDst, xWid, yWid, sheetDC, rctSrc.left, rctSrc.top,
+        rctSrc.Width(), rctSrc.Height(), dwRop);
 }
 
-void CTileSheet::TransBlt(CDC *pDC, int xDst, int yDst, int ySrc,
+void CTileSheet::TransBlt(CDC *pDC, int xDst, int yDst, const CRect& rctSrc,
     COLORREF crTrans)
 {
     GdiFlush();
@@ -322,46 +745,47 @@ void CTileSheet::TransBlt(CDC *pDC, int xDst, int yDst, int ySrc,
     ::GetObject(hBMapDest, sizeof(BITMAP), &bmapDest);
     ASSERT(bmapTile.bmBits != NULL && bmapDest.bmBits != NULL);
 
-    LPBYTE pTile = (LPBYTE)bmapTile.bmBits;
-    LPBYTE pDest = (LPBYTE)bmapDest.bmBits;
-
-    WORD cr16Trans = RGB565(crTrans);
-
     CPoint pntOrg = pDC->GetViewportOrg();
-    xDst += pntOrg.x;
-    yDst += pntOrg.y;
-    int xDstBase = xDst;
+    const CTransSpans& spans = GetTransSpans(bmapTile, rctSrc, RGB565(crTrans));
+    spans.Blt(bmapDest, xDst + pntOrg.x, yDst + pntOrg.y,
+        bmapTile, rctSrc.left, rctSrc.top);
+}
 
-    int nBytesPerScanLineTile = WIDTHBYTES(bmapTile.bmWidth * 16);
-    int nBytesPerScanLineDest = WIDTHBYTES(bmapDest.bmWidth * 16);
-    for (int nScanLine = 0; nScanLine < m_size.cy; nScanLine++)
-    {
-        xDst = xDstBase;
-        WORD* pPxlTile = (WORD*)(pTile + (bmapTile.bmHeight - ySrc - 1) *
-            nBytesPerScanLineTile);
-        WORD* pPxlDest = (WORD*)(pDest + (bmapDest.bmHeight - yDst - 1) *
-            nBytesPerScanLineDest + 2 * xDst); // Two bytes per pixel
-        for (int nPxl = 0; nPxl < m_size.cx; nPxl++)
+// Returns the opaque runs of the tile, building them if the tile
+// hasn't been drawn with this transparent color before.
+const CTransSpans& CTileSheet::GetTransSpans(const BITMAP& bmapTile,
+    const CRect& rctTile, WORD wTrans)
+{
+    CPoint pntOrg = rctTile.TopLeft();
+    std::vector<TileSpans>::iterator pos = std::lower_bound(m_tblSpans.begin(),
+        m_tblSpans.end(), pntOrg, [](const TileSpans& ts, CPoint pnt)
         {
-            if (*pPxlTile != cr16Trans &&
-                xDst >= 0 && xDst < bmapDest.bmWidth &&
-                yDst >= 0 && yDst < bmapDest.bmHeight)
-            {
-                *pPxlDest = *pPxlTile;
-            }
-            pPxlDest++;
-            pPxlTile++;
-            xDst++;
-        }
-        yDst++;
-        ySrc++;
-    }
+            return ts.m_pntOrg.y < pnt.y ||
+                (ts.m_pntOrg.y == pnt.y && ts.m_pntOrg.x < pnt.x);
+        });
+    if (pos == m_tblSpans.end() || pos->m_pntOrg != pntOrg)
+        pos = m_tblSpans.insert(pos, TileSpans{ pntOrg, CTransSpans() });
+    if (!pos->m_spans.IsBuiltFor(rctTile.Size(), wTrans))
+        pos->m_spans.Build(bmapTile, rctTile, wTrans);
+    return pos->m_spans;
+}
+
+// Drops the runs of every tile overlapping rct.
+void CTileSheet::InvalidateSpans(const CRect& rct)
+{
+    m_tblSpans.erase(std::remove_if(m_tblSpans.begin(), m_tblSpans.end(),
+        [&rct](const TileSpans& ts)
+        {
+            CRect rctTile(ts.m_pntOrg, ts.m_spans.GetSize());
+            CRect rctIsect;
+            return rctIsect.IntersectRect(rctTile, rct) != FALSE;
+        }), m_tblSpans.end());
 }
 
 ////////////////////////////////////////////////////////////////////////
 
-void CTileSheet::TransBltThruDIBSectMonoMask(CDC *pDC, int xDst, int yDst, int ySrc,
-    COLORREF crTrans, BITMAP* pMaskBMapInfo)
+void CTileSheet::TransBltThruDIBSectMonoMask(CDC *pDC, int xDst, int yDst,
+    const CRect& rctSrc, COLORREF crTrans, BITMAP* pMaskBMapInfo)
 {
     GdiFlush();
 
@@ -378,50 +802,33 @@ void CTileSheet::TransBltThruDIBSectMonoMask(CDC *pDC, int xDst, int yDst, int y
     ::GetObject(hBMapDest, sizeof(BITMAP), &bmapDest);
     ASSERT(bmapTile.bmBits != NULL && bmapDest.bmBits != NULL);
 
-    LPBYTE pTile = (LPBYTE)bmapTile.bmBits;
-    LPBYTE pDest = (LPBYTE)bmapDest.bmBits;
-    LPBYTE pMask = (LPBYTE)pMaskBMapInfo->bmBits;
-
-    WORD cr16Trans = RGB565(crTrans);
     CPoint pntOrg = pDC->GetViewportOrg();
-    xDst += pntOrg.x;
-    yDst += pntOrg.y;
-    int xDstBase = xDst;
+    TransBlt16Masked(bmapDest, xDst + pntOrg.x, yDst + pntOrg.y,
+        bmapTile, rctSrc.left, rctSrc.top, rctSrc.Width(), rctSrc.Height(),
+        *pMaskBMapInfo, RGB565(crTrans));
+}
 
-    int nBytesPerScanLineTile = WIDTHBYTES(bmapTile.bmWidth * 16);
-    int nBytesPerScanLineDest = WIDTHBYTES(bmapDest.bmWidth * 16);
-    int nBytesPerScanLineMask = WIDTHBYTES(pMaskBMapInfo->bmWidth * 16);
-    for (int nScanLine = 0; nScanLine < m_size.cy; nScanLine++)
-    {
-        xDst = xDstBase;
+////////////////////////////////////////////////////////////////////////
 
-        WORD* pPxlTile = (WORD*)(pTile + (bmapTile.bmHeight - ySrc - 1) *
-            nBytesPerScanLineTile);
-        WORD* pPxlDest = (WORD*)(pDest + (bmapDest.bmHeight - yDst - 1) *
-            nBytesPerScanLineDest + 2 * xDst); // Two bytes per pixel
-        WORD* pPxlMask = (WORD*)(pMask + (pMaskBMapInfo->bmHeight - nScanLine - 1) *
-            nBytesPerScanLineMask);
+// Reads the pixel straight from the sheet's DIB section so hit
+// testing doesn't need a DC.
+BOOL CTileSheet::IsTransparentPixel(int x, int y, COLORREF crTrans) const
+{
+    ASSERT(x >= 0 && x < m_size.cx && y >= 0 && y < m_sheetHt);
+    GdiFlush();
 
-        for (int nPxl = 0; nPxl < m_size.cx; nPxl++)
-        {
-            if (nScanLine < pMaskBMapInfo->bmHeight &&  // Still in mask?
-                nPxl < pMaskBMapInfo->bmWidth &&        // Still in mask?
-                *pPxlMask == 0 &&                       // Only black mask bits get through
-                *pPxlTile != cr16Trans &&
-                xDst >= 0 && xDst < bmapDest.bmWidth &&
-                yDst >= 0 && yDst < bmapDest.bmHeight)
-            {
-                *pPxlDest = *pPxlTile;
-            }
-            pPxlDest++;
-            pPxlTile++;
-            pPxlMask++;
+    BITMAP  bmapTile;
+    memset(&bmapTile, 0, sizeof(BITMAP));
+    m_pBMap->GetObject(sizeof(BITMAP), &bmapTile);
+    ASSERT(bmapTile.bmBits != NULL);
+    if (bmapTile.bmBits == NULL)
+        return FALSE;
 
-            xDst++;
-        }
-        yDst++;
-        ySrc++;
-    }
+    const BYTE* pTile = static_cast<const BYTE*>(bmapTile.bmBits);
+    int nBytesPerScanLineTile = WIDTHBYTES(bmapTile.bmWidth * 16);
+    const WORD* pPxlTile = reinterpret_cast<const WORD*>(pTile +
+        (bmapTile.bmHeight - y - 1) * nBytesPerScanLineTile) + x;
+    return *pPxlTile == RGB565(crTrans);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -431,6 +838,14 @@ void CTileSheet::ClearSheet()
     m_size = CSize(0, 0);
     m_pBMap = nullptr;
     m_pMem = NULL;
+    m_tblFreeSlots.clear();
+    m_bAtlas = FALSE;
+    m_nAtlasTiles = size_t(0);
+    m_tblSkyline.clear();
+    m_tblFreeRects.clear();
+    m_packedDib.Clear();
+    m_crFixupTrans = noColor;
+    m_tblSpans.clear();
 }
 
 CTileSheet::SheetDC::SheetDC(CTileSheet& sheet)
@@ -0,0 +1,390 @@
+// TransBlt.cpp
+//
+// Copyright (c) 1994-2020 By Dale L. Larson, All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include    "stdafx.h"
+#include    <intrin.h>
+#include    <immintrin.h>
+#include    <vector>
+#include    "DibApi.h"
+#include    "TransBlt.h"
+
+#ifdef _DEBUG
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+#ifdef  _DEBUG
+#define new DEBUG_NEW
+#endif
+
+///////////////////////////////////////////////////////////////////////
+// Row kernels. Each vector kernel blends whole registers with a
+// compare mask and finishes the ragged end of the row with the next
+// narrower kernel. The destination is always read and rewritten so
+// the results are identical to the scalar loop.
+
+typedef void (*TransRowProc)(WORD* pDst, const WORD* pSrc, size_t nPxls,
+    WORD wTrans);
+typedef void (*TransMaskedRowProc)(WORD* pDst, const WORD* pSrc,
+    const WORD* pMask, size_t nPxls, WORD wTrans);
+
+static void TransRowScalar(WORD* pDst, const WORD* pSrc, size_t nPxls,
+    WORD wTrans)
+{
+    for (size_t i = 0; i < nPxls; i++)
+    {
+        if (pSrc[i] != wTrans)
+            pDst[i] = pSrc[i];
+    }
+}
+
+static void TransMaskedRowScalar(WORD* pDst, const WORD* pSrc,
+    const WORD* pMask, size_t nPxls, WORD wTrans)
+{
+    for (size_t i = 0; i < nPxls; i++)
+    {
+        if (pMask[i] == 0 && pSrc[i] != wTrans)
+            pDst[i] = pSrc[i];
+    }
+}
+
+static void TransRowSSE2(WORD* pDst, const WORD* pSrc, size_t nPxls,
+    WORD wTrans)
+{
+    const __m128i vTrans = _mm_set1_epi16(static_cast<short>(wTrans));
+    size_t i = 0;
+    for ( ; i + 8 <= nPxls; i += 8)
+    {
+        __m128i vSrc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        __m128i vDst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDst + i));
+        // All ones where the destination pixel is kept.
+        __m128i vKeep = _mm_cmpeq_epi16(vSrc, vTrans);
+        vDst = _mm_or_si128(_mm_and_si128(vKeep, vDst),
+            _mm_andnot_si128(vKeep, vSrc));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), vDst);
+    }
+    TransRowScalar(pDst + i, pSrc + i, nPxls - i, wTrans);
+}
+
+static void TransMaskedRowSSE2(WORD* pDst, const WORD* pSrc,
+    const WORD* pMask, size_t nPxls, WORD wTrans)
+{
+    const __m128i vTrans = _mm_set1_epi16(static_cast<short>(wTrans));
+    const __m128i vZero = _mm_setzero_si128();
+    size_t i = 0;
+    for ( ; i + 8 <= nPxls; i += 8)
+    {
+        __m128i vSrc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        __m128i vDst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDst + i));
+        __m128i vMsk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pMask + i));
+        // All ones where the source pixel is copied.
+        __m128i vCopy = _mm_andnot_si128(_mm_cmpeq_epi16(vSrc, vTrans),
+            _mm_cmpeq_epi16(vMsk, vZero));
+        vDst = _mm_or_si128(_mm_and_si128(vCopy, vSrc),
+            _mm_andnot_si128(vCopy, vDst));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), vDst);
+    }
+    TransMaskedRowScalar(pDst + i, pSrc + i, pMask + i, nPxls - i, wTrans);
+}
+
+// The project isn't built with /arch:AVX2 so the compiler won't clear
+// the upper register halves for us. Leaving them dirty would slow
+// down the SSE code that runs afterward.
+static void TransRowAVX2(WORD* pDst, const WORD* pSrc, size_t nPxls,
+    WORD wTrans)
+{
+    const __m256i vTrans = _mm256_set1_epi16(static_cast<short>(wTrans));
+    size_t i = 0;
+    for ( ; i + 16 <= nPxls; i += 16)
+    {
+        __m256i vSrc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        __m256i vDst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDst + i));
+        __m256i vKeep = _mm256_cmpeq_epi16(vSrc, vTrans);
+        vDst = _mm256_blendv_epi8(vSrc, vDst, vKeep);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), vDst);
+    }
+    _mm256_zeroupper();
+    TransRowSSE2(pDst + i, pSrc + i, nPxls - i, wTrans);
+}
+
+static void TransMaskedRowAVX2(WORD* pDst, const WORD* pSrc,
+    const WORD* pMask, size_t nPxls, WORD wTrans)
+{
+    const __m256i vTrans = _mm256_set1_epi16(static_cast<short>(wTrans));
+    const __m256i vZero = _mm256_setzero_si256();
+    size_t i = 0;
+    for ( ; i + 16 <= nPxls; i += 16)
+    {
+        __m256i vSrc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        __m256i vDst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDst + i));
+        __m256i vMsk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pMask + i));
+        __m256i vCopy = _mm256_andnot_si256(_mm256_cmpeq_epi16(vSrc, vTrans),
+            _mm256_cmpeq_epi16(vMsk, vZero));
+        vDst = _mm256_blendv_epi8(vDst, vSrc, vCopy);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), vDst);
+    }
+    _mm256_zeroupper();
+    TransMaskedRowSSE2(pDst + i, pSrc + i, pMask + i, nPxls - i, wTrans);
+}
+
+static const TransRowProc tblTransRow[] =
+    { TransRowScalar, TransRowSSE2, TransRowAVX2 };
+static const TransMaskedRowProc tblTransMaskedRow[] =
+    { TransMaskedRowScalar, TransMaskedRowSSE2, TransMaskedRowAVX2 };
+
+///////////////////////////////////////////////////////////////////////
+
+static TransBltKernel DetectTransBltKernel()
+{
+    int anRegs[4];                  // EAX, EBX, ECX, EDX
+    __cpuid(anRegs, 0);
+    int nMaxLeaf = anRegs[0];
+    if (nMaxLeaf < 1)
+        return tbkScalar;
+
+    __cpuid(anRegs, 1);
+    if ((anRegs[3] & (1 << 26)) == 0)                   // SSE2
+        return tbkScalar;
+
+    // AVX2 also needs the OS to save the YMM registers.
+    const int nOSXSaveAVX = (1 << 27) | (1 << 28);      // OSXSAVE | AVX
+    if (nMaxLeaf < 7 || (anRegs[2] & nOSXSaveAVX) != nOSXSaveAVX ||
+            (_xgetbv(0) & 0x6) != 0x6)                  // XMM | YMM state
+        return tbkSSE2;
+
+    __cpuidex(anRegs, 7, 0);
+    if ((anRegs[1] & (1 << 5)) == 0)                    // AVX2
+        return tbkSSE2;
+
+    return tbkAVX2;
+}
+
+TransBltKernel GetTransBltKernel()
+{
+    static const TransBltKernel eKernel = DetectTransBltKernel();
+    return eKernel;
+}
+
+void TransBltRow16(WORD* pDst, const WORD* pSrc, size_t nPxls, WORD wTrans)
+{
+    tblTransRow[GetTransBltKernel()](pDst, pSrc, nPxls, wTrans);
+}
+
+void TransBltMaskedRow16(WORD* pDst, const WORD* pSrc, const WORD* pMask,
+    size_t nPxls, WORD wTrans)
+{
+    tblTransMaskedRow[GetTransBltKernel()](pDst, pSrc, pMask, nPxls, wTrans);
+}
+
+///////////////////////////////////////////////////////////////////////
+
+static inline WORD* GetDIBRow(const BITMAP& bmap, int y)
+{
+    return reinterpret_cast<WORD*>(static_cast<LPBYTE>(bmap.bmBits) +
+        (bmap.bmHeight - y - 1) * WIDTHBYTES(bmap.bmWidth * 16));
+}
+
+// Trims the leading and trailing parts of the block that fall outside
+// of the destination. Returns FALSE if nothing is left. The offsets
+// added to the destination start are returned so the caller can move
+// any other origins along with it.
+static BOOL ClipToDest(const BITMAP& bmapDst, int& xDst, int& yDst,
+    int& cx, int& cy, int& xSkip, int& ySkip)
+{
+    xSkip = xDst < 0 ? -xDst : 0;
+    ySkip = yDst < 0 ? -yDst : 0;
+    xDst += xSkip;
+    yDst += ySkip;
+    cx = CB::min(cx - xSkip, bmapDst.bmWidth - xDst);
+    cy = CB::min(cy - ySkip, bmapDst.bmHeight - yDst);
+    return cx > 0 && cy > 0;
+}
+
+void TransBlt16(const BITMAP& bmapDst, int xDst, int yDst,
+    const BITMAP& bmapSrc, int xSrc, int ySrc, int cx, int cy, WORD wTrans)
+{
+    ASSERT(bmapDst.bmBits != NULL && bmapSrc.bmBits != NULL);
+    ASSERT(bmapDst.bmBitsPixel == 16 && bmapSrc.bmBitsPixel == 16);
+    int xSkip, ySkip;
+    if (!ClipToDest(bmapDst, xDst, yDst, cx, cy, xSkip, ySkip))
+        return;
+    xSrc += xSkip;
+    ySrc += ySkip;
+    ASSERT(xSrc >= 0 && xSrc + cx <= bmapSrc.bmWidth);
+    ASSERT(ySrc >= 0 && ySrc + cy <= bmapSrc.bmHeight);
+
+    TransRowProc pfnRow = tblTransRow[GetTransBltKernel()];
+    for (int nScanLine = 0; nScanLine < cy; nScanLine++)
+    {
+        pfnRow(GetDIBRow(bmapDst, yDst + nScanLine) + xDst,
+            GetDIBRow(bmapSrc, ySrc + nScanLine) + xSrc,
+            value_preserving_cast<size_t>(cx), wTrans);
+    }
+}
+
+void TransBlt16Masked(const BITMAP& bmapDst, int xDst, int yDst,
+    const BITMAP& bmapSrc, int xSrc, int ySrc, int cx, int cy,
+    const BITMAP& bmapMask, WORD wTrans)
+{
+    ASSERT(bmapMask.bmBits != NULL && bmapMask.bmBitsPixel == 16);
+    cx = CB::min(cx, bmapMask.bmWidth);
+    cy = CB::min(cy, bmapMask.bmHeight);
+    int xSkip, ySkip;
+    if (!ClipToDest(bmapDst, xDst, yDst, cx, cy, xSkip, ySkip))
+        return;
+    xSrc += xSkip;
+    ySrc += ySkip;
+    ASSERT(xSrc >= 0 && xSrc + cx <= bmapSrc.bmWidth);
+    ASSERT(ySrc >= 0 && ySrc + cy <= bmapSrc.bmHeight);
+
+    TransMaskedRowProc pfnRow = tblTransMaskedRow[GetTransBltKernel()];
+    for (int nScanLine = 0; nScanLine < cy; nScanLine++)
+    {
+        pfnRow(GetDIBRow(bmapDst, yDst + nScanLine) + xDst,
+            GetDIBRow(bmapSrc, ySrc + nScanLine) + xSrc,
+            GetDIBRow(bmapMask, ySkip + nScanLine) + xSkip,
+            value_preserving_cast<size_t>(cx), wTrans);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////
+
+void CTransSpans::Build(const BITMAP& bmapSrc, const CRect& rctSrc, WORD wTrans)
+{
+    ASSERT(bmapSrc.bmBits != NULL && bmapSrc.bmBitsPixel == 16);
+    ASSERT(rctSrc.left >= 0 && rctSrc.right <= bmapSrc.bmWidth);
+    ASSERT(rctSrc.top >= 0 && rctSrc.bottom <= bmapSrc.bmHeight);
+    m_size = rctSrc.Size();
+    m_wTrans = wTrans;
+    m_tblRowStart.clear();
+    m_tblRuns.clear();
+    m_tblRowStart.reserve(value_preserving_cast<size_t>(m_size.cy + 1));
+
+    for (int y = 0; y < m_size.cy; y++)
+    {
+        m_tblRowStart.push_back(m_tblRuns.size());
+        const WORD* pPxl = GetDIBRow(bmapSrc, rctSrc.top + y) + rctSrc.left;
+        int x = 0;
+        while (x < m_size.cx)
+        {
+            while (x < m_size.cx && pPxl[x] == wTrans)
+                x++;
+            int xStart = x;
+            while (x < m_size.cx && pPxl[x] != wTrans)
+                x++;
+            if (x > xStart)
+                m_tblRuns.push_back(Run{ xStart, x - xStart });
+        }
+    }
+    m_tblRowStart.push_back(m_tblRuns.size());
+}
+
+void CTransSpans::Blt(const BITMAP& bmapDst, int xDst, int yDst,
+    const BITMAP& bmapSrc, int xSrc, int ySrc) const
+{
+    ASSERT(!m_tblRowStart.empty());
+    ASSERT(bmapDst.bmBits != NULL && bmapDst.bmBitsPixel == 16);
+    int cx = m_size.cx;
+    int cy = m_size.cy;
+    int xSkip, ySkip;
+    if (!ClipToDest(bmapDst, xDst, yDst, cx, cy, xSkip, ySkip))
+        return;
+    int xEnd = xSkip + cx;
+
+    for (int nScanLine = 0; nScanLine < cy; nScanLine++)
+    {
+        int y = ySkip + nScanLine;
+        // Both rows are offset so pixel x of the block is at [x].
+        WORD* pPxlDst = GetDIBRow(bmapDst, yDst + nScanLine) + xDst - xSkip;
+        const WORD* pPxlSrc = GetDIBRow(bmapSrc, ySrc + y) + xSrc;
+        size_t nEnd = m_tblRowStart[value_preserving_cast<size_t>(y + 1)];
+        for (size_t i = m_tblRowStart[value_preserving_cast<size_t>(y)]; i < nEnd; i++)
+        {
+            const Run& run = m_tblRuns[i];
+            if (run.m_x >= xEnd)
+                break;
+            int x = CB::max(run.m_x, xSkip);
+            int xRunEnd = CB::min(run.m_x + run.m_cx, xEnd);
+            if (xRunEnd > x)
+            {
+                memcpy(pPxlDst + x, pPxlSrc + x,
+                    value_preserving_cast<size_t>(xRunEnd - x) * sizeof(WORD));
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////
+
+BOOL TransBltSelfTest()
+{
+    const WORD wTrans = 0xF81F;
+    const size_t nMaxPxls = 80;
+    const size_t nMaxOffset = 8;        // Covers every misalignment
+    const size_t nBufSize = nMaxOffset + nMaxPxls + 16;   // Trailing guard
+
+    // Mostly transparent or masked pixels in mixed runs so every blend
+    // outcome lands in every lane.
+    std::vector<WORD> tblSrc(nBufSize), tblMask(nBufSize), tblDst(nBufSize);
+    DWORD dwSeed = 0x2545F491;
+    auto Rand = [&dwSeed]() -> WORD
+    {
+        dwSeed = dwSeed * 1664525 + 1013904223;
+        return static_cast<WORD>(dwSeed >> 16);
+    };
+    for (size_t i = 0; i < nBufSize; i++)
+    {
+        WORD w = Rand();
+        tblSrc[i] = (w & 0x3) == 0 ? WORD(w | 0x8000) : wTrans;
+        tblMask[i] = (Rand() & 0x1) ? WORD(0) : WORD(0xFFFF);
+        tblDst[i] = Rand();
+    }
+
+    TransBltKernel eBest = GetTransBltKernel();
+    for (int nKern = tbkSSE2; nKern <= eBest; nKern++)
+    {
+        for (size_t nOffset = 0; nOffset < nMaxOffset; nOffset++)
+        {
+            for (size_t nPxls = 0; nPxls <= nMaxPxls; nPxls++)
+            {
+                std::vector<WORD> tblRef(tblDst), tblTst(tblDst);
+                TransRowScalar(&tblRef[nOffset], &tblSrc[0], nPxls, wTrans);
+                tblTransRow[nKern](&tblTst[nOffset], &tblSrc[0], nPxls, wTrans);
+                if (tblRef != tblTst)
+                    return FALSE;
+
+                tblRef = tblDst;
+                tblTst = tblDst;
+                TransMaskedRowScalar(&tblRef[0], &tblSrc[nOffset],
+                    &tblMask[0], nPxls, wTrans);
+                tblTransMaskedRow[nKern](&tblTst[0], &tblSrc[nOffset],
+                    &tblMask[0], nPxls, wTrans);
+                if (tblRef != tblTst)
+                    return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
@@ -0,0 +1,101 @@
+// TransBlt.h
+//
+// Copyright (c) 1994-2020 By Dale L. Larson, All Rights Reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is furnished to do so, subject to
+// the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef _TRANSBLT_H
+#define _TRANSBLT_H
+
+#include    <vector>
+
+////////////////////////////////////////////////////////////////////
+// Color keyed copies between 16 bit (5-6-5) DIB sections. Source
+// pixels equal to the transparent color leave the destination
+// alone. The rows are handled 16 (AVX2) or 8 (SSE2) pixels at a
+// time when the CPU supports it. Otherwise a scalar loop is used.
+
+enum TransBltKernel { tbkScalar, tbkSSE2, tbkAVX2 };
+
+// The fastest kernel this CPU supports.
+TransBltKernel GetTransBltKernel();
+
+void TransBltRow16(WORD* pDst, const WORD* pSrc, size_t nPxls,
+    WORD wTrans);
+// Only pixels with a black (zero) mask pixel are copied.
+void TransBltMaskedRow16(WORD* pDst, const WORD* pSrc, const WORD* pMask,
+    size_t nPxls, WORD wTrans);
+
+// Copies the cx by cy block at (xSrc, ySrc) of bmapSrc to (xDst, yDst)
+// of bmapDst. Both bitmaps must be bottom-up 16 bit DIB sections. The
+// block is clipped to the destination before any pixels are touched.
+void TransBlt16(const BITMAP& bmapDst, int xDst, int yDst,
+    const BITMAP& bmapSrc, int xSrc, int ySrc, int cx, int cy, WORD wTrans);
+// Same as above except the block is also clipped to bmapMask whose
+// origin lines up with the block's upper left corner.
+void TransBlt16Masked(const BITMAP& bmapDst, int xDst, int yDst,
+    const BITMAP& bmapSrc, int xSrc, int ySrc, int cx, int cy,
+    const BITMAP& bmapMask, WORD wTrans);
+
+////////////////////////////////////////////////////////////////////
+// The opaque runs of a color keyed block, row by row. They're found
+// once so drawing the block copies the runs and skips the
+// transparent pixels without looking at them.
+
+class CTransSpans
+{
+public:
+    CTransSpans() : m_size(0, 0), m_wTrans(0) {}
+
+    // bmapSrc must be a bottom-up 16 bit DIB section.
+    void Build(const BITMAP& bmapSrc, const CRect& rctSrc, WORD wTrans);
+    BOOL IsBuiltFor(CSize size, WORD wTrans) const
+        { return !m_tblRowStart.empty() && m_size == size && m_wTrans == wTrans; }
+    CSize GetSize() const { return m_size; }
+
+    // Draws the block built from at (xSrc, ySrc) of bmapSrc. It's
+    // clipped to the destination like TransBlt16().
+    void Blt(const BITMAP& bmapDst, int xDst, int yDst,
+        const BITMAP& bmapSrc, int xSrc, int ySrc) const;
+
+protected:
+    struct Run
+    {
+        int     m_x;
+        int     m_cx;
+    };
+    CSize       m_size;
+    WORD        m_wTrans;
+    // The runs of row y are m_tblRuns[m_tblRowStart[y]] up to
+    // m_tblRuns[m_tblRowStart[y + 1]].
+    std::vector<size_t> m_tblRowStart;
+    std::vector<Run> m_tblRuns;
+};
+
+////////////////////////////////////////////////////////////////////
+
+// Runs every kernel the CPU supports against the scalar one over
+// assorted lengths and alignments. Returns FALSE if any of them
+// differ by so much as a bit.
+BOOL TransBltSelfTest();
+
+#endif
+
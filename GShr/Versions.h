@@ -79,21 +79,22 @@
 const int progVerMajor = 3;         // Current program version
 const int progVerMinor = 50;        // (Number is divided by 100. ex: 10 is .10)
 
-// File versions
-const int fileGbxVerMajor = 3;      // Current GBOX file version supported
-const int fileGbxVerMinor = 90;
+// File versions (4.00 - IDs, ID table sizes and move indices
+// are stored as 32 bit values)
+const int fileGbxVerMajor = 4;      // Current GBOX file version supported
+const int fileGbxVerMinor = 0;
 
 const int fileGtlVerMajor = 3;      // Current GTLB file version supported
 const int fileGtlVerMinor = 90;
 
-const int fileGsnVerMajor = 3;      // Current GSCN file version supported
-const int fileGsnVerMinor = 90;
+const int fileGsnVerMajor = 4;      // Current GSCN file version supported
+const int fileGsnVerMinor = 0;
 
-const int fileGamVerMajor = 3;      // Current GAME file version supported
-const int fileGamVerMinor = 90;
+const int fileGamVerMajor = 4;      // Current GAME file version supported
+const int fileGamVerMinor = 0;
 
-const int fileGmvVerMajor = 3;      // Current GMOV file version supported
-const int fileGmvVerMinor = 90;
+const int fileGmvVerMajor = 4;      // Current GMOV file version supported
+const int fileGmvVerMinor = 0;
 
 inline int NumVersion(int major, int minor) { return major * 256 + minor; }
 